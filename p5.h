@@ -57,9 +57,27 @@ CONFIGURATION:
                                     // Use full names (p5_create_canvas, p5_rect, etc.) instead
     #define P5_NO_APP               // Disable automatic app setup (P5_MAIN, setup/draw callbacks)
                                     // Use manual sokol initialization like demo.c
+    #define P5_HEADLESS             // Run without a sokol_app window (implies P5_NO_APP)
+                                    // Window size is set with p5_headless_size(), e.g. for
+                                    // SOKOL_DUMMY_BACKEND tools such as tools/p5replay.c
+    #define P5_TELEMETRY            // Enable p5_telemetry_begin() (starts a writer thread;
+                                    // link pthread on POSIX)
+    #define P5_BATCH_DIAGNOSTICS    // Enable p5_batch_diagnostics(): explain why sgp draw
+                                    // commands did not merge, per drawing call site
+    #define P5_MALLOC(size) my_malloc(size)        // Heap hooks for every allocation p5 makes;
+    #define P5_REALLOC(ptr, size) my_realloc(ptr, size)  // define all three or none
+    #define P5_FREE(ptr) my_free(ptr)               // (default: stdlib)
+    #define P5_FRAME_ARENA_SIZE 65536 // Initial per-frame scratch arena size in bytes
+    #define P5_TRACE                // Count and time every sketch-facing p5 call
+                                    // (p5_trace_print); compiles away when not defined
+    #define P5_OVERDRAW_KEY SAPP_KEYCODE_F2  // Key that toggles the overdraw heat map in
+                                    // p5_sokol_event() (default F2)
 
 DEPENDENCIES:
     Requires sokol_gp.h to be included before this header
+    POSIX: compile with -D_POSIX_C_SOURCE=200809L or -D_GNU_SOURCE for the
+    monotonic clock; strict -std=c99 falls back to gettimeofday()/select()
+    Windows: link winmm for timeBeginPeriod (automatic with MSVC)
 
 LICENSE:
     Public Domain
@@ -81,11 +99,18 @@ LICENSE:
 #ifndef P5_H
 #define P5_H
 
+#if defined(P5_HEADLESS) && !defined(P5_NO_APP)
+#define P5_NO_APP
+#endif
+
 #include <stdbool.h>
+#include <stdint.h>
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <float.h>
 
 // TODO macro for unimplemented functions
 #define TODO(msg) do { \
@@ -134,11 +159,213 @@ typedef enum {
     P5_PIE
 } p5_arc_mode_t;
 
+// Recorded command list (opaque, see p5_cmdlist_begin)
+typedef struct p5_cmdlist_t p5_cmdlist_t;
+
+// Recorded tessellated geometry (opaque, see p5_recorder_begin)
+typedef struct p5_recorder_t p5_recorder_t;
+
+// Offscreen graphics buffer (opaque, see p5_create_graphics)
+typedef struct p5_graphics_t p5_graphics_t;
+
+// Independent p5 instance (opaque, see p5_context_create)
+typedef struct p5_context_t p5_context_t;
+
+// Frame capture file layout (native byte order):
+// one p5_capture_header_t, then for each frame a p5_capture_frame_t
+// immediately followed by `size` bytes of recorded commands, zero-padded
+// to a multiple of 4 bytes (see P5_CAPTURE_PADDED_SIZE)
+typedef struct {
+    char magic[4];          // "P5CF"
+    uint32_t version;       // P5_CAPTURE_VERSION
+    uint32_t frame_count;
+    uint32_t reserved;
+} p5_capture_header_t;
+
+// Style and transform in effect when a captured frame began
+typedef struct {
+    float fill[4], stroke[4];   // RGBA, 0-1
+    float stroke_weight;
+    float transform[5];         // tx, ty, rotation (radians), sx, sy
+    uint32_t flags;             // P5_CAPTURE_FILL | P5_CAPTURE_STROKE
+} p5_capture_style_t;
+
+#define P5_CAPTURE_FILL   (1u << 0)
+#define P5_CAPTURE_STROKE (1u << 1)
+
+typedef struct {
+    uint32_t size;          // Command bytes following this header
+    int32_t width, height;  // Canvas size the frame was drawn at
+    uint32_t reserved;
+    p5_capture_style_t style;
+} p5_capture_frame_t;
+
+#define P5_CAPTURE_VERSION 2
+#define P5_CAPTURE_PADDED_SIZE(size) (((size) + 3u) & ~3u)
+
+// sgp draw issued by p5 (see p5_draw_log_begin)
+typedef enum {
+    P5_DRAW_TRIANGLE,               // sgp_draw_filled_triangle
+    P5_DRAW_RECT,                   // sgp_draw_filled_rect
+    P5_DRAW_LINE,                   // sgp_draw_line
+    P5_DRAW_POINT,                  // sgp_draw_point
+    P5_DRAW_TEXTURED_RECT,          // sgp_draw_textured_rect (graphics buffers)
+    P5_DRAW_CLEAR,                  // sgp_clear (background)
+    P5_DRAW_OP_COUNT
+} p5_draw_op_t;
+
+typedef struct {
+    p5_draw_op_t op;
+    int vertices;                   // Vertices sgp emits for the draw
+    uint8_t color[4];               // sgp color (RGBA8) the draw is made with
+    int blend_mode;                 // sgp_blend_mode
+    float transform[2][3];          // sgp transform (p5 transforms already applied)
+    float xy[8];                    // Points after the transform (canvas coordinates)
+    int point_count;                // 3, 4 (rects), 2, 1, or 0 for clears
+} p5_draw_record_t;
+
+typedef struct {
+    p5_draw_record_t* records;
+    int count;
+    int capacity;
+    int vertices;                   // Sum of records[].vertices
+    int ops[P5_DRAW_OP_COUNT];      // Records per op
+} p5_draw_log_t;
+
+// Frame time statistics over the last P5_FRAME_TIME_WINDOW frames
+typedef struct {
+    int count;              // Frames in the window
+    float fps;              // Average frame rate over the window
+    float p50, p95, p99;    // Frame time percentiles in milliseconds
+    float max;              // Longest frame time in milliseconds
+} p5_frame_stats_t;
+
+// One frame of watchdog history (see p5_watchdog)
+typedef struct {
+    int frame;              // p5_frame_count() of the frame
+    float wait_ms;          // Frame-rate limiter
+    float draw_ms;          // setup()/draw() and tessellation
+    float submit_ms;        // sgp flush and sokol commit
+    uint32_t shapes;        // p5 shapes drawn
+    uint32_t draw_calls;    // sokol draw calls after sgp batching
+    uint32_t commands;      // Peak sgp command buffer use
+    uint32_t uniforms;      // Peak sgp uniform buffer use
+    uint32_t vertices;      // Peak sgp vertex buffer use
+    bool dropped;           // sgp ran out of buffer space and drew nothing
+    float latency_ms;       // Start of the presented frame's draw() to the end of its submission
+} p5_frame_record_t;
+
+// sgp buffer use (see p5_sgp_usage)
+typedef struct {
+    uint32_t vertices;
+    uint32_t commands;
+    uint32_t uniforms;
+} p5_sgp_counts_t;
+
+typedef struct {
+    p5_sgp_counts_t frame;      // Peak of the last completed frame
+    p5_sgp_counts_t run;        // Peak since p5_init()
+    p5_sgp_counts_t capacity;   // sgp_desc sizes (uniforms are sized like commands)
+    uint32_t dropped_frames;    // Frames sgp discarded because a buffer was full
+} p5_sgp_usage_t;
+
+#ifdef P5_BATCH_DIAGNOSTICS
+// Outcome of one sgp draw issued by p5 (see p5_batch_diagnostics). sgp keeps
+// colors per vertex, so fill and stroke color changes never split batches.
+typedef enum {
+    P5_BATCH_MERGED,            // Joined an earlier command
+    P5_BATCH_BREAK_STATE,       // First draw after sgp_begin, a viewport or a scissor
+    P5_BATCH_BREAK_PIPELINE,    // Primitive type (fill triangles vs stroke lines), blend mode or custom pipeline
+    P5_BATCH_BREAK_IMAGE,       // Bound image or sampler
+    P5_BATCH_BREAK_UNIFORM,     // Custom pipeline uniforms
+    P5_BATCH_BREAK_OVERLAP,     // Compatible command found, but draws in between overlap both
+    P5_BATCH_BREAK_DEPTH,       // Nearest compatible command is beyond SGP_BATCH_OPTIMIZER_DEPTH
+    P5_BATCH_BREAK_MOVE,        // Merging would move more vertices than sgp allows (96)
+    P5_BATCH_BREAK_STRIP,       // Strip primitives never merge
+    P5_BATCH_REASON_COUNT
+} p5_batch_reason_t;
+#endif
+
+#ifdef P5_TRACE
+// Sketch-facing functions counted and timed by P5_TRACE
+#define P5__TRACE_FUNCTIONS(X) \
+    X(p5_create_canvas) X(p5_create_canvas_positioned) X(p5_width) X(p5_height) \
+    X(p5_window_width) X(p5_window_height) X(p5_background) X(p5_background_rgb) \
+    X(p5_color) X(p5_color_rgb) X(p5_color_rgba) X(p5_fill) \
+    X(p5_fill_rgb) X(p5_fill_rgba) X(p5_stroke) X(p5_stroke_rgb) \
+    X(p5_stroke_rgba) X(p5_stroke_weight) X(p5_no_fill) X(p5_no_stroke) \
+    X(p5_angle_mode) X(p5_color_mode) X(p5_color_mode_range) X(p5_text_output) \
+    X(p5_push) X(p5_pop) X(p5_translate) X(p5_rotate) \
+    X(p5_scale) X(p5_scale_xy) X(p5_point) X(p5_line) \
+    X(p5_rect) X(p5_square) X(p5_circle) X(p5_ellipse) \
+    X(p5_triangle) X(p5_quad) X(p5_arc) X(p5_arc_with_mode) \
+    X(p5_no_loop) X(p5_loop) X(p5_redraw) X(p5_create_graphics) \
+    X(p5_remove_graphics) X(p5_graphics_begin) X(p5_graphics_end) X(p5_image) \
+    X(p5_image_sized) X(p5_cmdlist_begin) X(p5_cmdlist_end) X(p5_cmdlist_replay) \
+    X(p5_cmdlist_free) X(p5_recorder_begin) X(p5_recorder_end) X(p5_recorder_submit) \
+    X(p5_capture_replay) X(p5_parallel_for) X(p5_async) X(p5_task_wait) \
+    X(p5_flush_shapes) X(p5_run_coroutines)
+
+typedef enum {
+#define P5__TRACE_ENUM(name) P5__TRACE_##name,
+    P5__TRACE_FUNCTIONS(P5__TRACE_ENUM)
+#undef P5__TRACE_ENUM
+    P5__TRACE_COUNT
+} p5__trace_id_t;
+
+// Calls and latency of one function (see p5_trace_stat), in cycle-counter
+// ticks; percentiles are power-of-two histogram bucket upper edges
+typedef struct {
+    uint64_t calls;
+    uint64_t cycles;            // Total
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+    uint64_t p50_cycles;
+    uint64_t p99_cycles;
+} p5_trace_stat_t;
+#endif
+
+// Heap allocation counters (see p5_alloc_stats)
+typedef struct {
+    uint32_t frame_allocations;     // P5_MALLOC/P5_REALLOC calls in the last completed frame
+    uint32_t frame_frees;
+    uint64_t allocations;           // Since program start
+    uint64_t frees;
+    uint32_t allocating_frames;     // Frames that allocated at all
+    size_t arena_capacity;          // Per-frame scratch arena size
+    size_t arena_peak;              // Scratch used by the last completed frame
+} p5_alloc_stats_t;
+
+// Receives the watchdog history oldest first; history[slow] exceeded the budget
+typedef void (*p5_watchdog_fn)(const p5_frame_record_t* history, int count, int slow, void* user_data);
+
 //
 // INITIALIZATION
 //
 
 void p5_init(void);
+void p5_shutdown(void);  // Release p5 memory and GPU resources before sg_shutdown() (called by p5_sokol_cleanup)
+#ifdef P5_HEADLESS
+void p5_headless_size(int width, int height);  // Window size reported when there is no window
+#endif
+
+//
+// CONTEXT FUNCTIONS
+//
+
+// Each context holds the complete state of one sketch: style, transforms,
+// canvas, timing, buffers, recorders and diagnostics. Every p5 function acts
+// on the calling thread's current context, which starts as the default
+// context that the global API has always used. A context must be current on
+// at most one thread at a time. sokol_gfx/sokol_gp are single-threaded, so
+// drawing still happens on the thread that owns them; other threads can use
+// their own contexts for everything that does not reach sokol (style and
+// transform state, command list recording, frame timing).
+p5_context_t* p5_context_create(void);           // Initialized as by p5_init(); not made current
+void p5_context_destroy(p5_context_t* context);  // p5_shutdown() on the context, then free it
+void p5_context_make_current(p5_context_t* context);  // For the calling thread; NULL = default
+p5_context_t* p5_context_current(void);
+p5_context_t* p5_context_default(void);
 
 //
 // CANVAS FUNCTIONS
@@ -200,6 +427,344 @@ void p5_quad(float x1, float y1, float x2, float y2, float x3, float y3, float x
 void p5_arc(float x, float y, float w, float h, float start, float stop);
 void p5_arc_with_mode(float x, float y, float w, float h, float start, float stop, p5_arc_mode_t mode);
 
+//
+// LOOP CONTROL FUNCTIONS
+//
+
+// With noLoop(), p5_sokol_frame() stops running setup()/draw() and
+// re-presents the last frame from a cached render target (no tessellation).
+// The frame that called noLoop() becomes the cached frame; a frame is drawn
+// again after p5_redraw(), any input event, or a canvas size change.
+// Presenting the cached frame still costs one render pass and one textured
+// quad (6 vertices) per display refresh: sokol_app presents every frame and
+// the swapchain content is undefined after a present, so it is redrawn.
+// p5_sokol_frame() brackets each frame; manual (P5_NO_APP) users call
+// p5_loop_frame_begin() inside their sgp frame, draw only when it returns
+// true, then call p5_loop_frame_end() before flushing.
+void p5_no_loop(void);
+void p5_loop(void);
+void p5_redraw(void);
+bool p5_is_looping(void);
+bool p5_loop_frame_begin(void);
+void p5_loop_frame_end(void);
+
+//
+// TIMING FUNCTIONS
+//
+
+// p5_sokol_frame() calls p5_frame_begin() before drawing and p5_frame_end()
+// after sg_commit(); manual (P5_NO_APP) users call them the same way.
+// p5_frame_begin() waits for the frame-rate limiter, then advances the frame
+// count and delta time.
+void p5_frame_begin(void);
+void p5_frame_end(void);
+double p5_millis(void);                // Milliseconds since p5_init()
+float p5_delta_time(void);             // Milliseconds between the last two frames
+int p5_frame_count(void);              // Frames begun since p5_init()
+void p5_frame_rate(float fps);         // Limit to fps frames per second (0 = unlimited)
+float p5_get_frame_rate(void);         // Measured frames per second
+float p5_get_target_frame_rate(void);  // Limit set with p5_frame_rate(), or 0
+p5_frame_stats_t p5_frame_stats(void);
+float p5_frame_latency_ms(void);       // Last frame, see p5_frame_record_t.latency_ms
+
+// Frame-time watchdog: while enabled, the last P5_WATCHDOG_HISTORY frames are
+// kept in a ring buffer. When a frame's draw + submit time exceeds budget_ms,
+// the history up to P5_WATCHDOG_TRAILING frames after it is appended to the
+// file at path, or passed to fn. A budget of 0 disables the watchdog.
+bool p5_watchdog(float budget_ms, const char* path);
+void p5_watchdog_callback(float budget_ms, p5_watchdog_fn fn, void* user_data);
+
+// Peak sgp vertex, command and uniform buffer use. It is sampled just before
+// p5's own sgp_flush() calls (p5_sokol_frame and graphics buffers), or
+// estimated from sokol frame stats in p5_frame_end() when the application
+// flushes itself.
+p5_sgp_usage_t p5_sgp_usage(void);
+void p5_sgp_usage_print(void);  // Print peaks and recommended sgp_desc sizes (called by p5_sokol_cleanup)
+
+// Heap use: every allocation p5 makes goes through P5_MALLOC/P5_REALLOC/
+// P5_FREE and is counted. Transient per-shape scratch comes from a linear
+// arena that p5_frame_begin() resets; an arena that overflowed is regrown
+// once to the frame's peak, so steady-state frames allocate nothing.
+p5_alloc_stats_t p5_alloc_stats(void);
+void p5_alloc_stats_print(void);  // Called by p5_sokol_cleanup
+
+// Overdraw heat map: while enabled, background() and every shape are drawn
+// additively in one low-intensity color, so a pixel shaded n times shows n
+// layers of it: dark red for a single layer, bright red at 8, yellow at 16
+// and white from 32. Graphics buffers and p5_image() keep their own colors
+// but are still counted. p5_sokol_frame() clears the window to black (no
+// layers), draws the legend, and p5_sokol_event() toggles the mode on
+// P5_OVERDRAW_KEY; manual (P5_NO_APP) users clear their pass to opaque
+// black and call p5_overdraw_legend() before sgp_flush().
+void p5_overdraw(bool enabled);
+bool p5_is_overdraw(void);
+void p5_overdraw_legend(void);    // Layer scale 1-32 with ticks every 8 layers, bottom left
+float p5_overdraw_average(void);  // Pixels shaded per canvas pixel in the last frame
+
+#ifdef P5_BATCH_DIAGNOSTICS
+// Batch-break diagnostics: while enabled, every sgp draw p5 issues is
+// classified by replaying sgp's batch optimizer rules, and counted per
+// drawing call site (__FILE__/__LINE__ of the p5 call, captured by macros
+// defined at the end of this header). Draws made directly through sgp are
+// not seen.
+void p5_batch_diagnostics(bool enabled);
+void p5_batch_diagnostics_reset(void);
+void p5_batch_diagnostics_print(void);  // Per-site histograms, most batch breaks first
+uint32_t p5_batch_count(p5_batch_reason_t reason);  // Draws since the last reset
+void p5_batch_call_site(const char* file, int line);  // Used by the call-site macros
+#endif
+
+#ifdef P5_TRACE
+// Call tracing: calls the application makes to sketch-facing p5 functions
+// (shapes, style, transforms, colors, buffers, command lists) are counted
+// and timed with the CPU cycle counter by macros defined at the end of this
+// header; p5's own internal calls are not counted. Times are inclusive and
+// include the few cycles of the counter reads themselves.
+void p5_trace_reset(void);
+void p5_trace_print(void);             // Summary table, most total time first
+bool p5_trace_dump(const char* path);  // Summary table plus latency histograms
+p5_trace_stat_t p5_trace_stat(const char* name);  // e.g. "p5_rect"; zeroes if unknown
+void p5_trace_enter(void);             // Used by the tracing macros
+void p5_trace_leave(int id);
+int p5_trace_leave_int(int id, int value);
+p5_color_t p5_trace_leave_color(int id, p5_color_t value);
+void* p5_trace_leave_ptr(int id, void* value);
+#endif
+
+#ifdef P5_TELEMETRY
+// Every interval_s seconds, write frame-time percentiles, per-frame shape,
+// vertex and command counts, sgp buffer high-water marks and dropped frames
+// in Prometheus text format. path is a file that is atomically replaced on
+// each report, or "unix:<socket path>" to send each report to a listening
+// Unix socket. Reports are formatted and written on a separate thread.
+bool p5_telemetry_begin(const char* path, float interval_s);
+void p5_telemetry_end(void);
+#endif
+
+//
+// GRAPHICS BUFFER FUNCTIONS
+//
+
+// Offscreen buffers backed by a render target. Drawing between begin() and
+// end() goes into the buffer, which keeps its content until drawn over, so
+// expensive layers can be re-rendered less often and composited with
+// p5_image(). Removed buffers return their render target to a pool that
+// p5_create_graphics() reuses for the same size. p5_frame_begin() destroys
+// targets parked for more than P5_GRAPHICS_POOL_FRAMES frames, and the
+// oldest ones beyond P5_GRAPHICS_POOL_MAX.
+p5_graphics_t* p5_create_graphics(int width, int height);
+void p5_remove_graphics(p5_graphics_t* pg);
+void p5_graphics_begin(p5_graphics_t* pg);
+void p5_graphics_end(void);
+void p5_image(const p5_graphics_t* pg, float x, float y);
+void p5_image_sized(const p5_graphics_t* pg, float x, float y, float w, float h);
+
+//
+// INCREMENTAL RENDERING FUNCTIONS
+//
+
+// Opt-in dirty-rectangle rendering. Each frame's commands are recorded,
+// compared shape by shape with the previous frame, and only the screen
+// regions whose shapes changed are redrawn (scissored) into a persistent
+// canvas render target, which is then composited to the window. Supports
+// the shape, style and transform API and p5_image(); an image counts as
+// changed when its buffer was drawn into since the previous frame. Drawing
+// into a graphics buffer is not recorded and goes straight to the buffer.
+// p5_sokol_frame() brackets each frame;
+// manual (P5_NO_APP) users call the frame begin/end functions themselves.
+void p5_incremental(bool enabled);
+bool p5_is_incremental(void);
+void p5_incremental_frame_begin(void);
+void p5_incremental_frame_end(void);
+float p5_incremental_redraw_fraction(void);  // Share of the canvas redrawn last frame
+
+//
+// COMMAND LIST FUNCTIONS
+//
+
+// Between begin() and end(), style, transform and shape calls are captured
+// into a command list instead of being drawn. Replay re-executes the list
+// under the current transform and style, restoring both afterwards.
+// Angle and color modes are not recorded: they apply right away, scoped by
+// the recorded push() and pop(), to the arguments of later recorded calls.
+void p5_cmdlist_begin(void);
+p5_cmdlist_t* p5_cmdlist_end(void);
+void p5_cmdlist_replay(const p5_cmdlist_t* list);
+void p5_cmdlist_free(p5_cmdlist_t* list);
+
+//
+// RECORDER FUNCTIONS
+//
+
+// Between begin() and end(), shape calls are tessellated into the recorder
+// with the current style and transform baked into the vertices, without
+// touching sokol. Worker threads can each fill their own recorder, each in
+// its own context (see p5_context_create), and the main thread then submits
+// the recorders in the order it chooses, so the frame does not depend on
+// which worker finished first. Submitting copies the vertices to sokol_gp
+// under the current transform, one sgp draw per recorded draw, so sgp culls
+// and merges them as it would have the shapes drawn directly.
+// Graphics buffers and p5_image() are not available while recording.
+// Submitting is not recorded by command lists or frame capture.
+p5_recorder_t* p5_recorder_create(void);
+void p5_recorder_free(p5_recorder_t* recorder);
+void p5_recorder_begin(p5_recorder_t* recorder);  // Discards what the recorder held
+void p5_recorder_end(void);
+void p5_recorder_submit(const p5_recorder_t* recorder);
+int p5_recorder_vertex_count(const p5_recorder_t* recorder);
+
+//
+// PIPELINED FRAME FUNCTIONS
+//
+
+// Opt-in pipelining: setup()/draw() run on a worker thread in a context of
+// their own, recording frame N+1 into a recorder while the calling thread
+// submits frame N to sokol. A frame whose draw and submit halves take
+// similar time then runs up to twice as fast, at the price of presenting
+// every frame one frame later than it was drawn; p5_frame_latency_ms()
+// reports the difference. While pipelined, incremental rendering, frame
+// capture, graphics buffers and p5_image() are not available to draw(),
+// and noLoop() re-presents the last recorded frame. p5_sokol_frame() uses
+// the pipeline when enabled; manual (P5_NO_APP) loops call
+// p5_pipeline_draw() between sgp_begin() and sgp_flush(). Without thread
+// support (e.g. single-threaded Emscripten) frames stay serial.
+void p5_pipelined(bool enabled);
+bool p5_is_pipelined(void);
+// Submit the frame recorded last time and start recording the next one by
+// calling draw_fn on the worker (the first call records synchronously)
+void p5_pipeline_draw(void (*draw_fn)(void));
+
+//
+// PARALLEL FUNCTIONS
+//
+
+// A work-stealing thread pool for sketch code such as particle updates,
+// cellular automata and flow fields. Each worker thread keeps its own queue
+// of jobs and takes work from the others when it runs dry; a thread waiting
+// for its jobs runs queued jobs meanwhile, so calls may nest. Jobs run with
+// the default context current and must not draw unless they make a context
+// of their own current (see p5_context_create). The pool starts on first
+// use. Without thread support everything runs on the calling thread.
+typedef struct p5_task_t p5_task_t;
+
+// Call fn(begin, end, ctx) on disjoint slices covering [begin, end), of at
+// least grain items each (0 = pick from the worker count), and return once
+// every slice is done
+void p5_parallel_for(int begin, int end, int grain, void (*fn)(int begin, int end, void* ctx), void* ctx);
+// Run fn(ctx) on a worker. Every task must be passed to p5_task_wait(),
+// which also frees it; check p5_task_done() to keep draw() from blocking.
+p5_task_t* p5_async(void (*fn)(void* ctx), void* ctx);
+bool p5_task_done(const p5_task_t* task);
+void p5_task_wait(p5_task_t* task);
+void p5_worker_threads(int count);     // 0 = one less than the CPU count (at least one); restarts the pool
+int p5_worker_thread_count(void);      // Worker threads running, 0 before first use
+
+//
+// SHAPE BATCHING FUNCTIONS
+//
+
+// Deferred, parallel tessellation for frames with many shapes. While
+// enabled, point, line, rect, ellipse, triangle, quad and arc calls only
+// store a compact description of the shape with its style and transform.
+// p5_flush_shapes() splits the stored shapes into contiguous chunks,
+// tessellates the chunks on the worker pool into vertex buffers of their
+// own and submits the buffers in call order, so the frame looks exactly as
+// if drawn directly and sgp culls and merges the same draws. Shapes are flushed before anything else is drawn
+// (backgrounds, images, graphics buffers), after draw() in p5_sokol_frame(),
+// and when batching is disabled; manual frame loops call p5_flush_shapes()
+// before sgp_flush(). Shapes drawn into a recorder (including pipelined
+// frames) are not batched.
+void p5_shape_batching(bool enabled);
+bool p5_is_shape_batching(void);
+void p5_flush_shapes(void);
+int p5_batched_shape_count(void);      // Shapes waiting for the next flush
+
+//
+// FIXED-TIMESTEP UPDATE FUNCTIONS
+//
+
+// A simulation stepped at a fixed rate on a thread of its own, decoupled
+// from drawing. Each step copies the last published state and calls
+// update_fn(state, dt) with dt = 1 / hz seconds to advance the copy, which
+// is then published. draw() reads the last two published states with
+// p5_update_states() and blends them by the returned factor, so motion stays
+// smooth at any frame rate. A slow frame does not slow the simulation, and a
+// slow step does not hold up drawing, which keeps showing the last published
+// states. When steps fall more than P5_UPDATE_MAX_CATCHUP behind, the
+// missing time is dropped instead of piling up. update_fn must not draw.
+// p5 keeps five copies of the state. Without thread support, due steps run
+// in p5_update_states() on the calling thread.
+bool p5_fixed_update(void (*update_fn)(void* state, float dt), const void* initial_state, size_t state_size, float hz);
+void p5_fixed_update_stop(void);       // Waits for the step in progress
+// Point previous and current at the last two published states, readable
+// until the next call, and return how far (0 to 1) the present lies between
+// them; both are NULL without a running update
+float p5_update_states(const void** previous, const void** current);
+uint64_t p5_update_step_count(void);   // Steps published since p5_fixed_update()
+
+//
+// COROUTINE FUNCTIONS
+//
+
+// Long work such as building a large mesh or parsing a dataset, spread over
+// frames so the sketch keeps drawing meanwhile. A coroutine is a step
+// function that does a slice of the work and returns true while work
+// remains; loops inside it check p5_coroutine_should_yield() and return
+// early once this frame's budget is used up, then resume where they left
+// off (keep the position in ctx) on the next call. The frame loop
+// (p5_sokol_frame(), or p5_run_coroutines() in manual loops) takes turns
+// stepping the pending coroutines of the current context before drawing,
+// until the budget is used up, at least one step per frame. Coroutines run
+// on the frame loop's thread and should not draw.
+typedef struct p5_coroutine_t p5_coroutine_t;
+
+p5_coroutine_t* p5_coroutine_start(bool (*step_fn)(void* ctx), void* ctx);
+// Every coroutine must be passed to p5_coroutine_finish(), which runs any
+// remaining steps right away and frees it, or to p5_coroutine_cancel(). A
+// step may finish or cancel its own coroutine (freed once the step returns)
+// or others. Handles stay valid after their context shuts down.
+bool p5_coroutine_done(const p5_coroutine_t* coroutine);
+void p5_coroutine_finish(p5_coroutine_t* coroutine);
+void p5_coroutine_cancel(p5_coroutine_t* coroutine);   // Frees without further steps
+bool p5_coroutine_should_yield(void);  // In a step: this frame's budget is used up
+void p5_coroutine_budget_ms(float ms); // Per frame, 0 = P5_COROUTINE_BUDGET_MS
+int p5_run_coroutines(void);           // Steps run
+
+//
+// FRAME CAPTURE FUNCTIONS
+//
+
+// Capture every p5 call of the next `frames` frames (0 = until p5_capture_end)
+// into a binary file while still drawing them. p5_sokol_frame() marks frame
+// boundaries; manual (P5_NO_APP) users call p5_capture_frame() after drawing.
+bool p5_capture_begin(const char* path, int frames);
+void p5_capture_frame(void);
+void p5_capture_end(void);
+bool p5_capture_active(void);
+// Execute the commands of one captured frame (the bytes following `frame`).
+// The style and transform the frame began with are restored first, and as
+// in the live sketch its changes stay in effect afterwards, so replaying
+// consecutive frames in order reproduces them exactly. pop() calls that
+// would close scopes opened before the frame are ignored.
+void p5_capture_replay(const p5_capture_frame_t* frame);
+
+//
+// DRAW LOG FUNCTIONS
+//
+
+// While a log is active, every draw p5 hands to sokol_gp is appended to it
+// with its vertex count, color, blend mode and transformed points, and then
+// drawn as usual. With SOKOL_DUMMY_BACKEND and P5_HEADLESS this lets tests
+// assert on exact geometry without a GPU or window. Logs grow as needed and
+// are reused after p5_draw_log_clear().
+void p5_draw_log_begin(p5_draw_log_t* log);
+void p5_draw_log_end(void);
+void p5_draw_log_clear(p5_draw_log_t* log);
+void p5_draw_log_free(p5_draw_log_t* log);
+// 64-bit FNV-1a over ops, colors, blend modes and points rounded to 1/16
+// pixel, for golden checks that tolerate float noise
+uint64_t p5_draw_log_hash(const p5_draw_log_t* log);
+
 //
 // MATH CONSTANTS
 //
@@ -224,7 +789,10 @@ void p5_arc_with_mode(float x, float y, float w, float h, float start, float sto
 #define DEGREES P5_DEGREES
 #define RADIANS P5_RADIANS
 
-// Color mode constants
+// Color mode constants (RGB replaces the wingdi.h macro of the same name)
+#ifdef RGB
+#undef RGB
+#endif
 #define RGB P5_RGB
 #define HSB P5_HSB
 #define HSL P5_HSL
@@ -289,6 +857,25 @@ static inline void quad(float x1, float y1, float x2, float y2, float x3, float
 static inline void arc(float x, float y, float w, float h, float start, float stop) { p5_arc(x, y, w, h, start, stop); }
 static inline void arc_with_mode(float x, float y, float w, float h, float start, float stop, p5_arc_mode_t mode) { p5_arc_with_mode(x, y, w, h, start, stop, mode); }
 
+// Loop control functions
+static inline void noLoop(void) { p5_no_loop(); }
+static inline void loop(void) { p5_loop(); }
+static inline void redraw(void) { p5_redraw(); }
+static inline bool isLooping(void) { return p5_is_looping(); }
+
+// Timing functions
+static inline double millis(void) { return p5_millis(); }
+static inline float deltaTime(void) { return p5_delta_time(); }
+static inline int frameCount(void) { return p5_frame_count(); }
+static inline void frameRate(float fps) { p5_frame_rate(fps); }
+static inline float getFrameRate(void) { return p5_get_frame_rate(); }
+static inline float getTargetFrameRate(void) { return p5_get_target_frame_rate(); }
+
+// Graphics buffer functions
+static inline p5_graphics_t* createGraphics(int width, int height) { return p5_create_graphics(width, height); }
+static inline void image(const p5_graphics_t* pg, float x, float y) { p5_image(pg, x, y); }
+static inline void image_sized(const p5_graphics_t* pg, float x, float y, float w, float h) { p5_image_sized(pg, x, y, w, h); }
+
 #endif // P5_NO_SHORT_NAMES
 
 //
@@ -322,6 +909,63 @@ static inline void arc_with_mode(float x, float y, float w, float h, float start
 
 #ifdef P5_IMPLEMENTATION
 
+// Monotonic clock and sleep (see p5__now_ns)
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <mmsystem.h>  // timeBeginPeriod (link winmm)
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm")
+#endif
+// wingdi.h defines RGB(r, g, b); restore the p5 color mode constant
+#ifndef P5_NO_SHORT_NAMES
+#undef RGB
+#define RGB P5_RGB
+#endif
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#include <time.h>
+#elif defined(__EMSCRIPTEN__)
+#include <emscripten.h>
+#else
+#include <time.h>
+#if !defined(CLOCK_MONOTONIC)
+// Strict ISO C modes (-std=c99 without _POSIX_C_SOURCE or _GNU_SOURCE) hide
+// clock_gettime() and nanosleep(): fall back to gettimeofday() and select(),
+// whose clock is not monotonic
+#include <sys/time.h>
+#include <sys/select.h>
+#endif
+#endif
+
+// Threads (pipelined frames, worker pool, telemetry writer)
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// Telemetry Unix socket output
+#if defined(P5_TELEMETRY) && !defined(_WIN32)
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+// Heap hooks
+#if defined(P5_MALLOC) && defined(P5_REALLOC) && defined(P5_FREE)
+// ok
+#elif !defined(P5_MALLOC) && !defined(P5_REALLOC) && !defined(P5_FREE)
+#define P5_MALLOC(size) malloc(size)
+#define P5_REALLOC(ptr, size) realloc(ptr, size)
+#define P5_FREE(ptr) free(ptr)
+#else
+#error "Must define all or none of P5_MALLOC, P5_REALLOC and P5_FREE"
+#endif
+
 // Transform state (internal)
 typedef struct {
     float tx, ty;     // translation
@@ -336,6 +980,549 @@ typedef struct {
     bool created;        // Whether canvas has been created
 } p5_canvas_t;
 
+// Style fields saved by push/pop (internal)
+// Each bit identifies a group of p5_state fields that is saved together.
+#define P5__STYLE_FILL          (1u << 0)  // fill_color, fill_enabled
+#define P5__STYLE_STROKE        (1u << 1)  // stroke_color, stroke_enabled
+#define P5__STYLE_STROKE_WEIGHT (1u << 2)  // stroke_width
+#define P5__STYLE_TRANSFORM     (1u << 3)  // transform
+#define P5__STYLE_ANGLE_MODE    (1u << 4)  // angle_mode
+#define P5__STYLE_COLOR_MODE    (1u << 5)  // color_mode, color_maxes
+
+// Style stack entry (internal)
+// The stack is diff-based: p5_push() only writes a scope marker, and a field
+// group is copied the first time it is modified inside that scope.
+typedef struct {
+    uint32_t field;  // P5__STYLE_* bit, or 0 for a scope marker
+    union {
+        struct { p5_color_t color; bool enabled; } paint;
+        float stroke_width;
+        p5_transform_t transform;
+        p5_angle_mode_t angle_mode;
+        struct { p5_color_mode_t mode; float maxes[4]; } color_mode;
+        uint32_t saved_dirty;  // Scope marker: dirty mask of the enclosing scope
+    } as;
+} p5__style_entry_t;
+
+// Command list opcodes (internal)
+// Each command is one opcode byte followed by p5__cmd_arg_count[op] floats.
+typedef enum {
+    P5__CMD_BACKGROUND,     // r, g, b, a
+    P5__CMD_FILL,           // r, g, b, a
+    P5__CMD_NO_FILL,
+    P5__CMD_STROKE,         // r, g, b, a
+    P5__CMD_NO_STROKE,
+    P5__CMD_STROKE_WEIGHT,  // weight
+    P5__CMD_PUSH,
+    P5__CMD_POP,
+    P5__CMD_TRANSLATE,      // x, y
+    P5__CMD_ROTATE,         // angle
+    P5__CMD_SCALE,          // sx, sy
+    P5__CMD_POINT,          // x, y
+    P5__CMD_LINE,           // x1, y1, x2, y2
+    P5__CMD_RECT,           // x, y, w, h
+    P5__CMD_ELLIPSE,        // x, y, w, h
+    P5__CMD_TRIANGLE,       // x1, y1, x2, y2, x3, y3
+    P5__CMD_QUAD,           // x1, y1, x2, y2, x3, y3, x4, y4
+    P5__CMD_ARC,            // x, y, w, h, start (radians), stop (radians), mode
+    P5__CMD_IMAGE,          // slot, x, y, w, h (incremental frames only, see p5__incremental_t.images)
+    P5__CMD_COUNT
+} p5__cmd_op_t;
+
+static const uint8_t p5__cmd_arg_count[P5__CMD_COUNT] = {
+    4, 4, 0, 4, 0, 1, 0, 0, 2, 1, 2, 2, 4, 4, 4, 6, 8, 7, 5
+};
+
+// Commands that draw (as opposed to changing style or transform)
+static inline bool p5__cmd_is_shape(p5__cmd_op_t op) {
+    return op == P5__CMD_BACKGROUND || op >= P5__CMD_POINT;
+}
+
+// Recorded command list
+struct p5_cmdlist_t {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+// Consecutive recorded draws of one kind
+typedef struct {
+    p5_draw_op_t op;            // P5_DRAW_TRIANGLE, RECT, LINE, POINT or CLEAR
+    uint32_t first;             // First vertex
+    uint32_t count;             // Vertices (p5__recorder_op_vertices[op] per draw)
+} p5__recorder_run_t;
+
+// Recorded tessellated geometry, in canvas coordinates
+struct p5_recorder_t {
+    sgp_vertex* vertices;
+    uint32_t vertex_count;
+    uint32_t vertex_capacity;
+    p5__recorder_run_t* runs;
+    uint32_t run_count;
+    uint32_t run_capacity;
+    uint32_t shapes;            // p5 shapes recorded
+    uint32_t shapes_start;      // Context shape counter at begin()
+    sgp_color_ub4 color;        // Color of the draws being tessellated
+    float transform[2][3];      // Transform of the shape being tessellated
+};
+
+// Offscreen graphics buffer, also a render target pool entry
+struct p5_graphics_t {
+    int width, height;
+    sg_image color;            // Render target (multisampled when sgp uses MSAA)
+    sg_image resolve;          // Single-sampled copy used for compositing, or invalid
+    sg_image depth;            // Depth target matching sgp pipelines, or invalid
+    sg_attachments attachments;
+    bool in_use;               // false while parked in the pool
+    int parked_frame;          // p5_frame_count() when it was parked
+    bool needs_clear;          // Clear to transparent on next begin
+    uint32_t version;          // Bumped each time drawing into it ends
+    p5_graphics_t* next;       // Pool list link
+};
+
+#ifndef P5_GRAPHICS_POOL_MAX
+#define P5_GRAPHICS_POOL_MAX 4      // Parked render targets kept for reuse
+#endif
+
+#ifndef P5_GRAPHICS_POOL_FRAMES
+#define P5_GRAPHICS_POOL_FRAMES 120 // Frames a parked render target is kept
+#endif
+
+// Incremental rendering (internal)
+#ifndef P5_MAX_DIRTY_RECTS
+#define P5_MAX_DIRTY_RECTS 8   // Dirty regions per frame before they are merged
+#endif
+
+typedef struct {
+    uint64_t key;               // Hash of the command and the style it was drawn with
+    float x0, y0, x1, y1;       // Canvas-space bounds
+} p5__shape_record_t;
+
+typedef enum {
+    P5__PASS_NONE,              // Normal drawing
+    P5__PASS_MEASURE,           // Record shape bounds and keys, draw nothing
+    P5__PASS_CULL               // Draw only shapes touching the cull rect
+} p5__pass_t;
+
+typedef struct {
+    bool enabled;
+    p5_cmdlist_t frame;                 // Commands recorded this frame
+    p5__shape_record_t* shapes[2];      // This and the previous frame's shapes
+    int shape_count[2];
+    int shape_capacity[2];
+    int current;                        // Index into shapes[] for this frame
+    p5__pass_t pass;
+    int shape_index;                    // Next shape record during a pass
+    float cull[4];                      // x0, y0, x1, y1 of the region being redrawn
+    const p5_graphics_t** images;       // Buffers drawn this frame, by P5__CMD_IMAGE slot
+    int image_count;
+    int image_capacity;
+    float dirty[P5_MAX_DIRTY_RECTS][4];
+    int dirty_count;
+    p5_graphics_t* target;              // Persistent canvas render target
+    bool full_redraw;
+    float redraw_fraction;
+} p5__incremental_t;
+
+// Heap allocation and per-frame scratch arena (internal)
+#ifndef P5_FRAME_ARENA_SIZE
+#define P5_FRAME_ARENA_SIZE 65536
+#endif
+#define P5__ARENA_ALIGN 16
+
+// Scratch that did not fit in the arena, freed at the next reset
+typedef struct p5__arena_block_t {
+    struct p5__arena_block_t* next;
+    size_t size;
+} p5__arena_block_t;
+
+typedef struct {
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+    size_t overflow_used;               // Bytes in overflow blocks
+    size_t peak;                        // This frame
+    size_t last_peak;                   // Last completed frame
+    p5__arena_block_t* overflow;
+} p5__arena_t;
+
+typedef struct {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t frame_start_allocations;   // Counters when this frame began
+    uint64_t frame_start_frees;
+    uint32_t frame_allocations;         // Last completed frame
+    uint32_t frame_frees;
+    uint32_t allocating_frames;
+    p5__arena_t arena;
+} p5__alloc_t;
+
+// Frame timing (internal)
+#ifndef P5_FRAME_TIME_WINDOW
+#define P5_FRAME_TIME_WINDOW 240       // Frames kept for p5_frame_stats()
+#endif
+#define P5__FRAME_TIME_BUCKETS 1024    // Histogram buckets of P5__FRAME_TIME_BUCKET_MS
+#define P5__FRAME_TIME_BUCKET_MS 0.25f // Longer frames land in the last bucket
+#ifndef P5_COROUTINE_BUDGET_MS
+#define P5_COROUTINE_BUDGET_MS 4.0     // Default time per frame for coroutine steps
+#endif
+
+#ifndef P5_UPDATE_MAX_CATCHUP
+#define P5_UPDATE_MAX_CATCHUP 8        // Most fixed-update steps run back to back to catch up
+#endif
+
+#ifndef P5_FRAME_SPIN_MS
+#define P5_FRAME_SPIN_MS 2.0           // Limiter busy-waits this close to the deadline
+#endif
+
+// Frame-time watchdog (internal)
+#ifndef P5_WATCHDOG_HISTORY
+#define P5_WATCHDOG_HISTORY 120        // Frames kept before a slow frame
+#endif
+#ifndef P5_WATCHDOG_TRAILING
+#define P5_WATCHDOG_TRAILING 10        // Frames recorded after a slow frame before dumping
+#endif
+
+typedef struct {
+    float budget_ms;                    // 0 = disabled
+    FILE* file;                         // Dump destination, or NULL
+    p5_watchdog_fn callback;            // Dump destination, or NULL
+    void* user_data;
+    p5_frame_record_t history[P5_WATCHDOG_HISTORY];
+    int count;
+    int next;                           // Oldest record once the ring is full
+    int trailing;                       // Frames left until the pending dump, or 0
+    int slow_frame;                     // Frame that triggered the pending dump
+} p5__watchdog_t;
+
+// Threads (internal)
+#ifdef _WIN32
+typedef HANDLE p5__thread_t;
+typedef CRITICAL_SECTION p5__mutex_t;
+typedef CONDITION_VARIABLE p5__cond_t;
+typedef DWORD (WINAPI *p5__thread_fn_t)(LPVOID);
+#define P5__THREAD_FN(name) DWORD WINAPI name(LPVOID arg)
+#define P5__THREAD_RETURN 0
+#else
+typedef pthread_t p5__thread_t;
+typedef pthread_mutex_t p5__mutex_t;
+typedef pthread_cond_t p5__cond_t;
+typedef void* (*p5__thread_fn_t)(void*);
+#define P5__THREAD_FN(name) void* name(void* arg)
+#define P5__THREAD_RETURN NULL
+#endif
+
+// 32-bit counters shared between threads; P5__ATOMIC_ADD returns the new
+// value and is sequentially consistent
+#if defined(_MSC_VER)
+#define P5__ATOMIC_LOAD(ptr) ((uint32_t)InterlockedOr((volatile LONG*)(ptr), 0))
+#define P5__ATOMIC_STORE(ptr, value) InterlockedExchange((volatile LONG*)(ptr), (LONG)(value))
+#define P5__ATOMIC_ADD(ptr, value) ((uint32_t)InterlockedExchangeAdd((volatile LONG*)(ptr), (LONG)(value)) + (uint32_t)(value))
+#else
+#define P5__ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define P5__ATOMIC_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define P5__ATOMIC_ADD(ptr, value) __atomic_add_fetch((ptr), (uint32_t)(value), __ATOMIC_SEQ_CST)
+#endif
+
+// Worker pool (internal)
+#define P5__POOL_MAX_WORKERS 64
+#define P5__POOL_QUEUE 512              // Jobs per queue (power of two)
+
+typedef struct {
+    void (*range_fn)(int begin, int end, void* ctx);  // p5_parallel_for slice
+    void (*task_fn)(void* ctx);                       // p5_async task
+    void* ctx;
+    int begin, end, grain;
+    uint32_t* remaining;                // Items of the job's group not yet done
+} p5__job_t;
+
+// The owner pushes and pops at the bottom, thieves take from the top
+typedef struct {
+    p5__mutex_t lock;
+    uint32_t top, bottom;
+    p5__job_t jobs[P5__POOL_QUEUE];
+} p5__job_queue_t;
+
+struct p5_task_t {
+    uint32_t remaining;
+};
+
+typedef struct {
+    uint32_t started;                   // Pool set up (atomic)
+    uint32_t starting;                  // Start in progress on some thread (atomic)
+    int requested;                      // p5_worker_threads(), 0 = default
+    int thread_count;                   // Worker threads running
+    int queue_count;                    // One per worker, plus one for other threads
+    p5__job_queue_t* queues;
+    p5__thread_t threads[P5__POOL_MAX_WORKERS];
+    p5__mutex_t lock;                   // Guards sleeping threads and stop
+    p5__cond_t cond;
+    uint32_t pending;                   // Jobs queued (atomic)
+    uint32_t sleeping;                  // Threads waiting on cond (atomic)
+    bool stop;
+} p5__pool_t;
+
+// Shape batching (internal)
+#define P5__SHAPE_CHUNK_MIN 256         // Fewest shapes worth a chunk of their own
+#define P5__SHAPE_MAX_CHUNKS 64
+
+// One deferred shape: a shape command (see p5__cmd_op_t) with its style
+typedef struct {
+    uint8_t op;
+    bool fill_enabled;
+    bool stroke_enabled;
+    sgp_color_ub4 fill_color;           // As sgp_set_color() would store them
+    sgp_color_ub4 stroke_color;
+    float stroke_width;
+    p5_transform_t transform;
+    float args[8];
+} p5__batched_shape_t;
+
+typedef struct {
+    bool enabled;
+    p5__batched_shape_t* shapes;
+    int count;
+    int capacity;
+    // Each chunk is tessellated in a context of its own into its recorder
+    p5_context_t* contexts[P5__SHAPE_MAX_CHUNKS];
+    p5_recorder_t* recorders[P5__SHAPE_MAX_CHUNKS];
+    int chunk_count;                    // Chunk contexts created
+} p5__shape_batch_t;
+
+// Fixed-timestep update (internal). Slots hold state copies: the last two
+// published, the two draw() reads and the one being stepped; these overlap
+// when draw() is up to date, and five always leave a slot to step into.
+#define P5__UPDATE_SLOTS 5
+
+typedef struct {
+    bool running;
+    bool threaded;                      // Steps run on thread, else in p5_update_states()
+    void (*update_fn)(void* state, float dt);
+    size_t state_size;
+    uint64_t step_ns;
+    uint8_t* states;                    // P5__UPDATE_SLOTS copies of the state
+    uint64_t times[P5__UPDATE_SLOTS];   // Clock time each published state stands for
+    int latest;                         // Last two published slots
+    int previous;
+    int reading[2];                     // Slots draw() reads, or -1
+    uint64_t steps;
+    uint64_t next_step;                 // When the next step is due (stepping thread only)
+    p5__thread_t thread;
+    p5__mutex_t lock;                   // Guards latest, previous, reading, times, steps
+    uint32_t stop;
+} p5__fixed_update_t;
+
+// Coroutines (internal)
+typedef struct {
+    p5_coroutine_t* pending;            // Run list, next to step first
+    float budget_ms;                    // 0 = P5_COROUTINE_BUDGET_MS
+    uint64_t deadline;                  // While stepping: when steps should yield, else 0
+    bool unlinked;                      // The run list changed during the current step
+} p5__coroutines_t;
+
+struct p5_coroutine_t {
+    bool (*step_fn)(void* ctx);
+    void* ctx;
+    bool done;
+    bool stepping;                      // In a call of step_fn
+    bool released;                      // Finished or cancelled from its own step, freed after it
+    bool finish;                        // Released by p5_coroutine_finish(): run the rest first
+    p5__coroutines_t* owner;            // Run list of the context that started it, or NULL after
+                                        // that context shut down
+    p5_coroutine_t* next;
+};
+
+// Pipelined frames (internal)
+typedef struct {
+    bool enabled;
+    bool running;                       // Worker thread started
+    p5_context_t* context;              // Where setup()/draw() run
+    p5_recorder_t* recorders[2];        // Frame being presented, frame being recorded
+    uint64_t draw_start[2];             // When each recorder's draw began
+    int presented;                      // recorders[] index presented last, or -1
+    int recording;                      // recorders[] index being recorded, or -1
+    bool looping;                       // p5_state.looping when last synced with the sketch
+    void (*draw_fn)(void);
+    p5__thread_t thread;
+    p5__mutex_t lock;
+    p5__cond_t cond;
+    bool busy;                          // Worker is recording (guarded by lock)
+    bool stop;
+} p5__pipeline_t;
+
+// Telemetry (internal)
+#ifdef P5_TELEMETRY
+#define P5__TELEMETRY_QUEUE 8          // Reports waiting for the writer thread
+#define P5__TELEMETRY_PATH_MAX 512
+
+// Per-frame counters reported as average and maximum
+typedef enum {
+    P5__METRIC_SHAPES,
+    P5__METRIC_VERTICES,
+    P5__METRIC_COMMANDS,
+    P5__METRIC_UNIFORMS,
+    P5__METRIC_DRAW_CALLS,
+    P5__METRIC_COUNT
+} p5__metric_t;
+
+typedef struct {
+    double uptime_s;
+    uint64_t frames_total;
+    uint64_t dropped_frames_total;      // Frames sgp discarded for lack of buffer space
+    uint64_t dropped_reports_total;     // Reports lost because the queue was full
+    p5_frame_stats_t frame_stats;
+    float latency_ms;                   // Last frame, see p5_frame_record_t.latency_ms
+    uint32_t frames;                    // Frames in this interval
+    uint64_t sum[P5__METRIC_COUNT];
+    uint32_t max[P5__METRIC_COUNT];     // Per-frame high-water mark in this interval
+    uint32_t capacity[P5__METRIC_COUNT]; // sgp buffer size, or 0
+} p5__telemetry_report_t;
+
+typedef struct {
+    bool running;
+    char path[P5__TELEMETRY_PATH_MAX];
+    uint64_t interval_ns;
+    uint64_t interval_start;
+    p5__telemetry_report_t current;     // Being accumulated by the main thread
+    p5__telemetry_report_t queue[P5__TELEMETRY_QUEUE];
+    uint32_t head;                      // Written by the main thread
+    uint32_t tail;                      // Written by the writer thread
+    uint32_t stop;
+    p5__thread_t thread;
+} p5__telemetry_t;
+#endif // P5_TELEMETRY
+
+// Batch-break diagnostics (internal)
+#ifdef P5_BATCH_DIAGNOSTICS
+#define P5__BATCH_HISTORY 64           // Commands remembered per sgp_begin() level
+#define P5__BATCH_LEVELS 4             // Nested sgp_begin() levels tracked
+
+// p5's model of one sgp command
+typedef struct {
+    bool barrier;                       // Viewport or scissor command
+    bool merged_away;                   // Folded into a later command (SGP_COMMAND_NONE)
+    sg_primitive_type primitive;
+    sgp_blend_mode blend_mode;
+    uint32_t pipeline;                  // Custom pipeline id, or 0
+    sgp_textures_uniform textures;
+    sgp_uniform uniform;                // Only compared for custom pipelines
+    float region[4];                    // Clip-space bounds x1, y1, x2, y2
+    uint32_t vertex_index;
+    uint32_t num_vertices;
+} p5__batch_command_t;
+
+typedef struct {
+    p5__batch_command_t commands[P5__BATCH_HISTORY];  // Ring, newest at count - 1
+    int count;
+    uint32_t cur_vertex;                // sgp's vertex buffer position
+} p5__batch_level_t;
+
+#define P5__BATCH_MAX_MOVE_VERTICES 96 // _SGP_MAX_MOVE_VERTICES
+
+typedef struct {
+    const char* file;                   // NULL for an empty slot
+    int line;
+    uint32_t counts[P5_BATCH_REASON_COUNT];
+} p5__batch_site_t;
+
+typedef struct {
+    bool enabled;
+    const char* site_file;              // Call site of the p5 call in progress
+    int site_line;
+    p5__batch_level_t levels[P5__BATCH_LEVELS];
+    int level;
+    p5__batch_site_t* sites;            // Open-addressing table
+    int site_count;
+    int site_capacity;
+    uint32_t totals[P5_BATCH_REASON_COUNT];
+} p5__batch_t;
+
+static void p5__batch_draw(sg_primitive_type primitive, const float* xy, int count);
+static void p5__batch_clear(void);
+static void p5__batch_barrier(void);
+static void p5__batch_begin(void);
+static void p5__batch_end(void);
+#define P5__BATCH_DRAW(primitive, xy, count) p5__batch_draw(primitive, xy, count)
+#define P5__BATCH_CLEAR() p5__batch_clear()
+#define P5__BATCH_BARRIER() p5__batch_barrier()
+#define P5__BATCH_BEGIN() p5__batch_begin()
+#define P5__BATCH_END() p5__batch_end()
+#else
+#define P5__BATCH_DRAW(primitive, xy, count) ((void)0)
+#define P5__BATCH_CLEAR() ((void)0)
+#define P5__BATCH_BARRIER() ((void)0)
+#define P5__BATCH_BEGIN() ((void)0)
+#define P5__BATCH_END() ((void)0)
+#endif // P5_BATCH_DIAGNOSTICS
+
+// Call tracing (internal)
+#ifdef P5_TRACE
+#define P5__TRACE_BUCKETS 48           // Power-of-two latency buckets, in cycles
+#define P5__TRACE_DEPTH 16             // Nested traced calls (e.g. from callbacks)
+
+typedef struct {
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+    uint64_t histogram[P5__TRACE_BUCKETS];  // Bucket b counts latencies below 2^b
+} p5__trace_entry_t;
+
+typedef struct {
+    p5__trace_entry_t entries[P5__TRACE_COUNT];
+    uint64_t starts[P5__TRACE_DEPTH];
+    int depth;
+    uint64_t reset_cycles;              // Cycle counter and clock at the last reset,
+    uint64_t reset_ns;                  // to convert cycles to time
+} p5__trace_t;
+#endif // P5_TRACE
+
+// Overdraw heat map (internal)
+#define P5__OVERDRAW_LAYERS 32         // Layers until the heat color saturates to white
+
+typedef struct {
+    bool enabled;
+    sgp_color_ub4 saved_color;          // sgp state around a heat-colored draw
+    sgp_blend_mode saved_blend_mode;
+    double shaded;                      // Pixels shaded this frame
+    float canvas_pixels;                // Largest viewport drawn to this frame
+    float average;                      // Last frame's shaded / canvas_pixels
+} p5__overdraw_t;
+
+static void p5__overdraw_count(sg_primitive_type primitive, const float* xy, int count);
+static void p5__overdraw_begin(sg_primitive_type primitive, const float* xy, int count);
+static void p5__overdraw_end(void);
+
+static void p5__draw_log(p5_draw_op_t op, const float* xy, int count);
+static void p5__recorder_emit(p5_recorder_t* rec, p5_draw_op_t op, const float* xy, int count);
+static uint64_t p5__hash_bytes(uint64_t hash, const void* data, size_t size);
+
+// sgp buffer high-water marks (internal)
+typedef struct {
+    p5_sgp_counts_t current;            // Peak of the frame in progress
+    bool sampled;                       // current holds a sample from this frame
+    p5_sgp_usage_t usage;
+} p5__sgp_usage_t;
+
+typedef struct {
+    uint64_t start;                     // p5__now_ns() at p5_init()
+    uint64_t frame_start;               // Start of the current frame
+    uint64_t deadline;                  // Earliest start of the next limited frame
+    float delta_ms;
+    int frame_count;
+    float target_fps;
+    float window[P5_FRAME_TIME_WINDOW]; // Recent frame times, oldest at window_next
+    int window_count;
+    int window_next;
+    double window_sum;
+    uint16_t histogram[P5__FRAME_TIME_BUCKETS];  // Bucket counts of window[]
+    float wait_ms;                      // Limiter wait before the current frame
+    uint64_t submit_start;              // Start of the submit phase, or 0
+    uint64_t draw_start;                // Start of the draw() this frame presents
+    float latency_ms;                   // Last frame, draw_start to p5_frame_end()
+    uint32_t shapes;                    // Shapes drawn this frame
+} p5__timing_t;
+
 // Drawing state (internal)
 typedef struct {
     p5_color_t fill_color;
@@ -344,8 +1531,54 @@ typedef struct {
     bool stroke_enabled;
     float stroke_width;
     p5_transform_t transform;
-    p5_transform_t transform_stack[32];
-    int transform_stack_depth;
+    p5__style_entry_t* style_stack;  // Grows on demand, reused across frames
+    int style_stack_count;
+    int style_stack_capacity;
+    int style_stack_depth;           // Number of open push() scopes
+    int style_lost_depth;            // Innermost open scopes that found no stack memory
+    uint32_t style_dirty;            // Field groups already saved in the current scope
+    p5_cmdlist_t* recording;         // Command list being recorded, or NULL
+    int recorded_scopes;             // push() scopes opened while recording and still open
+    p5_recorder_t* recorder;         // Recorder tessellating shapes, or NULL
+    p5_cmdlist_t capture;            // Commands of the frame being captured
+    FILE* capture_file;              // Open frame capture file, or NULL
+    int capture_frames_left;         // Frames until capture stops (0 = unlimited)
+    p5_capture_style_t capture_style; // Style the frame being captured began with
+    uint32_t capture_frame_count;
+    p5_graphics_t* graphics_pool;    // All graphics buffers, in use or parked
+    p5_graphics_t* graphics_target;  // Buffer being drawn into, or NULL
+    FILE* graphics_saved_capture;    // Capture paused while drawing into a buffer
+    p5_cmdlist_t* graphics_saved_recording; // Recording paused while drawing into a buffer
+    sg_sampler graphics_sampler;
+    p5__incremental_t incremental;
+    bool looping;                    // false after noLoop()
+    bool redraw_pending;             // redraw() or an input event while not looping
+    bool loop_caching;               // Current frame is drawn into loop_target
+    bool loop_direct;                // Current frame is drawn for the window, in a nested sgp frame
+    int loop_width, loop_height;     // Canvas size when the current frame began
+    p5_graphics_t* loop_target;      // Last frame, re-presented while not looping
+    p5__timing_t timing;
+    p5__watchdog_t watchdog;
+    p5__sgp_usage_t sgp_usage;
+    p5__overdraw_t overdraw;
+    p5__pipeline_t pipeline;
+    p5__shape_batch_t shape_batch;
+    p5__fixed_update_t fixed_update;
+    p5__coroutines_t coroutines;
+    p5_draw_log_t* draw_log;         // Active draw log, or NULL
+    p5__alloc_t alloc;
+#ifdef P5_TRACE
+    p5__trace_t trace;
+#endif
+#ifdef P5_BATCH_DIAGNOSTICS
+    p5__batch_t batch;
+#endif
+#ifdef P5_TELEMETRY
+    p5__telemetry_t telemetry;
+#endif
+#ifdef P5_HEADLESS
+    int headless_width, headless_height;
+#endif
     p5_canvas_t canvas;
     bool setup_has_drawn;  // Internal flag for p5.js compatibility  
     bool in_setup_mode;    // Currently executing setup() - for p5.js compatibility
@@ -359,13 +1592,51 @@ typedef struct {
 // GLOBAL STATE
 //
 
-p5_state_t p5_state;
+#if defined(_MSC_VER)
+#define P5__THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define P5__THREAD_LOCAL _Thread_local
+#else
+#define P5__THREAD_LOCAL __thread
+#endif
+
+struct p5_context_t {
+    p5_state_t state;
+};
+
+// The global API acts on the calling thread's current context
+static p5_context_t p5__default_context;
+static P5__THREAD_LOCAL p5_context_t* p5__current = &p5__default_context;
+#define p5_state (p5__current->state)
 
 //
 // SOKOL WRAPPER FUNCTIONS (only compiled when app mode is enabled)
 //
 #ifndef P5_NO_APP
 
+#ifndef P5_OVERDRAW_KEY
+#define P5_OVERDRAW_KEY SAPP_KEYCODE_F2
+#endif
+
+static uint64_t p5__now_ns(void);
+static void p5__sgp_sample(void);
+static void p5__pipeline_collect(void (*draw_fn)(void));
+static void p5__pipeline_submit(void (*draw_fn)(void));
+
+// One frame of the sketch: setup() and draw()
+static void p5__sketch_draw(void) {
+    // P5.js compatibility: Execute setup() drawing commands every frame
+    // This simulates canvas persistence by redrawing setup() content each frame
+    p5_state.in_setup_mode = true;
+    setup();
+    p5_state.setup_has_drawn = true;
+    p5_state.in_setup_mode = false;
+    
+    // Call draw() for any additional per-frame drawing
+    draw();
+    p5_flush_shapes();
+}
+
 void p5_sokol_init(void) {
     sg_setup(&(sg_desc){
         .environment = sglue_environment(),
@@ -377,8 +1648,13 @@ void p5_sokol_init(void) {
 }
 
 void p5_sokol_frame(void) {
+    p5_frame_begin();
     sgp_begin(sapp_width(), sapp_height());
     
+    // Pipelined: wait for this frame's recording (and its canvas)
+    bool pipelined = p5_state.pipeline.enabled;
+    if (pipelined) p5__pipeline_collect(p5__sketch_draw);
+    
     // Set viewport to canvas area if canvas was created
     if (p5_state.canvas.created) {
         sgp_viewport(p5_state.canvas.x, p5_state.canvas.y, 
@@ -391,40 +1667,74 @@ void p5_sokol_frame(void) {
         sgp_project(0.0f, (float)sapp_width(), 0.0f, (float)sapp_height());
     }
     
-    // P5.js compatibility: Execute setup() drawing commands every frame
-    // This simulates canvas persistence by redrawing setup() content each frame
-    p5_state.in_setup_mode = true;
-    if (!p5_state.setup_has_drawn) {
-        setup();  // Call user setup - this will draw every frame now
-        p5_state.setup_has_drawn = true;
-    } else {
-        // Re-execute setup() drawing commands to maintain image persistence
-        setup();  // Setup always gets called to redraw its content
+    p5_run_coroutines();
+    if (pipelined) {
+        // Start recording the next frame, then draw this one
+        p5__pipeline_submit(p5__sketch_draw);
+    } else if (p5_loop_frame_begin()) {  // Not looping: re-present the cached frame
+        p5_incremental_frame_begin();
+        p5__sketch_draw();
+        p5_incremental_frame_end();
+        if (p5_state.capture_file) p5_capture_frame();
     }
-    p5_state.in_setup_mode = false;
-    
-    // Call draw() for any additional per-frame drawing
-    draw();
+    if (!pipelined) p5_loop_frame_end();
+    p5_overdraw_legend();
     
+    // The heat map adds onto the cleared window, which must be black rather
+    // than sokol's default gray
+    sg_pass_action action = {0};
+    if (p5_state.overdraw.enabled) {
+        action.colors[0].load_action = SG_LOADACTION_CLEAR;
+        action.colors[0].clear_value = (sg_color){ 0.0f, 0.0f, 0.0f, 1.0f };
+    }
+    p5_state.timing.submit_start = p5__now_ns();
     sg_begin_pass(&(sg_pass){
+        .action = action,
         .swapchain = sglue_swapchain()
     });
+    p5__sgp_sample();
     sgp_flush();
     sgp_end();
     sg_end_pass();
     sg_commit();
+    p5_frame_end();
 }
 
 void p5_sokol_cleanup(void) {
+    p5_sgp_usage_print();
+    p5_alloc_stats_print();
+    p5_shutdown();
     sgp_shutdown();
     sg_shutdown();
 }
 
 void p5_sokol_event(const sapp_event* ev) {
+    // Input wakes a sketch that is not looping
+    switch (ev->type) {
+        case SAPP_EVENTTYPE_KEY_DOWN:
+        case SAPP_EVENTTYPE_KEY_UP:
+        case SAPP_EVENTTYPE_CHAR:
+        case SAPP_EVENTTYPE_MOUSE_DOWN:
+        case SAPP_EVENTTYPE_MOUSE_UP:
+        case SAPP_EVENTTYPE_MOUSE_SCROLL:
+        case SAPP_EVENTTYPE_MOUSE_MOVE:
+        case SAPP_EVENTTYPE_TOUCHES_BEGAN:
+        case SAPP_EVENTTYPE_TOUCHES_MOVED:
+        case SAPP_EVENTTYPE_TOUCHES_ENDED:
+        case SAPP_EVENTTYPE_RESIZED:
+            p5_redraw();
+            break;
+        default:
+            break;
+    }
+    
     if (ev->type == SAPP_EVENTTYPE_KEY_DOWN) {
         if (ev->key_code == SAPP_KEYCODE_ESCAPE) {
             sapp_quit();
         }
+        if (ev->key_code == P5_OVERDRAW_KEY && !ev->key_repeat) {
+            p5_overdraw(!p5_is_overdraw());
+        }
     }
 }
 #endif // P5_NO_APP
@@ -433,15 +1743,122 @@ void p5_sokol_event(const sapp_event* ev) {
 // INTERNAL FUNCTIONS (p5__ prefix)
 //
 
+// Same conversion as sgp_set_color()
+static inline sgp_color_ub4 p5__color_ub4(p5_color_t color) {
+    return (sgp_color_ub4){
+        (uint8_t)fminf(fmaxf(color.r * 255.0f, 0.0f), 255.0f),
+        (uint8_t)fminf(fmaxf(color.g * 255.0f, 0.0f), 255.0f),
+        (uint8_t)fminf(fmaxf(color.b * 255.0f, 0.0f), 255.0f),
+        (uint8_t)fminf(fmaxf(color.a * 255.0f, 0.0f), 255.0f)
+    };
+}
+
+// Batched shapes go first, so draws stay in call order
+#define P5__FLUSH_SHAPES() \
+    do { \
+        if (p5_state.shape_batch.count) p5_flush_shapes(); \
+    } while(0)
+
+// sgp drawing used by p5, observed by batch-break diagnostics, the overdraw
+// heat map and draw logs, or tessellated into the active recorder
+static inline void p5__sgp_color(p5_color_t color) {
+    if (p5_state.recorder) {
+        p5_state.recorder->color = p5__color_ub4(color);
+        return;
+    }
+    sgp_set_color(color.r, color.g, color.b, color.a);
+}
+
+static inline void p5__sgp_triangle(float ax, float ay, float bx, float by, float cx, float cy) {
+    const float xy[] = { ax, ay, bx, by, cx, cy };
+    if (p5_state.recorder) {
+        p5__recorder_emit(p5_state.recorder, P5_DRAW_TRIANGLE, xy, 3);
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    P5__BATCH_DRAW(SG_PRIMITIVETYPE_TRIANGLES, xy, 3);
+    if (p5_state.draw_log) p5__draw_log(P5_DRAW_TRIANGLE, xy, 3);
+    if (p5_state.overdraw.enabled) p5__overdraw_begin(SG_PRIMITIVETYPE_TRIANGLES, xy, 3);
+    sgp_draw_filled_triangle(ax, ay, bx, by, cx, cy);
+    if (p5_state.overdraw.enabled) p5__overdraw_end();
+}
+
+static inline void p5__sgp_rect(float x, float y, float w, float h) {
+    const float xy[] = { x, y, x + w, y, x + w, y + h, x, y + h };
+    if (p5_state.recorder) {
+        p5__recorder_emit(p5_state.recorder, P5_DRAW_RECT, xy, 4);
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    P5__BATCH_DRAW(SG_PRIMITIVETYPE_TRIANGLES, xy, 4);
+    if (p5_state.draw_log) p5__draw_log(P5_DRAW_RECT, xy, 4);
+    if (p5_state.overdraw.enabled) p5__overdraw_begin(SG_PRIMITIVETYPE_TRIANGLES, xy, 4);
+    sgp_draw_filled_rect(x, y, w, h);
+    if (p5_state.overdraw.enabled) p5__overdraw_end();
+}
+
+static inline void p5__sgp_line(float ax, float ay, float bx, float by) {
+    const float xy[] = { ax, ay, bx, by };
+    if (p5_state.recorder) {
+        p5__recorder_emit(p5_state.recorder, P5_DRAW_LINE, xy, 2);
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    P5__BATCH_DRAW(SG_PRIMITIVETYPE_LINES, xy, 2);
+    if (p5_state.draw_log) p5__draw_log(P5_DRAW_LINE, xy, 2);
+    if (p5_state.overdraw.enabled) p5__overdraw_begin(SG_PRIMITIVETYPE_LINES, xy, 2);
+    sgp_draw_line(ax, ay, bx, by);
+    if (p5_state.overdraw.enabled) p5__overdraw_end();
+}
+
+static inline void p5__sgp_point(float x, float y) {
+    const float xy[] = { x, y };
+    if (p5_state.recorder) {
+        p5__recorder_emit(p5_state.recorder, P5_DRAW_POINT, xy, 1);
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    P5__BATCH_DRAW(SG_PRIMITIVETYPE_POINTS, xy, 1);
+    if (p5_state.draw_log) p5__draw_log(P5_DRAW_POINT, xy, 1);
+    if (p5_state.overdraw.enabled) p5__overdraw_begin(SG_PRIMITIVETYPE_POINTS, xy, 1);
+    sgp_draw_point(x, y);
+    if (p5_state.overdraw.enabled) p5__overdraw_end();
+}
+
+// Textured draws keep their colors in the heat map (they composite buffers
+// that were already drawn in it) but their pixels are counted
+static inline void p5__sgp_textured_rect(int channel, sgp_rect dest, sgp_rect src) {
+    const float xy[] = { dest.x, dest.y, dest.x + dest.w, dest.y,
+                         dest.x + dest.w, dest.y + dest.h, dest.x, dest.y + dest.h };
+    P5__FLUSH_SHAPES();
+    P5__BATCH_DRAW(SG_PRIMITIVETYPE_TRIANGLES, xy, 4);
+    if (p5_state.draw_log) p5__draw_log(P5_DRAW_TEXTURED_RECT, xy, 4);
+    if (p5_state.overdraw.enabled) p5__overdraw_count(SG_PRIMITIVETYPE_TRIANGLES, xy, 4);
+    sgp_draw_textured_rect(channel, dest, src);
+}
+
+static inline void p5__sgp_clear(void) {
+    if (p5_state.recorder) {
+        p5__recorder_emit(p5_state.recorder, P5_DRAW_CLEAR, NULL, 0);
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    P5__BATCH_CLEAR();
+    if (p5_state.draw_log) p5__draw_log(P5_DRAW_CLEAR, NULL, 0);
+    if (p5_state.overdraw.enabled) p5__overdraw_begin(SG_PRIMITIVETYPE_TRIANGLES, NULL, 0);
+    sgp_clear();
+    if (p5_state.overdraw.enabled) p5__overdraw_end();
+}
+
 // Helper function to draw connected thick lines with proper corner joining
 static void p5__draw_thick_polygon_outline(float* points, int num_points, float thickness, bool closed) {
     if (num_points < 2 || thickness <= 1.0f) {
         // Fall back to thin lines for simple cases
         for (int i = 0; i < num_points - 1; i++) {
-            sgp_draw_line(points[i*2], points[i*2+1], points[(i+1)*2], points[(i+1)*2+1]);
+            p5__sgp_line(points[i*2], points[i*2+1], points[(i+1)*2], points[(i+1)*2+1]);
         }
         if (closed && num_points > 2) {
-            sgp_draw_line(points[(num_points-1)*2], points[(num_points-1)*2+1], points[0], points[1]);
+            p5__sgp_line(points[(num_points-1)*2], points[(num_points-1)*2+1], points[0], points[1]);
         }
         return;
     }
@@ -476,8 +1893,8 @@ static void p5__draw_thick_polygon_outline(float* points, int num_points, float
         float x2b = x2 - nx, y2b = y2 - ny;
         
         // Draw as two triangles to form a rectangle
-        sgp_draw_filled_triangle(x1a, y1a, x1b, y1b, x2a, y2a);
-        sgp_draw_filled_triangle(x1b, y1b, x2b, y2b, x2a, y2a);
+        p5__sgp_triangle(x1a, y1a, x1b, y1b, x2a, y2a);
+        p5__sgp_triangle(x1b, y1b, x2b, y2b, x2a, y2a);
     }
     
     // Draw corner joints to fill gaps (using smaller, more precise caps)
@@ -515,7 +1932,7 @@ static void p5__draw_thick_polygon_outline(float* points, int num_points, float
         if (angle > 0.1f && angle < PI - 0.1f) {
             // Draw a smaller cap - just enough to cover the gap
             float cap_size = thickness * 0.3f; // Much smaller than before
-            sgp_draw_filled_rect(cx - cap_size, cy - cap_size, cap_size * 2, cap_size * 2);
+            p5__sgp_rect(cx - cap_size, cy - cap_size, cap_size * 2, cap_size * 2);
         }
     }
 }
@@ -524,7 +1941,7 @@ static void p5__draw_thick_polygon_outline(float* points, int num_points, float
 static void p5__draw_thick_line(float x1, float y1, float x2, float y2, float thickness) {
     if (thickness <= 1.0f) {
         // Use thin line for thickness <= 1
-        sgp_draw_line(x1, y1, x2, y2);
+        p5__sgp_line(x1, y1, x2, y2);
         return;
     }
     
@@ -536,7 +1953,7 @@ static void p5__draw_thick_line(float x1, float y1, float x2, float y2, float th
     if (length < 0.001f) {
         // Zero-length line, draw as a point (small circle)
         float radius = thickness * 0.5f;
-        sgp_draw_filled_rect(x1 - radius, y1 - radius, thickness, thickness);
+        p5__sgp_rect(x1 - radius, y1 - radius, thickness, thickness);
         return;
     }
     
@@ -555,12 +1972,21 @@ static void p5__draw_thick_line(float x1, float y1, float x2, float y2, float th
     float x2b = x2 - nx, y2b = y2 - ny;
     
     // Draw as two triangles to form a rectangle
-    sgp_draw_filled_triangle(x1a, y1a, x1b, y1b, x2a, y2a);
-    sgp_draw_filled_triangle(x1b, y1b, x2b, y2b, x2a, y2a);
+    p5__sgp_triangle(x1a, y1a, x1b, y1b, x2a, y2a);
+    p5__sgp_triangle(x1b, y1b, x2b, y2b, x2a, y2a);
 }
 
 // Helper function to apply current transform
 static void p5__apply_transform(void) {
+    if (p5_state.recorder) {
+        // The matrix sgp builds from an identity transform
+        const p5_transform_t* t = &p5_state.transform;
+        float (*m)[3] = p5_state.recorder->transform;
+        float sint = sinf(t->rot), cost = cosf(t->rot);
+        m[0][0] = cost * t->sx; m[0][1] = -sint * t->sy; m[0][2] = t->tx;
+        m[1][0] = sint * t->sx; m[1][1] = cost * t->sy;  m[1][2] = t->ty;
+        return;
+    }
     if (p5_state.transform.tx != 0.0f || p5_state.transform.ty != 0.0f ||
         p5_state.transform.rot != 0.0f || 
         p5_state.transform.sx != 1.0f || p5_state.transform.sy != 1.0f) {
@@ -578,6 +2004,7 @@ static void p5__apply_transform(void) {
 }
 
 static void p5__restore_transform(void) {
+    if (p5_state.recorder) return;
     if (p5_state.transform.tx != 0.0f || p5_state.transform.ty != 0.0f ||
         p5_state.transform.rot != 0.0f || 
         p5_state.transform.sx != 1.0f || p5_state.transform.sy != 1.0f) {
@@ -585,10 +2012,438 @@ static void p5__restore_transform(void) {
     }
 }
 
+// Monotonic clock in nanoseconds
+static uint64_t p5__now_ns(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)freq.QuadPart);
+#elif defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(__EMSCRIPTEN__)
+    return (uint64_t)(emscripten_get_now() * 1e6);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000000u + (uint64_t)tv.tv_usec * 1000u;
+#endif
+}
+
+// Block the calling thread for about ns nanoseconds. Windows sleeps in
+// scheduler ticks (15.6 ms by default), so the timer resolution is raised
+// to 1 ms for the duration of the sleep.
+static void p5__sleep_ns(uint64_t ns) {
+#if defined(_WIN32)
+    timeBeginPeriod(1);
+    Sleep((DWORD)(ns / 1000000u));
+    timeEndPeriod(1);
+#elif defined(__EMSCRIPTEN__)
+    (void)ns;  // The browser paces frames; never block its thread
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts = { (time_t)(ns / 1000000000u), (long)(ns % 1000000000u) };
+    nanosleep(&ts, NULL);
+#else
+    struct timeval tv = { (time_t)(ns / 1000000000u), (long)(ns % 1000000000u / 1000u) };
+    select(0, NULL, NULL, NULL, &tv);
+#endif
+}
+
+// Wait until the clock reaches deadline: sleep while the OS timer is
+// precise enough, then spin the last P5_FRAME_SPIN_MS
+static void p5__wait_until(uint64_t deadline) {
+    const uint64_t spin_ns = (uint64_t)(P5_FRAME_SPIN_MS * 1e6);
+    uint64_t now = p5__now_ns();
+#if defined(__EMSCRIPTEN__)
+    if (now < deadline) return;  // The browser paces frames; never block its thread
+#endif
+    while (now + spin_ns < deadline) {
+        p5__sleep_ns(deadline - now - spin_ns);
+        now = p5__now_ns();
+    }
+    while (now < deadline) now = p5__now_ns();
+}
+
+// Threads, locks and condition variables
+static bool p5__thread_start(p5__thread_t* thread, p5__thread_fn_t fn, void* arg) {
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *thread != NULL;
+#else
+    return pthread_create(thread, NULL, fn, arg) == 0;
+#endif
+}
+
+static void p5__thread_join(p5__thread_t thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+#ifdef _WIN32
+#define p5__mutex_init(m) InitializeCriticalSection(m)
+#define p5__mutex_destroy(m) DeleteCriticalSection(m)
+#define p5__mutex_lock(m) EnterCriticalSection(m)
+#define p5__mutex_unlock(m) LeaveCriticalSection(m)
+#define p5__cond_init(c) InitializeConditionVariable(c)
+#define p5__cond_destroy(c) ((void)(c))
+#define p5__cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define p5__cond_broadcast(c) WakeAllConditionVariable(c)
+#define p5__cond_signal(c) WakeConditionVariable(c)
+#else
+#define p5__mutex_init(m) pthread_mutex_init(m, NULL)
+#define p5__mutex_destroy(m) pthread_mutex_destroy(m)
+#define p5__mutex_lock(m) pthread_mutex_lock(m)
+#define p5__mutex_unlock(m) pthread_mutex_unlock(m)
+#define p5__cond_init(c) pthread_cond_init(c, NULL)
+#define p5__cond_destroy(c) pthread_cond_destroy(c)
+#define p5__cond_wait(c, m) pthread_cond_wait(c, m)
+#define p5__cond_broadcast(c) pthread_cond_broadcast(c)
+#define p5__cond_signal(c) pthread_cond_signal(c)
+#endif
+
+// sgp ran out of buffer space, so the pending flush draws nothing
+static bool p5__sgp_buffer_full(sgp_error error) {
+    return error == SGP_ERROR_VERTICES_FULL || error == SGP_ERROR_UNIFORMS_FULL ||
+           error == SGP_ERROR_COMMANDS_FULL;
+}
+
+static void p5__sgp_counts_max(p5_sgp_counts_t* peak, const p5_sgp_counts_t* counts) {
+    if (counts->vertices > peak->vertices) peak->vertices = counts->vertices;
+    if (counts->commands > peak->commands) peak->commands = counts->commands;
+    if (counts->uniforms > peak->uniforms) peak->uniforms = counts->uniforms;
+}
+
+// Record sgp buffer use before a flush rewinds it. A throwaway nested
+// sgp_begin() exposes the current buffer positions as its base indexes.
+static void p5__sgp_sample(void) {
+    p5__sgp_usage_t* u = &p5_state.sgp_usage;
+    sgp_desc desc = sgp_query_desc();
+    p5_sgp_counts_t counts = {0};
+    sgp_error error = sgp_get_last_error();
+    
+    if (p5__sgp_buffer_full(error)) {
+        // sgp_begin() would clear the error and let the flush draw; the
+        // overflowing buffer was full and nothing else is known
+        if (error == SGP_ERROR_VERTICES_FULL) counts.vertices = desc.max_vertices;
+        if (error == SGP_ERROR_COMMANDS_FULL) counts.commands = desc.max_commands;
+        if (error == SGP_ERROR_UNIFORMS_FULL) counts.uniforms = desc.max_commands;
+    } else if (error == SGP_NO_ERROR) {
+        sgp_begin(1, 1);
+        const sgp_state* state = sgp_query_state();
+        counts.vertices = state->_base_vertex;
+        counts.commands = state->_base_command;
+        counts.uniforms = state->_base_uniform;
+        sgp_end();
+    }
+    p5__sgp_counts_max(&u->current, &counts);
+    u->sampled = true;
+}
+
+// Close the frame's high-water marks; applications that flush themselves
+// get an estimate from the frame stats of the frame just committed
+static void p5__sgp_usage_frame(void) {
+    p5__sgp_usage_t* u = &p5_state.sgp_usage;
+    if (!u->sampled) {
+        sg_frame_stats stats = sg_query_frame_stats();
+        u->current.vertices = stats.size_append_buffer / (uint32_t)sizeof(sgp_vertex);
+        u->current.commands = stats.num_draw + stats.num_apply_viewport + stats.num_apply_scissor_rect;
+        u->current.uniforms = stats.num_apply_uniforms;
+    }
+    if (p5__sgp_buffer_full(sgp_get_last_error())) u->usage.dropped_frames++;
+    
+    u->usage.frame = u->current;
+    p5__sgp_counts_max(&u->usage.run, &u->current);
+    u->current = (p5_sgp_counts_t){0};
+    u->sampled = false;
+}
+
+// Counted heap allocation through the P5_MALLOC hooks
+static void* p5__malloc(size_t size) {
+    p5_state.alloc.allocations++;
+    return P5_MALLOC(size);
+}
+
+static void* p5__calloc(size_t count, size_t size) {
+    void* ptr = p5__malloc(count * size);
+    if (ptr) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+static void* p5__realloc(void* ptr, size_t size) {
+    p5_state.alloc.allocations++;
+    return P5_REALLOC(ptr, size);
+}
+
+static void p5__free(void* ptr) {
+    if (!ptr) return;
+    p5_state.alloc.frees++;
+    P5_FREE(ptr);
+}
+
+// Transient scratch memory, valid until the next p5_frame_begin(). Callers
+// that are done earlier hand it back with p5__frame_rewind() so drawing
+// outside a frame loop does not grow the arena.
+static void* p5__frame_alloc(size_t size) {
+    p5__arena_t* a = &p5_state.alloc.arena;
+    size = (size + P5__ARENA_ALIGN - 1) & ~(size_t)(P5__ARENA_ALIGN - 1);
+    if (!a->base) {
+        a->base = (uint8_t*)p5__malloc(P5_FRAME_ARENA_SIZE);
+        if (!a->base) return NULL;
+        a->capacity = P5_FRAME_ARENA_SIZE;
+    }
+    
+    void* ptr;
+    if (a->used + size <= a->capacity) {
+        ptr = a->base + a->used;
+        a->used += size;
+    } else {
+        // Block header is padded so the data stays aligned
+        size_t header = (sizeof(p5__arena_block_t) + P5__ARENA_ALIGN - 1) & ~(size_t)(P5__ARENA_ALIGN - 1);
+        p5__arena_block_t* block = (p5__arena_block_t*)p5__malloc(header + size);
+        if (!block) {
+            printf("[WARNING] p5: out of memory for %zu bytes of frame scratch\n", size);
+            return NULL;
+        }
+        block->next = a->overflow;
+        block->size = size;
+        a->overflow = block;
+        a->overflow_used += size;
+        ptr = (uint8_t*)block + header;
+    }
+    if (a->used + a->overflow_used > a->peak) a->peak = a->used + a->overflow_used;
+    return ptr;
+}
+
+static size_t p5__frame_mark(void) {
+    return p5_state.alloc.arena.used;
+}
+
+static void p5__frame_rewind(size_t mark) {
+    p5_state.alloc.arena.used = mark;
+}
+
+// Start a new frame of scratch; an arena that overflowed grows to the peak
+static void p5__arena_reset(void) {
+    p5__arena_t* a = &p5_state.alloc.arena;
+    if (a->overflow) {
+        while (a->overflow) {
+            p5__arena_block_t* next = a->overflow->next;
+            p5__free(a->overflow);
+            a->overflow = next;
+        }
+        size_t capacity = a->capacity;
+        while (capacity < a->peak) capacity *= 2;
+        p5__free(a->base);
+        a->base = (uint8_t*)p5__malloc(capacity);
+        a->capacity = a->base ? capacity : 0;
+    }
+    a->used = 0;
+    a->overflow_used = 0;
+    a->last_peak = a->peak;
+    a->peak = 0;
+}
+
+static void p5__arena_free(void) {
+    p5__arena_t* a = &p5_state.alloc.arena;
+    p5__arena_reset();
+    p5__free(a->base);
+    *a = (p5__arena_t){0};
+}
+
+// Roll the per-frame allocation counters at a frame boundary
+static void p5__alloc_frame(bool counted) {
+    p5__alloc_t* al = &p5_state.alloc;
+    if (counted) {
+        al->frame_allocations = (uint32_t)(al->allocations - al->frame_start_allocations);
+        al->frame_frees = (uint32_t)(al->frees - al->frame_start_frees);
+        if (al->frame_allocations > 0) al->allocating_frames++;
+    }
+    p5__arena_reset();
+    al->frame_start_allocations = al->allocations;
+    al->frame_start_frees = al->frees;
+}
+
+// Make room for one more style stack entry, doubling the allocation as needed.
+// The stack serves as its own arena rather than taking entries from the frame
+// arena: push() scopes may outlive a frame (noLoop, command lists), and pop()
+// releases entries in LIFO order, so one buffer that only grows and is reused
+// across frames allocates nothing once it has reached the sketch's depth.
+static bool p5__style_reserve(void) {
+    if (p5_state.style_stack_count < p5_state.style_stack_capacity) return true;
+    
+    int capacity = p5_state.style_stack_capacity ? p5_state.style_stack_capacity * 2 : 64;
+    p5__style_entry_t* stack = (p5__style_entry_t*)p5__realloc(p5_state.style_stack, 
+                                                                capacity * sizeof(p5__style_entry_t));
+    if (!stack) {
+        printf("[WARNING] p5: out of memory growing style stack (depth %d)\n", p5_state.style_stack_depth);
+        return false;
+    }
+    p5_state.style_stack = stack;
+    p5_state.style_stack_capacity = capacity;
+    return true;
+}
+
+// Copy a field group onto the style stack before its first change inside a push() scope
+static void p5__style_save(uint32_t field) {
+    if (p5_state.style_stack_depth == p5_state.style_lost_depth || (p5_state.style_dirty & field)) return;
+    if (!p5__style_reserve()) return;
+    
+    p5__style_entry_t* e = &p5_state.style_stack[p5_state.style_stack_count++];
+    e->field = field;
+    switch (field) {
+        case P5__STYLE_FILL:
+            e->as.paint.color = p5_state.fill_color;
+            e->as.paint.enabled = p5_state.fill_enabled;
+            break;
+        case P5__STYLE_STROKE:
+            e->as.paint.color = p5_state.stroke_color;
+            e->as.paint.enabled = p5_state.stroke_enabled;
+            break;
+        case P5__STYLE_STROKE_WEIGHT:
+            e->as.stroke_width = p5_state.stroke_width;
+            break;
+        case P5__STYLE_TRANSFORM:
+            e->as.transform = p5_state.transform;
+            break;
+        case P5__STYLE_ANGLE_MODE:
+            e->as.angle_mode = p5_state.angle_mode;
+            break;
+        case P5__STYLE_COLOR_MODE:
+            e->as.color_mode.mode = p5_state.color_mode;
+            memcpy(e->as.color_mode.maxes, p5_state.color_maxes, sizeof(p5_state.color_maxes));
+            break;
+    }
+    p5_state.style_dirty |= field;
+}
+
+// Append raw bytes to a command list, doubling the allocation as needed
+static bool p5__cmdlist_append(p5_cmdlist_t* list, const void* bytes, size_t size) {
+    if (list->size + size > list->capacity) {
+        size_t capacity = list->capacity ? list->capacity : 256;
+        while (capacity < list->size + size) capacity *= 2;
+        uint8_t* data = (uint8_t*)p5__realloc(list->data, capacity);
+        if (!data) {
+            printf("[WARNING] p5: out of memory growing command list (%zu bytes)\n", list->size);
+            return false;
+        }
+        list->data = data;
+        list->capacity = capacity;
+    }
+    memcpy(list->data + list->size, bytes, size);
+    list->size += size;
+    return true;
+}
+
+static void p5__cmdlist_write(p5_cmdlist_t* list, p5__cmd_op_t op, const float* args, int count) {
+    uint8_t buffer[1 + 8 * sizeof(float)];
+    buffer[0] = (uint8_t)op;
+    if (count > 0) memcpy(buffer + 1, args, count * sizeof(float));
+    p5__cmdlist_append(list, buffer, 1 + count * sizeof(float));
+}
+
+// Route a call to the active command list or frame capture.
+// Returns true when the call was recorded and must not be drawn.
+static bool p5__record(p5__cmd_op_t op, const float* args, int count) {
+    if (p5_state.recording) {
+        p5__cmdlist_write(p5_state.recording, op, args, count);
+        return true;
+    }
+    p5__cmdlist_write(&p5_state.capture, op, args, count);
+    return false;
+}
+
+// Capture a call if recording or capturing; return from the caller if recording
+#define P5__RECORD(op, ...) \
+    do { \
+        if (p5_state.recording || p5_state.capture_file) { \
+            const float p5__args[] = { __VA_ARGS__ }; \
+            if (p5__record(op, p5__args, sizeof(p5__args) / sizeof(float))) return; \
+        } \
+    } while(0)
+
+#define P5__RECORD_OP(op) \
+    do { \
+        if (p5_state.recording || p5_state.capture_file) { \
+            if (p5__record(op, NULL, 0)) return; \
+        } \
+    } while(0)
+
+static void p5__shape_batch_add(p5__cmd_op_t op, const float* args, int count);
+
+// Store a shape for p5_flush_shapes() and return from the caller if batching
+#define P5__BATCH_SHAPE(op, ...) \
+    do { \
+        if (p5_state.shape_batch.enabled && !p5_state.recorder && \
+            p5_state.incremental.pass == P5__PASS_NONE) { \
+            const float p5__args[] = { __VA_ARGS__ }; \
+            p5__shape_batch_add(op, p5__args, sizeof(p5__args) / sizeof(float)); \
+            return; \
+        } \
+    } while(0)
+
+// Window size (the sokol_app window, or the p5_headless_size() size)
+static int p5__window_width(void) {
+#ifdef P5_HEADLESS
+    return p5_state.headless_width;
+#else
+    return sapp_width();
+#endif
+}
+
+static int p5__window_height(void) {
+#ifdef P5_HEADLESS
+    return p5_state.headless_height;
+#else
+    return sapp_height();
+#endif
+}
+
+// Write a saved field group back into p5_state
+static void p5__style_restore(const p5__style_entry_t* e) {
+    switch (e->field) {
+        case P5__STYLE_FILL:
+            p5_state.fill_color = e->as.paint.color;
+            p5_state.fill_enabled = e->as.paint.enabled;
+            break;
+        case P5__STYLE_STROKE:
+            p5_state.stroke_color = e->as.paint.color;
+            p5_state.stroke_enabled = e->as.paint.enabled;
+            break;
+        case P5__STYLE_STROKE_WEIGHT:
+            p5_state.stroke_width = e->as.stroke_width;
+            break;
+        case P5__STYLE_TRANSFORM:
+            p5_state.transform = e->as.transform;
+            break;
+        case P5__STYLE_ANGLE_MODE:
+            p5_state.angle_mode = e->as.angle_mode;
+            break;
+        case P5__STYLE_COLOR_MODE:
+            p5_state.color_mode = e->as.color_mode.mode;
+            memcpy(p5_state.color_maxes, e->as.color_mode.maxes, sizeof(p5_state.color_maxes));
+            break;
+    }
+}
+
 //
 // PUBLIC API IMPLEMENTATION
 //
 
+#ifdef P5_TRACE
+static void p5__trace_calibrate(void);
+#endif
+
 void p5_init(void) {
     p5_state.fill_color = (p5_color_t){1.0f, 1.0f, 1.0f, 1.0f};
     p5_state.stroke_color = (p5_color_t){0.0f, 0.0f, 0.0f, 1.0f};
@@ -596,7 +2451,10 @@ void p5_init(void) {
     p5_state.stroke_enabled = true;
     p5_state.stroke_width = 1.0f;
     p5_state.transform = (p5_transform_t){0.0f, 0.0f, 0.0f, 1.0f, 1.0f};
-    p5_state.transform_stack_depth = 0;
+    p5_state.style_stack_count = 0;    // Keep the allocation for reuse
+    p5_state.style_stack_depth = 0;
+    p5_state.style_lost_depth = 0;
+    p5_state.style_dirty = 0;
     p5_state.canvas.created = false;
     p5_state.canvas.width = 0;
     p5_state.canvas.height = 0;
@@ -610,13 +2468,133 @@ void p5_init(void) {
     p5_state.color_maxes[1] = 255.0f;  // G max
     p5_state.color_maxes[2] = 255.0f;  // B max
     p5_state.color_maxes[3] = 255.0f;  // A max
+    p5_state.looping = true;
+    p5_state.redraw_pending = false;
+    p5_state.sgp_usage = (p5__sgp_usage_t){0};
+#ifdef P5_TRACE
+    if (!p5_state.trace.reset_ns) p5__trace_calibrate();  // Unless p5_trace_reset() already did
+#endif
+    float target_fps = p5_state.timing.target_fps;  // frameRate() may be set before init
+    p5_state.timing = (p5__timing_t){0};
+    p5_state.timing.target_fps = target_fps;
+    p5_state.timing.start = p5__now_ns();
+    p5_state.timing.frame_start = p5_state.timing.start;
+}
+
+static void p5__pool_stop(void);
+static void p5__graphics_destroy(p5_graphics_t* pg);
+
+static void p5__shape_batch_free(void);
+
+void p5_shutdown(void) {
+    p5_fixed_update_stop();
+    // Handles stay valid for finish/cancel, detached from this context
+    for (p5_coroutine_t* co = p5_state.coroutines.pending; co; ) {
+        p5_coroutine_t* next = co->next;
+        co->owner = NULL;
+        co->next = NULL;
+        co = next;
+    }
+    p5_state.coroutines.pending = NULL;
+    p5_pipelined(false);
+    p5__shape_batch_free();
+    if (p5__current == &p5__default_context) p5__pool_stop();
+    p5_capture_end();
+    p5_watchdog_callback(0.0f, NULL, NULL);
+#ifdef P5_TELEMETRY
+    p5_telemetry_end();
+#endif
+#ifdef P5_BATCH_DIAGNOSTICS
+    p5_batch_diagnostics_reset();
+#endif
+    
+    // Release incremental rendering buffers (its target is in the pool)
+    p5__free(p5_state.incremental.frame.data);
+    p5__free((void*)p5_state.incremental.images);
+    p5__free(p5_state.incremental.shapes[0]);
+    p5__free(p5_state.incremental.shapes[1]);
+    p5_state.incremental = (p5__incremental_t){0};
+    
+    // Release pooled render targets
+    p5_graphics_t* pg = p5_state.graphics_pool;
+    while (pg) {
+        p5_graphics_t* next = pg->next;
+        p5__graphics_destroy(pg);
+        pg = next;
+    }
+    p5_state.graphics_pool = NULL;
+    p5_state.graphics_target = NULL;
+    p5_state.loop_target = NULL;
+    if (p5_state.graphics_sampler.id != SG_INVALID_ID) sg_destroy_sampler(p5_state.graphics_sampler);
+    p5_state.graphics_sampler = (sg_sampler){0};
+
+    p5_cmdlist_free(p5_state.recording);
+    p5_state.recording = NULL;
+    p5_state.recorded_scopes = 0;
+    p5_state.recorder = NULL;
+    p5_state.draw_log = NULL;
+    p5__free(p5_state.style_stack);
+    p5__arena_free();
+    p5_state.style_stack = NULL;
+    p5_state.style_stack_count = 0;
+    p5_state.style_stack_capacity = 0;
+    p5_state.style_stack_depth = 0;
+    p5_state.style_lost_depth = 0;
+    p5_state.style_dirty = 0;
+}
+
+#ifdef P5_HEADLESS
+void p5_headless_size(int width, int height) {
+    p5_state.headless_width = width;
+    p5_state.headless_height = height;
+}
+#endif
+
+// Context functions
+p5_context_t* p5_context_create(void) {
+    p5_context_t* context = (p5_context_t*)p5__calloc(1, sizeof(p5_context_t));
+    if (!context) {
+        printf("[WARNING] p5_context_create: out of memory\n");
+        return NULL;
+    }
+#ifdef P5_HEADLESS
+    // Inherit the window size of the creating context
+    context->state.headless_width = p5_state.headless_width;
+    context->state.headless_height = p5_state.headless_height;
+#endif
+    p5_context_t* previous = p5__current;
+    p5__current = context;
+    p5_init();
+    p5__current = previous;
+    return context;
+}
+
+void p5_context_destroy(p5_context_t* context) {
+    if (!context || context == &p5__default_context) return;
+    p5_context_t* previous = p5__current;
+    p5__current = context;
+    p5_shutdown();
+    p5__current = previous == context ? &p5__default_context : previous;
+    p5__free(context);
+}
+
+void p5_context_make_current(p5_context_t* context) {
+    p5__current = context ? context : &p5__default_context;
+}
+
+p5_context_t* p5_context_current(void) {
+    return p5__current;
+}
+
+p5_context_t* p5_context_default(void) {
+    return &p5__default_context;
 }
 
 // Canvas functions
 void p5_create_canvas(int w, int h) {
     // Center the canvas in the window
-    int win_w = sapp_width();
-    int win_h = sapp_height();
+    int win_w = p5__window_width();
+    int win_h = p5__window_height();
     int x = (win_w - w) / 2;
     int y = (win_h - h) / 2;
     p5_create_canvas_positioned(w, h, x, y);
@@ -629,7 +2607,7 @@ void p5_create_canvas_positioned(int w, int h, int x, int y) {
     // Validate canvas fits within window
     if (w <= 0 || h <= 0) return;
     if (x < 0 || y < 0) return;
-    if (x + w > sapp_width() || y + h > sapp_height()) return;
+    if (x + w > p5__window_width() || y + h > p5__window_height()) return;
     
     p5_state.canvas.width = w;
     p5_state.canvas.height = h;
@@ -639,29 +2617,29 @@ void p5_create_canvas_positioned(int w, int h, int x, int y) {
 }
 
 int p5_width(void) {
-    return p5_state.canvas.created ? p5_state.canvas.width : sapp_width();
+    return p5_state.canvas.created ? p5_state.canvas.width : p5__window_width();
 }
 
 int p5_height(void) {
-    return p5_state.canvas.created ? p5_state.canvas.height : sapp_height();
+    return p5_state.canvas.created ? p5_state.canvas.height : p5__window_height();
 }
 
 int p5_window_width(void) {
-    return sapp_width();
+    return p5__window_width();
 }
 
 int p5_window_height(void) {
-    return sapp_height();
+    return p5__window_height();
 }
 
 void p5_background(p5_color_t color) {
-    sgp_set_color(color.r, color.g, color.b, color.a);
-    sgp_clear();
+    P5__RECORD(P5__CMD_BACKGROUND, color.r, color.g, color.b, color.a);
+    p5__sgp_color(color);
+    p5__sgp_clear();
 }
 
 void p5_background_rgb(unsigned int r, unsigned int g, unsigned int b) {
-    sgp_set_color(r / 255.0f, g / 255.0f, b / 255.0f, 1.0f);
-    sgp_clear();
+    p5_background((p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, 1.0f});
 }
 
 // Color functions
@@ -674,56 +2652,64 @@ p5_color_t p5_color_rbga(unsigned int r, unsigned int g, unsigned int b, unsigne
 }
 
 void p5_fill(p5_color_t color) {
+    P5__RECORD(P5__CMD_FILL, color.r, color.g, color.b, color.a);
+    p5__style_save(P5__STYLE_FILL);
     p5_state.fill_color = color;
     p5_state.fill_enabled = true;
 }
 
 void p5_fill_rgb(unsigned int r, unsigned int g, unsigned int b) {
-    p5_state.fill_color = (p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, 1.0f};
-    p5_state.fill_enabled = true;
+    p5_fill((p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, 1.0f});
 }
 
 
 void p5_fill_rgba(unsigned int r, unsigned int g, unsigned int b, unsigned int a) {
-    p5_state.fill_color = (p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f};
-    p5_state.fill_enabled = true;
+    p5_fill((p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f});
 }
 
 void p5_stroke(p5_color_t color) {
+    P5__RECORD(P5__CMD_STROKE, color.r, color.g, color.b, color.a);
+    p5__style_save(P5__STYLE_STROKE);
     p5_state.stroke_color = color;
     p5_state.stroke_enabled = true;
 }
 
 void p5_stroke_rgb(unsigned int r, unsigned int g, unsigned int b) {
-    p5_state.stroke_color = (p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, 1.0f};
-    p5_state.stroke_enabled = true;
+    p5_stroke((p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, 1.0f});
 }
 
 
 void p5_stroke_rgba(unsigned int r, unsigned int g, unsigned int b, unsigned int a) {
-    p5_state.stroke_color = (p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f};
-    p5_state.stroke_enabled = true;
+    p5_stroke((p5_color_t){r / 255.0f, g / 255.0f, b / 255.0f, a / 255.0f});
 }
 
 void p5_stroke_weight(float weight) {
+    P5__RECORD(P5__CMD_STROKE_WEIGHT, weight);
+    p5__style_save(P5__STYLE_STROKE_WEIGHT);
     p5_state.stroke_width = weight;
 }
 
 void p5_no_fill(void) {
+    P5__RECORD_OP(P5__CMD_NO_FILL);
+    p5__style_save(P5__STYLE_FILL);
     p5_state.fill_enabled = false;
 }
 
 void p5_no_stroke(void) {
+    P5__RECORD_OP(P5__CMD_NO_STROKE);
+    p5__style_save(P5__STYLE_STROKE);
     p5_state.stroke_enabled = false;
 }
 
 // Angle mode functions
 void p5_angle_mode(p5_angle_mode_t mode) {
+    p5__style_save(P5__STYLE_ANGLE_MODE);
     p5_state.angle_mode = mode;
 }
 
 // Color mode functions
 void p5_color_mode(p5_color_mode_t mode) {
+    p5__style_save(P5__STYLE_COLOR_MODE);
     p5_state.color_mode = mode;
     // Set default maximums based on color mode
     if (mode == P5_RGB) {
@@ -740,6 +2726,7 @@ void p5_color_mode(p5_color_mode_t mode) {
 }
 
 void p5_color_mode_range(p5_color_mode_t mode, float max1, float max2, float max3, float maxA) {
+    p5__style_save(P5__STYLE_COLOR_MODE);
     p5_state.color_mode = mode;
     p5_state.color_maxes[0] = max1;
     p5_state.color_maxes[1] = max2;
@@ -844,81 +2831,154 @@ p5_color_t p5_color(const char* color_str) {
 }
 
 // Transform functions
+// push() saves the full drawing style (fill, stroke, stroke weight, transform,
+// angle and color modes). Only a scope marker is written here; field groups
+// are copied lazily by p5__style_save() when first modified inside the scope.
+// A scope that finds no memory for its marker is only counted, so its pop()
+// leaves the enclosing scope open; its changes are undone by that scope.
+static void p5__push(void) {
+    if (p5_state.style_lost_depth > 0 || !p5__style_reserve()) {
+        p5_state.style_lost_depth++;
+        p5_state.style_stack_depth++;
+        return;
+    }
+    
+    p5__style_entry_t* e = &p5_state.style_stack[p5_state.style_stack_count++];
+    e->field = 0;
+    e->as.saved_dirty = p5_state.style_dirty;
+    p5_state.style_dirty = 0;
+    p5_state.style_stack_depth++;
+}
+
+static void p5__pop(void) {
+    if (p5_state.style_stack_depth == 0) return;
+    if (p5_state.style_lost_depth > 0) {
+        p5_state.style_lost_depth--;
+        p5_state.style_stack_depth--;
+        return;
+    }
+    
+    // Unwind saved fields back to this scope's marker
+    while (p5_state.style_stack_count > 0) {
+        p5__style_entry_t* e = &p5_state.style_stack[--p5_state.style_stack_count];
+        if (e->field == 0) {
+            p5_state.style_dirty = e->as.saved_dirty;
+            break;
+        }
+        p5__style_restore(e);
+    }
+    p5_state.style_stack_depth--;
+}
+
+// Recorded scopes also scope the live angle and color modes, which are not
+// recorded but convert the arguments of the calls recorded after them
 void p5_push(void) {
-    if (p5_state.transform_stack_depth < 32) {
-        p5_state.transform_stack[p5_state.transform_stack_depth] = p5_state.transform;
-        p5_state.transform_stack_depth++;
+    if (p5_state.recording) {
+        p5__record(P5__CMD_PUSH, NULL, 0);
+        p5_state.recorded_scopes++;
+    } else {
+        P5__RECORD_OP(P5__CMD_PUSH);
     }
+    p5__push();
 }
 
 void p5_pop(void) {
-    if (p5_state.transform_stack_depth > 0) {
-        p5_state.transform_stack_depth--;
-        p5_state.transform = p5_state.transform_stack[p5_state.transform_stack_depth];
+    if (p5_state.recording) {
+        p5__record(P5__CMD_POP, NULL, 0);
+        if (p5_state.recorded_scopes == 0) return;  // Opened before recording began
+        p5_state.recorded_scopes--;
+    } else {
+        P5__RECORD_OP(P5__CMD_POP);
+    }
+    p5__pop();
+}
+
+// Close the live scopes of a recording that ended inside them
+static void p5__recorded_scopes_end(void) {
+    while (p5_state.recorded_scopes > 0) {
+        p5_state.recorded_scopes--;
+        p5__pop();
     }
 }
 
 void p5_translate(float x, float y) {
+    P5__RECORD(P5__CMD_TRANSLATE, x, y);
+    p5__style_save(P5__STYLE_TRANSFORM);
     p5_state.transform.tx += x;
     p5_state.transform.ty += y;
 }
 
 void p5_rotate(float angle) {
+    P5__RECORD(P5__CMD_ROTATE, angle);
+    p5__style_save(P5__STYLE_TRANSFORM);
     p5_state.transform.rot += angle;
 }
 
 void p5_scale(float s) {
-    p5_state.transform.sx *= s;
-    p5_state.transform.sy *= s;
+    p5_scale_xy(s, s);
 }
 
 void p5_scale_xy(float sx, float sy) {
+    P5__RECORD(P5__CMD_SCALE, sx, sy);
+    p5__style_save(P5__STYLE_TRANSFORM);
     p5_state.transform.sx *= sx;
     p5_state.transform.sy *= sy;
 }
 
 // Basic shapes
-void p5_point(float x, float y) {
+static void p5__point(float x, float y) {
+    P5__BATCH_SHAPE(P5__CMD_POINT, x, y);
     p5__apply_transform();
-    sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                  p5_state.stroke_color.b, p5_state.stroke_color.a);
+    p5_state.timing.shapes++;
+    p5__sgp_color(p5_state.stroke_color);
     
     if (p5_state.stroke_width <= 1.0f) {
         // Use built-in point for thin points
-        sgp_draw_point(x, y);
+        p5__sgp_point(x, y);
     } else {
         // Draw thick point as filled circle
         float radius = p5_state.stroke_width * 0.5f;
-        sgp_draw_filled_rect(x - radius, y - radius, p5_state.stroke_width, p5_state.stroke_width);
+        p5__sgp_rect(x - radius, y - radius, p5_state.stroke_width, p5_state.stroke_width);
     }
     
     p5__restore_transform();
 }
 
-void p5_line(float x1, float y1, float x2, float y2) {
+void p5_point(float x, float y) {
+    P5__RECORD(P5__CMD_POINT, x, y);
+    p5__point(x, y);
+}
+
+static void p5__line(float x1, float y1, float x2, float y2) {
     if (!p5_state.stroke_enabled) return;
+    P5__BATCH_SHAPE(P5__CMD_LINE, x1, y1, x2, y2);
     
     p5__apply_transform();
-    sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                  p5_state.stroke_color.b, p5_state.stroke_color.a);
+    p5_state.timing.shapes++;
+    p5__sgp_color(p5_state.stroke_color);
     p5__draw_thick_line(x1, y1, x2, y2, p5_state.stroke_width);
     p5__restore_transform();
 }
 
-void p5_rect(float x, float y, float w, float h) {
+void p5_line(float x1, float y1, float x2, float y2) {
+    P5__RECORD(P5__CMD_LINE, x1, y1, x2, y2);
+    p5__line(x1, y1, x2, y2);
+}
+
+static void p5__rect(float x, float y, float w, float h) {
+    P5__BATCH_SHAPE(P5__CMD_RECT, x, y, w, h);
     p5__apply_transform();
+    p5_state.timing.shapes++;
     
     // Fill
     if (p5_state.fill_enabled) {
-        sgp_set_color(p5_state.fill_color.r, p5_state.fill_color.g, 
-                      p5_state.fill_color.b, p5_state.fill_color.a);
-        sgp_draw_filled_rect(x, y, w, h);
+        p5__sgp_color(p5_state.fill_color);
+        p5__sgp_rect(x, y, w, h);
     }
     
     // Stroke
     if (p5_state.stroke_enabled) {
-        sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                      p5_state.stroke_color.b, p5_state.stroke_color.a);
+        p5__sgp_color(p5_state.stroke_color);
         // Draw rectangle outline using connected polygon outline
         float rect_points[] = {
             x, y,           // top-left
@@ -932,12 +2992,19 @@ void p5_rect(float x, float y, float w, float h) {
     p5__restore_transform();
 }
 
+void p5_rect(float x, float y, float w, float h) {
+    P5__RECORD(P5__CMD_RECT, x, y, w, h);
+    p5__rect(x, y, w, h);
+}
+
 void p5_circle(float x, float y, float diameter) {
     p5_ellipse(x, y, diameter, diameter);
 }
 
-void p5_ellipse(float x, float y, float w, float h) {
+static void p5__ellipse(float x, float y, float w, float h) {
+    P5__BATCH_SHAPE(P5__CMD_ELLIPSE, x, y, w, h);
     p5__apply_transform();
+    p5_state.timing.shapes++;
     
     // Calculate segment count based on size and stroke weight for better quality
     float rx = w * 0.5f;
@@ -954,42 +3021,47 @@ void p5_ellipse(float x, float y, float w, float h) {
     }
     const int segments = fmaxf(16, fminf(128, base_segments)); // Clamp between 16-128 segments
     
+    // Unit-circle points shared by fill and stroke, in frame scratch memory
+    size_t mark = p5__frame_mark();
+    float* unit = (float*)p5__frame_alloc((segments + 1) * 2 * sizeof(float));
+    if (!unit) {
+        p5__restore_transform();
+        return;
+    }
+    for (int i = 0; i <= segments; i++) {
+        float angle = (float)i / segments * TWO_PI;
+        unit[i*2] = cosf(angle);
+        unit[i*2+1] = sinf(angle);
+    }
+    
     // Fill
     if (p5_state.fill_enabled) {
-        sgp_set_color(p5_state.fill_color.r, p5_state.fill_color.g, 
-                      p5_state.fill_color.b, p5_state.fill_color.a);
+        p5__sgp_color(p5_state.fill_color);
         
         // Draw triangular segments for filled ellipse
         for (int i = 0; i < segments; i++) {
-            float angle1 = (float)i / segments * TWO_PI;
-            float angle2 = (float)(i + 1) / segments * TWO_PI;
-            
-            float x1 = cx + cosf(angle1) * rx;
-            float y1 = cy + sinf(angle1) * ry;
-            float x2 = cx + cosf(angle2) * rx;
-            float y2 = cy + sinf(angle2) * ry;
+            float x1 = cx + unit[i*2] * rx;
+            float y1 = cy + unit[i*2+1] * ry;
+            float x2 = cx + unit[(i+1)*2] * rx;
+            float y2 = cy + unit[(i+1)*2+1] * ry;
             
-            sgp_draw_filled_triangle(cx, cy, x1, y1, x2, y2);
+            p5__sgp_triangle(cx, cy, x1, y1, x2, y2);
         }
     }
     
     // Stroke
     if (p5_state.stroke_enabled) {
-        sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                      p5_state.stroke_color.b, p5_state.stroke_color.a);
+        p5__sgp_color(p5_state.stroke_color);
         
         if (p5_state.stroke_width <= 1.0f) {
             // Use thin line segments for thin strokes
             for (int i = 0; i < segments; i++) {
-                float angle1 = (float)i / segments * TWO_PI;
-                float angle2 = (float)(i + 1) / segments * TWO_PI;
-                
-                float x1 = cx + cosf(angle1) * rx;
-                float y1 = cy + sinf(angle1) * ry;
-                float x2 = cx + cosf(angle2) * rx;
-                float y2 = cy + sinf(angle2) * ry;
+                float x1 = cx + unit[i*2] * rx;
+                float y1 = cy + unit[i*2+1] * ry;
+                float x2 = cx + unit[(i+1)*2] * rx;
+                float y2 = cy + unit[(i+1)*2+1] * ry;
                 
-                sgp_draw_line(x1, y1, x2, y2);
+                p5__sgp_line(x1, y1, x2, y2);
             }
         } else {
             // Draw thick stroke as annulus (ring) - outer ellipse minus inner ellipse
@@ -1001,45 +3073,51 @@ void p5_ellipse(float x, float y, float w, float h) {
             
             // Draw outer ellipse as filled triangular segments
             for (int i = 0; i < segments; i++) {
-                float angle1 = (float)i / segments * TWO_PI;
-                float angle2 = (float)(i + 1) / segments * TWO_PI;
+                const float* u1 = &unit[i*2];
+                const float* u2 = &unit[(i+1)*2];
                 
                 // Outer ellipse points
-                float ox1 = cx + cosf(angle1) * outer_rx;
-                float oy1 = cy + sinf(angle1) * outer_ry;
-                float ox2 = cx + cosf(angle2) * outer_rx;
-                float oy2 = cy + sinf(angle2) * outer_ry;
+                float ox1 = cx + u1[0] * outer_rx;
+                float oy1 = cy + u1[1] * outer_ry;
+                float ox2 = cx + u2[0] * outer_rx;
+                float oy2 = cy + u2[1] * outer_ry;
                 
                 // Inner ellipse points
-                float ix1 = cx + cosf(angle1) * inner_rx;
-                float iy1 = cy + sinf(angle1) * inner_ry;
-                float ix2 = cx + cosf(angle2) * inner_rx;
-                float iy2 = cy + sinf(angle2) * inner_ry;
+                float ix1 = cx + u1[0] * inner_rx;
+                float iy1 = cy + u1[1] * inner_ry;
+                float ix2 = cx + u2[0] * inner_rx;
+                float iy2 = cy + u2[1] * inner_ry;
                 
                 // Draw ring segment as two triangles (quad)
-                sgp_draw_filled_triangle(ox1, oy1, ox2, oy2, ix1, iy1);
-                sgp_draw_filled_triangle(ox2, oy2, ix2, iy2, ix1, iy1);
+                p5__sgp_triangle(ox1, oy1, ox2, oy2, ix1, iy1);
+                p5__sgp_triangle(ox2, oy2, ix2, iy2, ix1, iy1);
             }
         }
     }
     
+    p5__frame_rewind(mark);
     p5__restore_transform();
 }
 
-void p5_triangle(float x1, float y1, float x2, float y2, float x3, float y3) {
+void p5_ellipse(float x, float y, float w, float h) {
+    P5__RECORD(P5__CMD_ELLIPSE, x, y, w, h);
+    p5__ellipse(x, y, w, h);
+}
+
+static void p5__triangle(float x1, float y1, float x2, float y2, float x3, float y3) {
+    P5__BATCH_SHAPE(P5__CMD_TRIANGLE, x1, y1, x2, y2, x3, y3);
     p5__apply_transform();
+    p5_state.timing.shapes++;
     
     // Fill
     if (p5_state.fill_enabled) {
-        sgp_set_color(p5_state.fill_color.r, p5_state.fill_color.g, 
-                      p5_state.fill_color.b, p5_state.fill_color.a);
-        sgp_draw_filled_triangle(x1, y1, x2, y2, x3, y3);
+        p5__sgp_color(p5_state.fill_color);
+        p5__sgp_triangle(x1, y1, x2, y2, x3, y3);
     }
     
     // Stroke
     if (p5_state.stroke_enabled) {
-        sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                      p5_state.stroke_color.b, p5_state.stroke_color.a);
+        p5__sgp_color(p5_state.stroke_color);
         // Draw triangle outline using connected polygon outline
         float triangle_points[] = {
             x1, y1,
@@ -1052,25 +3130,30 @@ void p5_triangle(float x1, float y1, float x2, float y2, float x3, float y3) {
     p5__restore_transform();
 }
 
+void p5_triangle(float x1, float y1, float x2, float y2, float x3, float y3) {
+    P5__RECORD(P5__CMD_TRIANGLE, x1, y1, x2, y2, x3, y3);
+    p5__triangle(x1, y1, x2, y2, x3, y3);
+}
+
 void p5_square(float x, float y, float size) {
     p5_rect(x, y, size, size);
 }
 
-void p5_quad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4) {
+static void p5__quad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4) {
+    P5__BATCH_SHAPE(P5__CMD_QUAD, x1, y1, x2, y2, x3, y3, x4, y4);
     p5__apply_transform();
+    p5_state.timing.shapes++;
     
     // Fill (using two triangles)
     if (p5_state.fill_enabled) {
-        sgp_set_color(p5_state.fill_color.r, p5_state.fill_color.g, 
-                      p5_state.fill_color.b, p5_state.fill_color.a);
-        sgp_draw_filled_triangle(x1, y1, x2, y2, x3, y3);
-        sgp_draw_filled_triangle(x1, y1, x3, y3, x4, y4);
+        p5__sgp_color(p5_state.fill_color);
+        p5__sgp_triangle(x1, y1, x2, y2, x3, y3);
+        p5__sgp_triangle(x1, y1, x3, y3, x4, y4);
     }
     
     // Stroke
     if (p5_state.stroke_enabled) {
-        sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                      p5_state.stroke_color.b, p5_state.stroke_color.a);
+        p5__sgp_color(p5_state.stroke_color);
         // Draw quad outline using connected polygon outline
         float quad_points[] = {
             x1, y1,
@@ -1084,12 +3167,19 @@ void p5_quad(float x1, float y1, float x2, float y2, float x3, float y3, float x
     p5__restore_transform();
 }
 
+void p5_quad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4) {
+    P5__RECORD(P5__CMD_QUAD, x1, y1, x2, y2, x3, y3, x4, y4);
+    p5__quad(x1, y1, x2, y2, x3, y3, x4, y4);
+}
+
 void p5_arc(float x, float y, float w, float h, float start, float stop) {
     p5_arc_with_mode(x, y, w, h, start, stop, P5_CHORD);
 }
 
-void p5_arc_with_mode(float x, float y, float w, float h, float start, float stop, p5_arc_mode_t mode) {
+static void p5__arc(float x, float y, float w, float h, float start_rad, float stop_rad, p5_arc_mode_t mode) {
+    P5__BATCH_SHAPE(P5__CMD_ARC, x, y, w, h, start_rad, stop_rad, (float)mode);
     p5__apply_transform();
+    p5_state.timing.shapes++;
     
     const int segments = 32;
     float rx = w * 0.5f;
@@ -1097,15 +3187,11 @@ void p5_arc_with_mode(float x, float y, float w, float h, float start, float sto
     float cx = x;
     float cy = y;
     
-    // Convert angles based on current angle mode
-    float start_rad = (p5_state.angle_mode == P5_DEGREES) ? start * PI / 180.0f : start;
-    float stop_rad = (p5_state.angle_mode == P5_DEGREES) ? stop * PI / 180.0f : stop;
     float angle_range = stop_rad - start_rad;
     
     // Fill
     if (p5_state.fill_enabled) {
-        sgp_set_color(p5_state.fill_color.r, p5_state.fill_color.g, 
-                      p5_state.fill_color.b, p5_state.fill_color.a);
+        p5__sgp_color(p5_state.fill_color);
         
         // Draw triangular segments for filled arc
         for (int i = 0; i < segments; i++) {
@@ -1119,14 +3205,13 @@ void p5_arc_with_mode(float x, float y, float w, float h, float start, float sto
             float x2 = cx + cosf(angle2) * rx;
             float y2 = cy + sinf(angle2) * ry;
             
-            sgp_draw_filled_triangle(cx, cy, x1, y1, x2, y2);
+            p5__sgp_triangle(cx, cy, x1, y1, x2, y2);
         }
     }
     
     // Stroke
     if (p5_state.stroke_enabled) {
-        sgp_set_color(p5_state.stroke_color.r, p5_state.stroke_color.g, 
-                      p5_state.stroke_color.b, p5_state.stroke_color.a);
+        p5__sgp_color(p5_state.stroke_color);
         
         // Draw arc outline using thick line segments
         for (int i = 0; i < segments; i++) {
@@ -1163,6 +3248,3205 @@ void p5_arc_with_mode(float x, float y, float w, float h, float start, float sto
     p5__restore_transform();
 }
 
-#endif // P5_IMPLEMENTATION
+void p5_arc_with_mode(float x, float y, float w, float h, float start, float stop, p5_arc_mode_t mode) {
+    // Convert angles based on current angle mode
+    float start_rad = (p5_state.angle_mode == P5_DEGREES) ? start * PI / 180.0f : start;
+    float stop_rad = (p5_state.angle_mode == P5_DEGREES) ? stop * PI / 180.0f : stop;
+    P5__RECORD(P5__CMD_ARC, x, y, w, h, start_rad, stop_rad, (float)mode);
+    p5__arc(x, y, w, h, start_rad, stop_rad, mode);
+}
+
+// Graphics buffer functions
+static void p5__graphics_destroy(p5_graphics_t* pg) {
+    sg_destroy_attachments(pg->attachments);
+    sg_destroy_image(pg->color);
+    sg_destroy_image(pg->resolve);
+    sg_destroy_image(pg->depth);
+    p5__free(pg);
+}
+
+// Destroy parked render targets that went unused too long, then the oldest
+// beyond the pool limit. Runs between frames, when no pending sgp command
+// can still sample them.
+static void p5__graphics_trim(void) {
+    int frame = p5_state.timing.frame_count;
+    int parked = 0;
+    for (p5_graphics_t** link = &p5_state.graphics_pool; *link; ) {
+        p5_graphics_t* pg = *link;
+        if (!pg->in_use && frame - pg->parked_frame > P5_GRAPHICS_POOL_FRAMES) {
+            *link = pg->next;
+            p5__graphics_destroy(pg);
+            continue;
+        }
+        if (!pg->in_use) parked++;
+        link = &pg->next;
+    }
+    
+    for (; parked > P5_GRAPHICS_POOL_MAX; parked--) {
+        p5_graphics_t** oldest = NULL;
+        for (p5_graphics_t** link = &p5_state.graphics_pool; *link; link = &(*link)->next) {
+            if (!(*link)->in_use && (!oldest || (*link)->parked_frame <= (*oldest)->parked_frame)) oldest = link;
+        }
+        p5_graphics_t* pg = *oldest;
+        *oldest = pg->next;
+        p5__graphics_destroy(pg);
+    }
+}
+
+p5_graphics_t* p5_create_graphics(int width, int height) {
+    if (width <= 0 || height <= 0) return NULL;
+    
+    // Reuse a parked render target of the same size
+    for (p5_graphics_t* pg = p5_state.graphics_pool; pg; pg = pg->next) {
+        if (!pg->in_use && pg->width == width && pg->height == height) {
+            pg->in_use = true;
+            pg->needs_clear = true;
+            return pg;
+        }
+    }
+    
+    p5_graphics_t* pg = (p5_graphics_t*)p5__calloc(1, sizeof(p5_graphics_t));
+    if (!pg) return NULL;
+    
+    // Match the formats sgp built its pipelines for
+    sgp_desc desc = sgp_query_desc();
+    int sample_count = desc.sample_count > 0 ? desc.sample_count : 1;
+    
+    pg->width = width;
+    pg->height = height;
+    pg->color = sg_make_image(&(sg_image_desc){
+        .render_target = true,
+        .width = width,
+        .height = height,
+        .pixel_format = desc.color_format,
+        .sample_count = sample_count,
+        .label = "p5-graphics-color",
+    });
+    if (sample_count > 1) {
+        pg->resolve = sg_make_image(&(sg_image_desc){
+            .render_target = true,
+            .width = width,
+            .height = height,
+            .pixel_format = desc.color_format,
+            .sample_count = 1,
+            .label = "p5-graphics-resolve",
+        });
+    }
+    if (desc.depth_format != SG_PIXELFORMAT_NONE) {
+        pg->depth = sg_make_image(&(sg_image_desc){
+            .render_target = true,
+            .width = width,
+            .height = height,
+            .pixel_format = desc.depth_format ? desc.depth_format : SG_PIXELFORMAT_DEPTH_STENCIL,
+            .sample_count = sample_count,
+            .label = "p5-graphics-depth",
+        });
+    }
+    pg->attachments = sg_make_attachments(&(sg_attachments_desc){
+        .colors[0].image = pg->color,
+        .resolves[0].image = pg->resolve,
+        .depth_stencil.image = pg->depth,
+        .label = "p5-graphics-attachments",
+    });
+    
+    if (sg_query_image_state(pg->color) != SG_RESOURCESTATE_VALID ||
+        sg_query_attachments_state(pg->attachments) != SG_RESOURCESTATE_VALID) {
+        printf("[WARNING] p5_create_graphics: cannot create %dx%d render target\n", width, height);
+        p5__graphics_destroy(pg);
+        return NULL;
+    }
+    
+    pg->in_use = true;
+    pg->needs_clear = true;
+    pg->next = p5_state.graphics_pool;
+    p5_state.graphics_pool = pg;
+    return pg;
+}
+
+void p5_remove_graphics(p5_graphics_t* pg) {
+    if (!pg) return;
+    if (p5_state.graphics_target == pg) p5_graphics_end();
+    pg->in_use = false;  // Parked for reuse until p5__graphics_trim() destroys it
+    pg->parked_frame = p5_state.timing.frame_count;
+}
+
+void p5_graphics_begin(p5_graphics_t* pg) {
+    if (!pg) return;
+    if (p5_state.recorder) {
+        printf("[WARNING] p5_graphics_begin: not available while a recorder is active\n");
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    if (p5_state.graphics_target) {
+        printf("[WARNING] p5_graphics_begin: already drawing into a graphics buffer\n");
+        return;
+    }
+    p5_state.graphics_target = pg;
+    
+    // Buffer content is not part of the frame capture stream, command lists
+    // or incremental frames: it is drawn into the buffer right away
+    p5_state.graphics_saved_capture = p5_state.capture_file;
+    p5_state.capture_file = NULL;
+    p5_state.graphics_saved_recording = p5_state.recording;
+    p5_state.recording = NULL;
+    
+    // Start from an identity transform; style changes stay inside the buffer
+    sgp_begin(pg->width, pg->height);
+    P5__BATCH_BEGIN();
+    p5__push();
+    p5__style_save(P5__STYLE_TRANSFORM);
+    p5_state.transform = (p5_transform_t){0.0f, 0.0f, 0.0f, 1.0f, 1.0f};
+}
+
+// Flush the commands of a nested sgp_begin() into a buffer's render target
+static void p5__graphics_submit(p5_graphics_t* pg) {
+    sg_pass_action action = {
+        .colors[0] = {
+            .load_action = pg->needs_clear ? SG_LOADACTION_CLEAR : SG_LOADACTION_LOAD,
+            .clear_value = {0.0f, 0.0f, 0.0f, 0.0f},
+        },
+    };
+    sg_begin_pass(&(sg_pass){ .action = action, .attachments = pg->attachments });
+    p5__sgp_sample();
+    sgp_flush();
+    sgp_end();
+    P5__BATCH_END();
+    sg_end_pass();
+    pg->needs_clear = false;
+}
+
+// Draw a buffer's texture into the current sgp frame (no p5 transform)
+static void p5__graphics_draw(const p5_graphics_t* pg, float x, float y, float w, float h) {
+    P5__FLUSH_SHAPES();
+    if (p5_state.graphics_sampler.id == SG_INVALID_ID) {
+        p5_state.graphics_sampler = sg_make_sampler(&(sg_sampler_desc){
+            .min_filter = SG_FILTER_LINEAR,
+            .mag_filter = SG_FILTER_LINEAR,
+            .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+            .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+            .label = "p5-graphics-sampler",
+        });
+    }
+    
+    // Render targets are stored bottom-up on backends without a top-left origin
+    float src_y = 0.0f, src_h = (float)pg->height;
+    if (!sg_query_features().origin_top_left) {
+        src_y = (float)pg->height;
+        src_h = -(float)pg->height;
+    }
+    
+    sgp_set_blend_mode(SGP_BLENDMODE_BLEND);
+    sgp_set_color(1.0f, 1.0f, 1.0f, 1.0f);
+    sgp_set_image(0, pg->resolve.id != SG_INVALID_ID ? pg->resolve : pg->color);
+    sgp_set_sampler(0, p5_state.graphics_sampler);
+    p5__sgp_textured_rect(0, (sgp_rect){x, y, w, h}, (sgp_rect){0.0f, src_y, (float)pg->width, src_h});
+    sgp_reset_sampler(0);
+    sgp_reset_image(0);
+    sgp_reset_blend_mode();
+}
+
+void p5_graphics_end(void) {
+    p5_graphics_t* pg = p5_state.graphics_target;
+    if (!pg) return;
+    P5__FLUSH_SHAPES();
+    
+    p5__graphics_submit(pg);
+    p5__pop();
+    p5_state.capture_file = p5_state.graphics_saved_capture;
+    p5_state.graphics_saved_capture = NULL;
+    p5_state.recording = p5_state.graphics_saved_recording;
+    p5_state.graphics_saved_recording = NULL;
+    p5_state.graphics_target = NULL;
+    pg->version++;
+}
+
+// Loop control functions
+void p5_no_loop(void) {
+    p5_state.looping = false;
+}
+
+void p5_loop(void) {
+    p5_state.looping = true;
+    if (p5_state.loop_target && !p5_state.loop_caching) {
+        p5_remove_graphics(p5_state.loop_target);
+        p5_state.loop_target = NULL;
+    }
+}
+
+void p5_redraw(void) {
+    p5_state.redraw_pending = true;
+}
+
+bool p5_is_looping(void) {
+    return p5_state.looping;
+}
+
+// Decide whether this frame runs setup()/draw(). A looping frame is drawn
+// into a nested sgp frame, so that if it calls noLoop() its queued commands
+// can become the cached frame; otherwise they go to the window unchanged.
+// When not looping, a frame is drawn into loop_target.
+bool p5_loop_frame_begin(void) {
+    int width = p5_width(), height = p5_height();
+    p5_state.loop_width = width;
+    p5_state.loop_height = height;
+    if (p5_state.looping) {
+        p5_state.loop_direct = true;
+        sgp_begin(width, height);
+        P5__BATCH_BEGIN();
+        return true;
+    }
+    
+    p5_graphics_t* pg = p5_state.loop_target;
+    bool cached = pg && pg->width == width && pg->height == height;
+    if (cached && !p5_state.redraw_pending) return false;
+    
+    if (!cached) {
+        if (pg) p5_remove_graphics(pg);
+        pg = p5_state.loop_target = p5_create_graphics(width, height);
+        if (!pg) return true;  // No cache available: draw directly every frame
+    }
+    p5_state.redraw_pending = false;
+    p5_state.loop_caching = true;
+    sgp_begin(width, height);
+    P5__BATCH_BEGIN();
+    return true;
+}
+
+void p5_loop_frame_end(void) {
+    int width = p5_state.loop_width, height = p5_state.loop_height;
+    p5_graphics_t* pg = p5_state.loop_target;
+    if (p5_state.loop_direct) {
+        p5_state.loop_direct = false;
+        
+        // noLoop() in this frame: keep it, unless it resized the canvas and
+        // so was drawn for the old size
+        bool keep = !p5_state.looping && width == p5_width() && height == p5_height();
+        if (keep && !(pg && pg->width == width && pg->height == height)) {
+            if (pg) p5_remove_graphics(pg);
+            pg = p5_state.loop_target = p5_create_graphics(width, height);
+            keep = pg != NULL;
+        }
+        if (keep) {
+            p5_state.loop_caching = true;
+        } else {
+            P5__BATCH_END();
+            sgp_end();  // The commands stay queued for the window pass
+        }
+    }
+    if (p5_state.loop_caching) {
+        pg->needs_clear = true;  // Every drawn frame starts from a cleared canvas
+        p5__graphics_submit(pg);
+        p5_state.loop_caching = false;
+    }
+    if (!p5_state.looping && pg) {
+        p5__graphics_draw(pg, 0.0f, 0.0f, (float)pg->width, (float)pg->height);
+    }
+}
+
+// Timing functions
+void p5_frame_begin(void) {
+    p5__timing_t* t = &p5_state.timing;
+    p5__alloc_frame(t->frame_count > 0);
+    
+    // Pace against a fixed schedule so sleep overshoot does not accumulate;
+    // a frame later than one period restarts the schedule
+    uint64_t wait_start = p5__now_ns();
+    if (t->target_fps > 0.0f) {
+        uint64_t period = (uint64_t)(1e9 / t->target_fps);
+        if (t->deadline) p5__wait_until(t->deadline);
+        uint64_t now = p5__now_ns();
+        t->deadline = (t->deadline && now - t->deadline < period) ? t->deadline + period : now + period;
+    }
+    
+    uint64_t now = p5__now_ns();
+    t->wait_ms = (float)((now - wait_start) / 1e6);
+    t->delta_ms = (float)((now - t->frame_start) / 1e6);
+    t->frame_start = now;
+    t->draw_start = now;
+    t->frame_count++;
+    t->submit_start = 0;
+    p5__graphics_trim();
+    t->shapes = 0;
+#ifdef P5_BATCH_DIAGNOSTICS
+    p5_state.batch.level = 0;
+    p5_state.batch.levels[0].count = 0;
+    p5_state.batch.levels[0].cur_vertex = 0;
+#endif
+    
+    // Rolling window: evict the oldest frame time from the histogram
+    if (t->frame_count == 1) return;  // No previous frame to measure
+    if (t->window_count == P5_FRAME_TIME_WINDOW) {
+        float old = t->window[t->window_next];
+        int bucket = (int)(old / P5__FRAME_TIME_BUCKET_MS);
+        t->histogram[bucket < P5__FRAME_TIME_BUCKETS ? bucket : P5__FRAME_TIME_BUCKETS - 1]--;
+        t->window_sum -= old;
+    } else {
+        t->window_count++;
+    }
+    int bucket = (int)(t->delta_ms / P5__FRAME_TIME_BUCKET_MS);
+    t->histogram[bucket < P5__FRAME_TIME_BUCKETS ? bucket : P5__FRAME_TIME_BUCKETS - 1]++;
+    t->window[t->window_next] = t->delta_ms;
+    t->window_sum += t->delta_ms;
+    t->window_next = (t->window_next + 1) % P5_FRAME_TIME_WINDOW;
+}
+
+// Write or hand over the watchdog history, oldest first
+static void p5__watchdog_dump(void) {
+    p5__watchdog_t* w = &p5_state.watchdog;
+    p5_frame_record_t ordered[P5_WATCHDOG_HISTORY];
+    int first = w->count < P5_WATCHDOG_HISTORY ? 0 : w->next;
+    int slow = 0;
+    for (int i = 0; i < w->count; i++) {
+        ordered[i] = w->history[(first + i) % P5_WATCHDOG_HISTORY];
+        if (ordered[i].frame == w->slow_frame) slow = i;
+    }
+    
+    if (w->callback) {
+        w->callback(ordered, w->count, slow, w->user_data);
+    }
+    if (w->file) {
+        const p5_frame_record_t* r = &ordered[slow];
+        fprintf(w->file, "# p5 watchdog: frame %d took %.3f ms (budget %.3f ms)\n",
+                r->frame, r->draw_ms + r->submit_ms, w->budget_ms);
+        fprintf(w->file, "frame,wait_ms,draw_ms,submit_ms,shapes,draw_calls,commands,uniforms,vertices,dropped,latency_ms\n");
+        for (int i = 0; i < w->count; i++) {
+            r = &ordered[i];
+            fprintf(w->file, "%d,%.3f,%.3f,%.3f,%u,%u,%u,%u,%u,%d,%.3f\n", r->frame, r->wait_ms,
+                    r->draw_ms, r->submit_ms, r->shapes, r->draw_calls, r->commands,
+                    r->uniforms, r->vertices, (int)r->dropped, r->latency_ms);
+        }
+        fflush(w->file);
+    }
+}
+
+// Phase timings and counters of the frame that just ended
+static p5_frame_record_t p5__frame_record(void) {
+    const p5__timing_t* t = &p5_state.timing;
+    uint64_t now = p5__now_ns();
+    uint64_t submit_start = t->submit_start ? t->submit_start : now;
+    sg_frame_stats stats = sg_query_frame_stats();  // The frame just committed
+    sgp_error error = sgp_get_last_error();
+    
+    p5_frame_record_t r;
+    r.frame = t->frame_count;
+    r.wait_ms = t->wait_ms;
+    r.draw_ms = (float)((submit_start - t->frame_start) / 1e6);
+    r.submit_ms = (float)((now - submit_start) / 1e6);
+    r.shapes = t->shapes;
+    r.draw_calls = stats.num_draw;
+    r.commands = p5_state.sgp_usage.usage.frame.commands;
+    r.uniforms = p5_state.sgp_usage.usage.frame.uniforms;
+    r.vertices = p5_state.sgp_usage.usage.frame.vertices;
+    r.dropped = p5__sgp_buffer_full(error);
+    r.latency_ms = t->latency_ms;
+    return r;
+}
+
+static void p5__watchdog_frame(const p5_frame_record_t* record) {
+    p5__watchdog_t* w = &p5_state.watchdog;
+    p5_frame_record_t* r = &w->history[w->next];
+    *r = *record;
+    w->next = (w->next + 1) % P5_WATCHDOG_HISTORY;
+    if (w->count < P5_WATCHDOG_HISTORY) w->count++;
+    
+    // A slow frame starts a countdown so the dump includes its aftermath;
+    // further slow frames before then are part of the same dump
+    if (w->trailing > 0) {
+        if (--w->trailing == 0) p5__watchdog_dump();
+    } else if (r->draw_ms + r->submit_ms > w->budget_ms) {
+        w->slow_frame = r->frame;
+        w->trailing = P5_WATCHDOG_TRAILING;
+        if (w->trailing == 0) p5__watchdog_dump();
+    }
+}
+
+static void p5__overdraw_frame(void);
+#ifdef P5_TELEMETRY
+static void p5__telemetry_frame(const p5_frame_record_t* record);
+#endif
+
+void p5_frame_end(void) {
+    p5__sgp_usage_frame();
+    p5__overdraw_frame();
+    p5_state.timing.latency_ms = (float)((p5__now_ns() - p5_state.timing.draw_start) / 1e6);
+    
+    bool watchdog = p5_state.watchdog.budget_ms > 0.0f;
+#ifdef P5_TELEMETRY
+    bool telemetry = p5_state.telemetry.running;
+#else
+    bool telemetry = false;
+#endif
+    if (!watchdog && !telemetry) return;
+    
+    p5_frame_record_t record = p5__frame_record();
+    if (watchdog) p5__watchdog_frame(&record);
+#ifdef P5_TELEMETRY
+    if (telemetry) p5__telemetry_frame(&record);
+#endif
+}
+
+double p5_millis(void) {
+    return (p5__now_ns() - p5_state.timing.start) / 1e6;
+}
+
+float p5_delta_time(void) {
+    return p5_state.timing.delta_ms;
+}
+
+int p5_frame_count(void) {
+    return p5_state.timing.frame_count;
+}
+
+void p5_frame_rate(float fps) {
+    p5_state.timing.target_fps = fps > 0.0f ? fps : 0.0f;
+    p5_state.timing.deadline = 0;
+}
+
+float p5_get_frame_rate(void) {
+    const p5__timing_t* t = &p5_state.timing;
+    return t->window_sum > 0.0 ? (float)(t->window_count * 1000.0 / t->window_sum) : 0.0f;
+}
+
+float p5_get_target_frame_rate(void) {
+    return p5_state.timing.target_fps;
+}
+
+float p5_frame_latency_ms(void) {
+    return p5_state.timing.latency_ms;
+}
+
+p5_frame_stats_t p5_frame_stats(void) {
+    const p5__timing_t* t = &p5_state.timing;
+    p5_frame_stats_t stats = { .count = t->window_count, .fps = p5_get_frame_rate() };
+    if (t->window_count == 0) return stats;
+    
+    for (int i = 0; i < t->window_count; i++) {
+        if (t->window[i] > stats.max) stats.max = t->window[i];
+    }
+    
+    // Percentiles are bucket upper edges, clamped to the longest frame
+    const float fractions[3] = { 0.50f, 0.95f, 0.99f };
+    float* results[3] = { &stats.p50, &stats.p95, &stats.p99 };
+    int seen = 0, next = 0;
+    for (int bucket = 0; bucket < P5__FRAME_TIME_BUCKETS && next < 3; bucket++) {
+        seen += t->histogram[bucket];
+        while (next < 3 && seen >= (int)ceilf(fractions[next] * t->window_count)) {
+            float edge = (bucket + 1) * P5__FRAME_TIME_BUCKET_MS;
+            *results[next++] = edge < stats.max ? edge : stats.max;
+        }
+    }
+    return stats;
+}
+
+bool p5_watchdog(float budget_ms, const char* path) {
+    FILE* file = NULL;
+    if (budget_ms > 0.0f && path) {
+        file = fopen(path, "a");
+        if (!file) {
+            printf("[WARNING] p5_watchdog: cannot open %s\n", path);
+            return false;
+        }
+    }
+    p5_watchdog_callback(budget_ms, NULL, NULL);
+    p5_state.watchdog.file = file;
+    return true;
+}
+
+void p5_watchdog_callback(float budget_ms, p5_watchdog_fn fn, void* user_data) {
+    p5__watchdog_t* w = &p5_state.watchdog;
+    if (w->file) fclose(w->file);
+    w->file = NULL;
+    w->budget_ms = budget_ms > 0.0f ? budget_ms : 0.0f;
+    w->callback = fn;
+    w->user_data = user_data;
+    w->count = 0;
+    w->next = 0;
+    w->trailing = 0;
+}
+
+// sgp buffer usage functions
+p5_sgp_usage_t p5_sgp_usage(void) {
+    p5_sgp_usage_t usage = p5_state.sgp_usage.usage;
+    sgp_desc desc = sgp_query_desc();
+    usage.capacity.vertices = desc.max_vertices;
+    usage.capacity.commands = desc.max_commands;
+    usage.capacity.uniforms = desc.max_commands;
+    return usage;
+}
+
+// Smallest power of two holding peak plus 25% headroom
+static uint32_t p5__sgp_recommended_size(uint32_t peak) {
+    uint32_t wanted = peak + peak / 4, size = 256;
+    while (size < wanted && size < 0x80000000u) size <<= 1;
+    return size;
+}
+
+void p5_sgp_usage_print(void) {
+    p5_sgp_usage_t u = p5_sgp_usage();
+    if (u.run.vertices == 0 && u.run.commands == 0) return;  // Nothing drawn
+    
+    printf("[INFO] p5: sgp peak use: vertices %u/%u, commands %u/%u, uniforms %u/%u\n",
+           u.run.vertices, u.capacity.vertices, u.run.commands, u.capacity.commands,
+           u.run.uniforms, u.capacity.uniforms);
+    if (u.dropped_frames > 0) {
+        printf("[WARNING] p5: sgp buffers overflowed in %u frames, which were not drawn\n",
+               u.dropped_frames);
+    }
+    uint32_t commands = u.run.commands > u.run.uniforms ? u.run.commands : u.run.uniforms;
+    printf("[INFO] p5: recommended sgp_desc: .max_vertices = %u, .max_commands = %u\n",
+           p5__sgp_recommended_size(u.run.vertices), p5__sgp_recommended_size(commands));
+}
+
+// Heap allocation functions
+p5_alloc_stats_t p5_alloc_stats(void) {
+    const p5__alloc_t* al = &p5_state.alloc;
+    p5_alloc_stats_t stats;
+    stats.frame_allocations = al->frame_allocations;
+    stats.frame_frees = al->frame_frees;
+    stats.allocations = al->allocations;
+    stats.frees = al->frees;
+    stats.allocating_frames = al->allocating_frames;
+    stats.arena_capacity = al->arena.capacity;
+    stats.arena_peak = al->arena.last_peak;
+    return stats;
+}
+
+void p5_alloc_stats_print(void) {
+    p5_alloc_stats_t a = p5_alloc_stats();
+    printf("[INFO] p5: heap allocations %llu, frees %llu; %u of %d frames allocated, last frame %u\n",
+           (unsigned long long)a.allocations, (unsigned long long)a.frees,
+           a.allocating_frames, p5_state.timing.frame_count, a.frame_allocations);
+    printf("[INFO] p5: frame scratch arena %zu bytes, last frame used %zu\n",
+           a.arena_capacity, a.arena_peak);
+}
+
+// Batch-break diagnostics functions
+#ifdef P5_BATCH_DIAGNOSTICS
+static p5__batch_command_t* p5__batch_at(p5__batch_level_t* level, int index) {
+    return &level->commands[index % P5__BATCH_HISTORY];
+}
+
+static bool p5__batch_regions_overlap(const float* a, const float* b) {
+    return !(a[2] <= b[0] || b[2] <= a[0] || a[3] <= b[1] || b[3] <= a[1]);
+}
+
+// Why cmd cannot share prev's bindings, or P5_BATCH_MERGED if it can
+static p5_batch_reason_t p5__batch_compatible(const p5__batch_command_t* prev, const p5__batch_command_t* cmd) {
+    if (prev->primitive != cmd->primitive || prev->blend_mode != cmd->blend_mode ||
+        prev->pipeline != cmd->pipeline) {
+        return P5_BATCH_BREAK_PIPELINE;
+    }
+    if (memcmp(&prev->textures, &cmd->textures, sizeof(cmd->textures)) != 0) {
+        return P5_BATCH_BREAK_IMAGE;
+    }
+    if (cmd->pipeline && memcmp(&prev->uniform, &cmd->uniform, sizeof(cmd->uniform)) != 0) {
+        return P5_BATCH_BREAK_UNIFORM;
+    }
+    return P5_BATCH_MERGED;
+}
+
+// Replay sgp's batch optimizer (_sgp_merge_batch_command) on p5's model of
+// the command queue and vertex buffer, updating the model the way sgp
+// updates its own. cmd's vertices have already been allocated.
+static p5_batch_reason_t p5__batch_classify(p5__batch_level_t* level, p5__batch_command_t* cmd) {
+    bool strip = cmd->primitive == SG_PRIMITIVETYPE_TRIANGLE_STRIP ||
+                 cmd->primitive == SG_PRIMITIVETYPE_LINE_STRIP;
+    int oldest = level->count > P5__BATCH_HISTORY ? level->count - P5__BATCH_HISTORY : 0;
+    p5__batch_command_t* prev = NULL;
+    p5__batch_command_t* inter[SGP_BATCH_OPTIMIZER_DEPTH + 1];
+    int inter_count = 0, index = level->count - 1;
+    p5_batch_reason_t nearest = P5_BATCH_BREAK_STATE;
+    bool depth_exhausted = false;
+    
+    int lookup_depth = SGP_BATCH_OPTIMIZER_DEPTH;
+    for (int depth = 0; !strip && index >= oldest; depth++, index--) {
+        if (depth >= lookup_depth) {
+            depth_exhausted = true;
+            break;
+        }
+        p5__batch_command_t* c = p5__batch_at(level, index);
+        if (c->merged_away) {
+            lookup_depth++;
+            continue;
+        }
+        if (c->barrier) break;
+        p5_batch_reason_t reason = p5__batch_compatible(c, cmd);
+        if (reason == P5_BATCH_MERGED) {
+            prev = c;
+            break;
+        }
+        if (inter_count == 0) nearest = reason;
+        inter[inter_count++] = c;
+    }
+    
+    p5_batch_reason_t result = strip ? P5_BATCH_BREAK_STRIP : nearest;
+    if (prev) {
+        bool overlaps_next = false, overlaps_prev = false;
+        for (int i = 0; i < inter_count; i++) {
+            if (p5__batch_regions_overlap(cmd->region, inter[i]->region)) overlaps_next = true;
+            if (p5__batch_regions_overlap(prev->region, inter[i]->region)) overlaps_prev = true;
+        }
+        
+        float region[4];
+        region[0] = cmd->region[0] < prev->region[0] ? cmd->region[0] : prev->region[0];
+        region[1] = cmd->region[1] < prev->region[1] ? cmd->region[1] : prev->region[1];
+        region[2] = cmd->region[2] > prev->region[2] ? cmd->region[2] : prev->region[2];
+        region[3] = cmd->region[3] > prev->region[3] ? cmd->region[3] : prev->region[3];
+        
+        if (overlaps_next && overlaps_prev) {
+            result = P5_BATCH_BREAK_OVERLAP;
+        } else if (!overlaps_next) {
+            // Batch into the previous command, moving the vertices after it
+            uint32_t prev_end = prev->vertex_index + prev->num_vertices;
+            if (inter_count > 0 && level->cur_vertex - prev_end > P5__BATCH_MAX_MOVE_VERTICES) {
+                result = P5_BATCH_BREAK_MOVE;
+            } else {
+                for (int i = 0; i < inter_count; i++) inter[i]->vertex_index += cmd->num_vertices;
+                prev->num_vertices += cmd->num_vertices;
+                memcpy(prev->region, region, sizeof(region));
+                return P5_BATCH_MERGED;
+            }
+        } else if (cmd->num_vertices > P5__BATCH_MAX_MOVE_VERTICES) {
+            result = P5_BATCH_BREAK_MOVE;
+        } else {
+            // Batch into a new command that replaces the previous one
+            level->cur_vertex += prev->num_vertices;
+            cmd->num_vertices += prev->num_vertices;
+            memcpy(cmd->region, region, sizeof(region));
+            prev->merged_away = true;
+            *p5__batch_at(level, level->count++) = *cmd;
+            return P5_BATCH_MERGED;
+        }
+    } else if (depth_exhausted) {
+        // A compatible command further back would have merged with a deeper search
+        for (; index >= oldest; index--) {
+            p5__batch_command_t* c = p5__batch_at(level, index);
+            if (c->barrier) break;
+            if (!c->merged_away && p5__batch_compatible(c, cmd) == P5_BATCH_MERGED) {
+                result = P5_BATCH_BREAK_DEPTH;
+                break;
+            }
+        }
+    }
+    
+    *p5__batch_at(level, level->count++) = *cmd;
+    return result;
+}
+
+static void p5__batch_count_site(p5_batch_reason_t reason) {
+    p5__batch_t* b = &p5_state.batch;
+    b->totals[reason]++;
+    const char* file = b->site_file ? b->site_file : "(no call site)";
+    int line = b->site_file ? b->site_line : 0;
+    
+    if (b->site_count * 2 >= b->site_capacity) {
+        int capacity = b->site_capacity ? b->site_capacity * 2 : 64;
+        p5__batch_site_t* sites = (p5__batch_site_t*)p5__calloc((size_t)capacity, sizeof(p5__batch_site_t));
+        if (!sites) return;
+        for (int i = 0; i < b->site_capacity; i++) {
+            p5__batch_site_t* old = &b->sites[i];
+            if (!old->file) continue;
+            uint32_t h = ((uint32_t)(uintptr_t)old->file ^ (uint32_t)old->line * 2654435761u) & (capacity - 1);
+            while (sites[h].file) h = (h + 1) & (capacity - 1);
+            sites[h] = *old;
+        }
+        p5__free(b->sites);
+        b->sites = sites;
+        b->site_capacity = capacity;
+    }
+    
+    // __FILE__ strings of one translation unit share a pointer; compare
+    // contents so sites from headers included in several units combine
+    uint32_t h = ((uint32_t)(uintptr_t)file ^ (uint32_t)line * 2654435761u) & (b->site_capacity - 1);
+    while (b->sites[h].file && (b->sites[h].line != line || strcmp(b->sites[h].file, file) != 0)) {
+        h = (h + 1) & (b->site_capacity - 1);
+    }
+    p5__batch_site_t* site = &b->sites[h];
+    if (!site->file) {
+        site->file = file;
+        site->line = line;
+        b->site_count++;
+    }
+    site->counts[reason]++;
+}
+
+static void p5__batch_command(sg_primitive_type primitive, sgp_blend_mode blend_mode,
+                              const float* region, uint32_t num_vertices) {
+    // Draws entirely outside the viewport are dropped by sgp
+    if (region[0] > 1.0f || region[1] > 1.0f || region[2] < -1.0f || region[3] < -1.0f) return;
+    
+    p5__batch_t* b = &p5_state.batch;
+    p5__batch_level_t* level = &b->levels[b->level];
+    const sgp_state* state = sgp_query_state();
+    p5__batch_command_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.primitive = primitive;
+    cmd.blend_mode = blend_mode;
+    cmd.pipeline = state->pipeline.id;
+    cmd.textures = state->textures;
+    if (cmd.pipeline) cmd.uniform = state->uniform;
+    memcpy(cmd.region, region, sizeof(cmd.region));
+    cmd.vertex_index = level->cur_vertex;
+    cmd.num_vertices = num_vertices;
+    level->cur_vertex += num_vertices;
+    
+    p5__batch_count_site(p5__batch_classify(level, &cmd));
+}
+
+static void p5__batch_draw(sg_primitive_type primitive, const float* xy, int count) {
+    if (!p5_state.batch.enabled) return;
+    
+    // Clip-space bounds, as sgp computes them from transformed vertices
+    // (points and lines are padded by the line thickness)
+    const sgp_state* state = sgp_query_state();
+    const sgp_mat2x3* m = &state->mvp;
+    float pad = primitive == SG_PRIMITIVETYPE_TRIANGLES ? 0.0f : state->thickness;
+    float region[4] = { FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int i = 0; i < count; i++) {
+        float x = m->v[0][0] * xy[i*2] + m->v[0][1] * xy[i*2+1] + m->v[0][2];
+        float y = m->v[1][0] * xy[i*2] + m->v[1][1] * xy[i*2+1] + m->v[1][2];
+        if (x - pad < region[0]) region[0] = x - pad;
+        if (y - pad < region[1]) region[1] = y - pad;
+        if (x + pad > region[2]) region[2] = x + pad;
+        if (y + pad > region[3]) region[3] = y + pad;
+    }
+    // sgp draws rects as two triangles
+    uint32_t vertices = primitive == SG_PRIMITIVETYPE_TRIANGLES && count == 4 ? 6u : (uint32_t)count;
+    p5__batch_command(primitive, state->blend_mode, region, vertices);
+}
+
+static void p5__batch_clear(void) {
+    if (!p5_state.batch.enabled) return;
+    const float region[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+    p5__batch_command(SG_PRIMITIVETYPE_TRIANGLES, SGP_BLENDMODE_NONE, region, 6);
+}
+
+static void p5__batch_barrier(void) {
+    p5__batch_level_t* level = &p5_state.batch.levels[p5_state.batch.level];
+    p5__batch_command_t* c = p5__batch_at(level, level->count++);
+    memset(c, 0, sizeof(*c));
+    c->barrier = true;
+}
+
+// A nested sgp_begin() starts an empty queue; sgp_end() returns to the outer one
+static void p5__batch_begin(void) {
+    p5__batch_t* b = &p5_state.batch;
+    uint32_t cur_vertex = b->levels[b->level].cur_vertex;
+    if (b->level < P5__BATCH_LEVELS - 1) b->level++;
+    b->levels[b->level].count = 0;
+    b->levels[b->level].cur_vertex = cur_vertex;
+}
+
+static void p5__batch_end(void) {
+    p5__batch_t* b = &p5_state.batch;
+    if (b->level > 0) b->level--;
+}
+
+void p5_batch_diagnostics(bool enabled) {
+    p5_state.batch.enabled = enabled;
+}
+
+void p5_batch_diagnostics_reset(void) {
+    p5__batch_t* b = &p5_state.batch;
+    p5__free(b->sites);
+    b->sites = NULL;
+    b->site_count = 0;
+    b->site_capacity = 0;
+    memset(b->totals, 0, sizeof(b->totals));
+}
+
+uint32_t p5_batch_count(p5_batch_reason_t reason) {
+    return reason < P5_BATCH_REASON_COUNT ? p5_state.batch.totals[reason] : 0;
+}
+
+void p5_batch_call_site(const char* file, int line) {
+    p5_state.batch.site_file = file;
+    p5_state.batch.site_line = line;
+}
+
+static uint32_t p5__batch_site_breaks(const p5__batch_site_t* site) {
+    uint32_t breaks = 0;
+    for (int r = P5_BATCH_MERGED + 1; r < P5_BATCH_REASON_COUNT; r++) breaks += site->counts[r];
+    return breaks;
+}
+
+static int p5__batch_site_compare(const void* a, const void* b) {
+    uint32_t breaks_a = p5__batch_site_breaks(*(const p5__batch_site_t* const*)a);
+    uint32_t breaks_b = p5__batch_site_breaks(*(const p5__batch_site_t* const*)b);
+    return breaks_a < breaks_b ? 1 : breaks_a > breaks_b ? -1 : 0;
+}
+
+void p5_batch_diagnostics_print(void) {
+    p5__batch_t* b = &p5_state.batch;
+    static const char* names[P5_BATCH_REASON_COUNT] = {
+        "merged", "state", "pipeline", "image", "uniform", "overlap", "depth", "move", "strip"
+    };
+    
+    p5__batch_site_t** sorted = (p5__batch_site_t**)p5__malloc((size_t)(b->site_count + 1) * sizeof(*sorted));
+    if (!sorted) return;
+    int count = 0;
+    for (int i = 0; i < b->site_capacity; i++) {
+        if (b->sites[i].file) sorted[count++] = &b->sites[i];
+    }
+    qsort(sorted, (size_t)count, sizeof(*sorted), p5__batch_site_compare);
+    
+    printf("[INFO] p5 batch diagnostics (sgp draws per outcome, SGP_BATCH_OPTIMIZER_DEPTH %d)\n",
+           SGP_BATCH_OPTIMIZER_DEPTH);
+    printf("%-40s", "call site");
+    for (int r = 0; r < P5_BATCH_REASON_COUNT; r++) printf(" %9s", names[r]);
+    printf("\n");
+    for (int i = 0; i < count; i++) {
+        char site[256];
+        snprintf(site, sizeof(site), "%s:%d", sorted[i]->file, sorted[i]->line);
+        printf("%-40s", site);
+        for (int r = 0; r < P5_BATCH_REASON_COUNT; r++) printf(" %9u", sorted[i]->counts[r]);
+        printf("\n");
+    }
+    printf("%-40s", "total");
+    for (int r = 0; r < P5_BATCH_REASON_COUNT; r++) printf(" %9u", b->totals[r]);
+    printf("\n");
+    p5__free(sorted);
+}
+#endif // P5_BATCH_DIAGNOSTICS
+
+// Overdraw heat map functions
+
+// Heat color of one layer in 8-bit steps: red saturates after 8 layers,
+// green after 16 and blue after P5__OVERDRAW_LAYERS
+static void p5__overdraw_set_layers(int layers) {
+    float r = layers * 32 + 0.5f, g = layers * 16 + 0.5f, b = layers * 8 + 0.5f;
+    sgp_set_color(r / 255.0f, g / 255.0f, b / 255.0f, 1.0f);
+}
+
+// Clip a convex clip-space polygon to the viewport square [-1, 1]
+// (Sutherland-Hodgman); each plane adds at most one vertex, so a polygon
+// of n points needs room for n + 4
+static int p5__overdraw_clip(float* poly, int count) {
+    float out[16];
+    for (int plane = 0; plane < 4 && count > 0; plane++) {
+        int axis = plane & 1;
+        float side = plane < 2 ? -1.0f : 1.0f;
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            const float* a = &poly[i*2];
+            const float* b = &poly[((i + 1) % count)*2];
+            float da = 1.0f - side * a[axis];  // Distance inside the plane
+            float db = 1.0f - side * b[axis];
+            if (da >= 0.0f) {
+                out[n*2] = a[0];
+                out[n*2+1] = a[1];
+                n++;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                float t = da / (da - db);
+                out[n*2] = a[0] + t * (b[0] - a[0]);
+                out[n*2+1] = a[1] + t * (b[1] - a[1]);
+                n++;
+            }
+        }
+        memcpy(poly, out, n * 2 * sizeof(float));
+        count = n;
+    }
+    return count;
+}
+
+// Add the pixels a draw shades to this frame's total; NULL xy is a clear
+static void p5__overdraw_count(sg_primitive_type primitive, const float* xy, int count) {
+    p5__overdraw_t* o = &p5_state.overdraw;
+    const sgp_state* state = sgp_query_state();
+    float half_w = state->viewport.w * 0.5f, half_h = state->viewport.h * 0.5f;
+    float viewport_pixels = (float)state->viewport.w * (float)state->viewport.h;
+    if (viewport_pixels > o->canvas_pixels) o->canvas_pixels = viewport_pixels;
+    if (!xy) {
+        o->shaded += viewport_pixels;
+        return;
+    }
+    
+    const sgp_mat2x3* m = &state->mvp;
+    float poly[16];
+    for (int i = 0; i < count; i++) {
+        poly[i*2] = m->v[0][0] * xy[i*2] + m->v[0][1] * xy[i*2+1] + m->v[0][2];
+        poly[i*2+1] = m->v[1][0] * xy[i*2] + m->v[1][1] * xy[i*2+1] + m->v[1][2];
+    }
+    int n = p5__overdraw_clip(poly, count);
+    
+    if (primitive == SG_PRIMITIVETYPE_POINTS) {
+        o->shaded += n > 0 ? 1.0 : 0.0;
+    } else if (primitive == SG_PRIMITIVETYPE_LINES) {
+        // A clipped segment comes back as a degenerate polygon that runs
+        // there and back; lines rasterize one pixel per major-axis step
+        double steps = 0.0;
+        for (int i = 0; i < n; i++) {
+            int j = (i + 1) % n;
+            float dx = fabsf(poly[j*2] - poly[i*2]) * half_w;
+            float dy = fabsf(poly[j*2+1] - poly[i*2+1]) * half_h;
+            steps += dx > dy ? dx : dy;
+        }
+        o->shaded += steps * 0.5;
+    } else {
+        double area = 0.0;
+        for (int i = 0; i < n; i++) {
+            int j = (i + 1) % n;
+            area += poly[i*2] * poly[j*2+1] - poly[j*2] * poly[i*2+1];
+        }
+        o->shaded += fabs(area) * 0.5 * half_w * half_h;
+    }
+}
+
+// Count a draw and switch sgp to one additive heat layer for it
+static void p5__overdraw_begin(sg_primitive_type primitive, const float* xy, int count) {
+    p5__overdraw_t* o = &p5_state.overdraw;
+    p5__overdraw_count(primitive, xy, count);
+    const sgp_state* state = sgp_query_state();
+    o->saved_color = state->color;
+    o->saved_blend_mode = state->blend_mode;
+    p5__overdraw_set_layers(1);
+    sgp_set_blend_mode(SGP_BLENDMODE_ADD);
+}
+
+static void p5__overdraw_end(void) {
+    const p5__overdraw_t* o = &p5_state.overdraw;
+    sgp_set_color((o->saved_color.r + 0.5f) / 255.0f, (o->saved_color.g + 0.5f) / 255.0f,
+                  (o->saved_color.b + 0.5f) / 255.0f, (o->saved_color.a + 0.5f) / 255.0f);
+    sgp_set_blend_mode(o->saved_blend_mode);
+}
+
+static void p5__overdraw_frame(void) {
+    p5__overdraw_t* o = &p5_state.overdraw;
+    o->average = o->canvas_pixels > 0.0f ? (float)(o->shaded / o->canvas_pixels) : 0.0f;
+    o->shaded = 0.0;
+    o->canvas_pixels = 0.0f;
+}
+
+void p5_overdraw(bool enabled) {
+    p5__overdraw_t* o = &p5_state.overdraw;
+    if (o->enabled == enabled) return;
+    o->enabled = enabled;
+    
+    // Cached frames were drawn in the other mode
+    p5_redraw();
+    p5_state.incremental.full_redraw = true;
+}
+
+bool p5_is_overdraw(void) {
+    return p5_state.overdraw.enabled;
+}
+
+void p5_overdraw_legend(void) {
+    if (!p5_state.overdraw.enabled) return;
+    
+    const float cell = 6.0f, height = 10.0f, tick = 4.0f, margin = 8.0f;
+    float x = margin, y = p5_height() - margin - height;
+    sgp_push_transform();
+    sgp_reset_transform();
+    sgp_set_blend_mode(SGP_BLENDMODE_NONE);
+    
+    sgp_set_color(0.0f, 0.0f, 0.0f, 1.0f);
+    sgp_draw_filled_rect(x - 2.0f, y - tick - 3.0f, P5__OVERDRAW_LAYERS * cell + 4.0f, height + tick + 5.0f);
+    for (int layers = 1; layers <= P5__OVERDRAW_LAYERS; layers++) {
+        p5__overdraw_set_layers(layers);
+        sgp_draw_filled_rect(x + (layers - 1) * cell, y, cell, height);
+    }
+    sgp_set_color(1.0f, 1.0f, 1.0f, 1.0f);
+    for (int layers = 8; layers <= P5__OVERDRAW_LAYERS; layers += 8) {
+        sgp_draw_filled_rect(x + (layers - 1) * cell + cell * 0.5f - 0.5f, y - tick - 1.0f, 1.0f, tick);
+    }
+    
+    sgp_reset_color();
+    sgp_reset_blend_mode();
+    sgp_pop_transform();
+}
+
+float p5_overdraw_average(void) {
+    return p5_state.overdraw.average;
+}
+
+// Draw log functions
+static void p5__draw_log(p5_draw_op_t op, const float* xy, int count) {
+    static const int op_vertices[P5_DRAW_OP_COUNT] = { 3, 6, 2, 1, 6, 6 };
+    p5_draw_log_t* log = p5_state.draw_log;
+    if (log->count == log->capacity) {
+        int capacity = log->capacity ? log->capacity * 2 : 256;
+        p5_draw_record_t* records = (p5_draw_record_t*)p5__realloc(log->records, capacity * sizeof(*records));
+        if (!records) {
+            printf("[WARNING] Draw log out of memory, stopped logging\n");
+            p5_state.draw_log = NULL;
+            return;
+        }
+        log->records = records;
+        log->capacity = capacity;
+    }
+
+    const sgp_state* sgp = sgp_query_state();
+    p5_draw_record_t* r = &log->records[log->count++];
+    memset(r, 0, sizeof(*r));
+    r->op = op;
+    r->vertices = op_vertices[op];
+    r->color[0] = sgp->color.r;
+    r->color[1] = sgp->color.g;
+    r->color[2] = sgp->color.b;
+    r->color[3] = sgp->color.a;
+    r->blend_mode = (int)sgp->blend_mode;
+    memcpy(r->transform, sgp->transform.v, sizeof(r->transform));
+    r->point_count = count;
+    for (int i = 0; i < count; i++) {
+        float x = xy[i*2], y = xy[i*2+1];
+        r->xy[i*2] = r->transform[0][0] * x + r->transform[0][1] * y + r->transform[0][2];
+        r->xy[i*2+1] = r->transform[1][0] * x + r->transform[1][1] * y + r->transform[1][2];
+    }
+    log->vertices += r->vertices;
+    log->ops[op]++;
+}
+
+void p5_draw_log_begin(p5_draw_log_t* log) {
+    p5_state.draw_log = log;
+}
+
+void p5_draw_log_end(void) {
+    p5_state.draw_log = NULL;
+}
+
+void p5_draw_log_clear(p5_draw_log_t* log) {
+    log->count = 0;
+    log->vertices = 0;
+    memset(log->ops, 0, sizeof(log->ops));
+}
+
+void p5_draw_log_free(p5_draw_log_t* log) {
+    if (p5_state.draw_log == log) p5_state.draw_log = NULL;
+    p5__free(log->records);
+    *log = (p5_draw_log_t){0};
+}
+
+uint64_t p5_draw_log_hash(const p5_draw_log_t* log) {
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < log->count; i++) {
+        const p5_draw_record_t* r = &log->records[i];
+        int32_t fields[2 + 8];
+        fields[0] = (int32_t)r->op;
+        fields[1] = (int32_t)r->blend_mode;
+        for (int j = 0; j < r->point_count * 2; j++) {
+            fields[2 + j] = (int32_t)lroundf(r->xy[j] * 16.0f);
+        }
+        hash = p5__hash_bytes(hash, fields, (2 + r->point_count * 2) * sizeof(int32_t));
+        hash = p5__hash_bytes(hash, r->color, sizeof(r->color));
+    }
+    return hash;
+}
+
+// Call tracing functions
+#ifdef P5_TRACE
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+// CPU cycle counter (time-stamp counter on x86, virtual counter on arm64),
+// falling back to the monotonic clock in nanoseconds
+static inline uint64_t p5__trace_cycles(void) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return p5__now_ns();
+#endif
+}
+
+static const char* const p5__trace_names[P5__TRACE_COUNT] = {
+#define P5__TRACE_NAME(name) #name,
+    P5__TRACE_FUNCTIONS(P5__TRACE_NAME)
+#undef P5__TRACE_NAME
+};
+
+void p5_trace_enter(void) {
+    p5__trace_t* t = &p5_state.trace;
+    if (t->depth < P5__TRACE_DEPTH) t->starts[t->depth] = p5__trace_cycles();
+    t->depth++;
+}
+
+void p5_trace_leave(int id) {
+    uint64_t now = p5__trace_cycles();
+    p5__trace_t* t = &p5_state.trace;
+    if (--t->depth >= P5__TRACE_DEPTH || id < 0 || id >= P5__TRACE_COUNT) return;
+    
+    uint64_t cycles = now - t->starts[t->depth];
+    p5__trace_entry_t* e = &t->entries[id];
+    if (e->calls == 0 || cycles < e->min_cycles) e->min_cycles = cycles;
+    if (cycles > e->max_cycles) e->max_cycles = cycles;
+    e->calls++;
+    e->cycles += cycles;
+    
+    int bucket = 0;
+    while (bucket < P5__TRACE_BUCKETS - 1 && cycles >> bucket) bucket++;
+    e->histogram[bucket]++;
+}
+
+int p5_trace_leave_int(int id, int value) {
+    p5_trace_leave(id);
+    return value;
+}
+
+p5_color_t p5_trace_leave_color(int id, p5_color_t value) {
+    p5_trace_leave(id);
+    return value;
+}
+
+void* p5_trace_leave_ptr(int id, void* value) {
+    p5_trace_leave(id);
+    return value;
+}
+
+// Start measuring the cycle counter against the clock
+static void p5__trace_calibrate(void) {
+    p5_state.trace.reset_cycles = p5__trace_cycles();
+    p5_state.trace.reset_ns = p5__now_ns();
+}
+
+void p5_trace_reset(void) {
+    p5__trace_t* t = &p5_state.trace;
+    int depth = t->depth;  // Calls in progress still return here
+    memset(t, 0, sizeof(*t));
+    t->depth = depth;
+    p5__trace_calibrate();
+}
+
+// Upper edge of the bucket holding the given fraction of calls
+static uint64_t p5__trace_percentile(const p5__trace_entry_t* e, double fraction) {
+    uint64_t seen = 0, rank = (uint64_t)ceil(fraction * e->calls);
+    for (int bucket = 0; bucket < P5__TRACE_BUCKETS; bucket++) {
+        seen += e->histogram[bucket];
+        if (seen >= rank) {
+            uint64_t edge = bucket == 0 ? 0 : (uint64_t)1 << bucket;
+            return edge < e->max_cycles ? edge : e->max_cycles;
+        }
+    }
+    return e->max_cycles;
+}
+
+p5_trace_stat_t p5_trace_stat(const char* name) {
+    p5_trace_stat_t stat = {0};
+    for (int i = 0; i < P5__TRACE_COUNT; i++) {
+        if (name && strcmp(p5__trace_names[i], name) == 0) {
+            const p5__trace_entry_t* e = &p5_state.trace.entries[i];
+            stat.calls = e->calls;
+            stat.cycles = e->cycles;
+            stat.min_cycles = e->min_cycles;
+            stat.max_cycles = e->max_cycles;
+            if (e->calls > 0) {
+                stat.p50_cycles = p5__trace_percentile(e, 0.50);
+                stat.p99_cycles = p5__trace_percentile(e, 0.99);
+            }
+            break;
+        }
+    }
+    return stat;
+}
+
+static int p5__trace_compare(const void* a, const void* b) {
+    uint64_t ca = p5_state.trace.entries[*(const int*)a].cycles;
+    uint64_t cb = p5_state.trace.entries[*(const int*)b].cycles;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static void p5__trace_write(FILE* out, bool histograms) {
+    const p5__trace_t* t = &p5_state.trace;
+    
+    // Calibrate the cycle counter against the clock since p5_init() or the
+    // last reset
+    uint64_t cycles = p5__trace_cycles() - t->reset_cycles;
+    uint64_t ns = p5__now_ns() - t->reset_ns;
+    double ns_per_cycle = t->reset_ns && cycles > 0 ? (double)ns / (double)cycles : 0.0;
+    
+    int order[P5__TRACE_COUNT], count = 0;
+    for (int i = 0; i < P5__TRACE_COUNT; i++) {
+        if (t->entries[i].calls > 0) order[count++] = i;
+    }
+    qsort(order, count, sizeof(order[0]), p5__trace_compare);
+    
+    fprintf(out, "[INFO] p5 trace (latency in cycles%s)\n", ns_per_cycle > 0.0 ? "" : ", counter not calibrated");
+    if (ns_per_cycle > 0.0) {
+        fprintf(out, "cycle counter: %.3f GHz\n", 1.0 / ns_per_cycle);
+    }
+    fprintf(out, "%-28s %10s %10s %8s %8s %8s %10s\n", "function", "calls", "total ms", "mean", "p50", "p99", "max");
+    for (int i = 0; i < count; i++) {
+        const p5__trace_entry_t* e = &t->entries[order[i]];
+        fprintf(out, "%-28s %10llu %10.3f %8.0f %8llu %8llu %10llu\n", p5__trace_names[order[i]],
+                (unsigned long long)e->calls, e->cycles * ns_per_cycle / 1e6,
+                (double)e->cycles / e->calls,
+                (unsigned long long)p5__trace_percentile(e, 0.50),
+                (unsigned long long)p5__trace_percentile(e, 0.99),
+                (unsigned long long)e->max_cycles);
+    }
+    if (!histograms) return;
+    
+    // Non-empty buckets as "<upper edge>:<calls>"
+    for (int i = 0; i < count; i++) {
+        const p5__trace_entry_t* e = &t->entries[order[i]];
+        fprintf(out, "%s histogram:", p5__trace_names[order[i]]);
+        for (int bucket = 0; bucket < P5__TRACE_BUCKETS; bucket++) {
+            if (e->histogram[bucket] == 0) continue;
+            fprintf(out, " %llu:%llu", bucket == 0 ? 0ull : 1ull << bucket,
+                    (unsigned long long)e->histogram[bucket]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+void p5_trace_print(void) {
+    p5__trace_write(stdout, false);
+}
+
+bool p5_trace_dump(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("[WARNING] p5_trace_dump: cannot open %s\n", path);
+        return false;
+    }
+    p5__trace_write(file, true);
+    fclose(file);
+    return true;
+}
+#endif // P5_TRACE
+
+// Telemetry functions
+#ifdef P5_TELEMETRY
+static const char* p5__metric_names[P5__METRIC_COUNT] = {
+    "shapes", "vertices", "commands", "uniforms", "draw_calls"
+};
+
+// Format one report in Prometheus text exposition format
+static int p5__telemetry_format(const p5__telemetry_report_t* r, char* buf, size_t size) {
+    int n = snprintf(buf, size,
+        "# HELP p5_uptime_seconds Seconds since p5_init()\n"
+        "# TYPE p5_uptime_seconds gauge\n"
+        "p5_uptime_seconds %.3f\n"
+        "# HELP p5_frames_total Frames drawn\n"
+        "# TYPE p5_frames_total counter\n"
+        "p5_frames_total %llu\n"
+        "# HELP p5_dropped_frames_total Frames sgp discarded because a buffer was full\n"
+        "# TYPE p5_dropped_frames_total counter\n"
+        "p5_dropped_frames_total %llu\n"
+        "# HELP p5_telemetry_dropped_reports_total Reports lost because the writer fell behind\n"
+        "# TYPE p5_telemetry_dropped_reports_total counter\n"
+        "p5_telemetry_dropped_reports_total %llu\n"
+        "# HELP p5_frames_per_second Average frame rate over the frame-time window\n"
+        "# TYPE p5_frames_per_second gauge\n"
+        "p5_frames_per_second %.3f\n"
+        "# HELP p5_frame_time_ms Frame time over the frame-time window\n"
+        "# TYPE p5_frame_time_ms summary\n"
+        "p5_frame_time_ms{quantile=\"0.5\"} %.3f\n"
+        "p5_frame_time_ms{quantile=\"0.95\"} %.3f\n"
+        "p5_frame_time_ms{quantile=\"0.99\"} %.3f\n"
+        "p5_frame_time_ms{quantile=\"1\"} %.3f\n"
+        "p5_frame_time_ms_count %d\n"
+        "# HELP p5_frame_latency_ms Start of the presented frame's draw() to the end of its submission\n"
+        "# TYPE p5_frame_latency_ms gauge\n"
+        "p5_frame_latency_ms %.3f\n",
+        r->uptime_s, (unsigned long long)r->frames_total,
+        (unsigned long long)r->dropped_frames_total, (unsigned long long)r->dropped_reports_total,
+        r->frame_stats.fps, r->frame_stats.p50, r->frame_stats.p95, r->frame_stats.p99,
+        r->frame_stats.max, r->frame_stats.count, r->latency_ms);
+    
+    for (int m = 0; m < P5__METRIC_COUNT && n > 0 && (size_t)n < size; m++) {
+        const char* name = p5__metric_names[m];
+        double avg = r->frames ? (double)r->sum[m] / r->frames : 0.0;
+        n += snprintf(buf + n, size - n,
+            "# HELP p5_%s_per_frame Per-frame %s over the last report interval\n"
+            "# TYPE p5_%s_per_frame gauge\n"
+            "p5_%s_per_frame{stat=\"avg\"} %.3f\n"
+            "p5_%s_per_frame{stat=\"max\"} %u\n",
+            name, name, name, name, avg, name, r->max[m]);
+        if (r->capacity[m] && n > 0 && (size_t)n < size) {
+            n += snprintf(buf + n, size - n,
+                "# HELP p5_sgp_%s_capacity sgp buffer size for %s\n"
+                "# TYPE p5_sgp_%s_capacity gauge\n"
+                "p5_sgp_%s_capacity %u\n",
+                name, name, name, name, r->capacity[m]);
+        }
+    }
+    return n > 0 && (size_t)n < size ? n : -1;
+}
+
+// Replace the metrics file atomically, or send the report to a Unix socket
+static void p5__telemetry_write(const char* path, const char* text, int length) {
+    if (strncmp(path, "unix:", 5) == 0) {
+#ifdef _WIN32
+        (void)text; (void)length;  // Unix sockets are not supported on Windows
+#else
+        struct sockaddr_un addr = {0};
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path + 5, strlen(path + 5));  // Length checked by p5_telemetry_begin
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return;
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+            for (int sent = 0; sent < length; ) {
+                ssize_t written = write(fd, text + sent, (size_t)(length - sent));
+                if (written <= 0) break;
+                sent += (int)written;
+            }
+        }
+        close(fd);
+#endif
+        return;
+    }
+    
+    char tmp_path[P5__TELEMETRY_PATH_MAX + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) return;
+    fwrite(text, 1, (size_t)length, file);
+    fclose(file);
+#ifdef _WIN32
+    MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    rename(tmp_path, path);
+#endif
+}
+
+// Writer thread: drain the queue, then poll until stopped
+static void p5__telemetry_run(p5__telemetry_t* tm) {
+    char text[8192];
+    for (;;) {
+        uint32_t tail = tm->tail;
+        if (tail != P5__ATOMIC_LOAD(&tm->head)) {
+            int length = p5__telemetry_format(&tm->queue[tail % P5__TELEMETRY_QUEUE], text, sizeof(text));
+            P5__ATOMIC_STORE(&tm->tail, tail + 1);
+            if (length > 0) p5__telemetry_write(tm->path, text, length);
+            continue;
+        }
+        if (P5__ATOMIC_LOAD(&tm->stop)) break;
+        p5__sleep_ns(10000000u);
+    }
+}
+
+static P5__THREAD_FN(p5__telemetry_thread) {
+    p5__telemetry_run((p5__telemetry_t*)arg);
+    return P5__THREAD_RETURN;
+}
+
+static void p5__telemetry_frame(const p5_frame_record_t* record) {
+    p5__telemetry_t* tm = &p5_state.telemetry;
+    p5__telemetry_report_t* r = &tm->current;
+    const uint32_t values[P5__METRIC_COUNT] = {
+        record->shapes, record->vertices, record->commands, record->uniforms, record->draw_calls
+    };
+    for (int m = 0; m < P5__METRIC_COUNT; m++) {
+        r->sum[m] += values[m];
+        if (values[m] > r->max[m]) r->max[m] = values[m];
+    }
+    r->frames++;
+    r->frames_total++;
+    if (record->dropped) r->dropped_frames_total++;
+    
+    uint64_t now = p5__now_ns();
+    if (now - tm->interval_start < tm->interval_ns) return;
+    tm->interval_start = now;
+    
+    r->uptime_s = (now - p5_state.timing.start) / 1e9;
+    r->frame_stats = p5_frame_stats();
+    r->latency_ms = record->latency_ms;
+    sgp_desc desc = sgp_query_desc();
+    r->capacity[P5__METRIC_VERTICES] = desc.max_vertices;
+    r->capacity[P5__METRIC_COMMANDS] = desc.max_commands;
+    r->capacity[P5__METRIC_UNIFORMS] = desc.max_commands;  // sgp sizes uniforms like commands
+    
+    uint32_t head = tm->head;
+    if (head - P5__ATOMIC_LOAD(&tm->tail) < P5__TELEMETRY_QUEUE) {
+        tm->queue[head % P5__TELEMETRY_QUEUE] = *r;
+        P5__ATOMIC_STORE(&tm->head, head + 1);
+    } else {
+        r->dropped_reports_total++;
+    }
+    
+    // Totals carry over; interval counters restart
+    r->frames = 0;
+    memset(r->sum, 0, sizeof(r->sum));
+    memset(r->max, 0, sizeof(r->max));
+}
+
+bool p5_telemetry_begin(const char* path, float interval_s) {
+    p5__telemetry_t* tm = &p5_state.telemetry;
+    if (tm->running) {
+        printf("[WARNING] p5_telemetry_begin: telemetry is already running\n");
+        return false;
+    }
+    if (!path || strlen(path) >= sizeof(tm->path) || interval_s <= 0.0f) {
+        printf("[WARNING] p5_telemetry_begin: invalid path or interval\n");
+        return false;
+    }
+    if (strncmp(path, "unix:", 5) == 0) {
+#ifdef _WIN32
+        printf("[WARNING] p5_telemetry_begin: Unix sockets are not supported on Windows\n");
+        return false;
+#else
+        if (strlen(path + 5) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+            printf("[WARNING] p5_telemetry_begin: socket path too long\n");
+            return false;
+        }
+#endif
+    }
+    
+    memset(tm, 0, sizeof(*tm));
+    strcpy(tm->path, path);
+    tm->interval_ns = (uint64_t)(interval_s * 1e9);
+    tm->interval_start = p5__now_ns();
+    
+    if (!p5__thread_start(&tm->thread, p5__telemetry_thread, tm)) {
+        printf("[WARNING] p5_telemetry_begin: cannot start writer thread\n");
+        return false;
+    }
+    tm->running = true;
+    return true;
+}
+
+void p5_telemetry_end(void) {
+    p5__telemetry_t* tm = &p5_state.telemetry;
+    if (!tm->running) return;
+    
+    // The writer drains queued reports before it exits
+    P5__ATOMIC_STORE(&tm->stop, 1u);
+    p5__thread_join(tm->thread);
+    tm->running = false;
+}
+#endif // P5_TELEMETRY
+
+void p5_image(const p5_graphics_t* pg, float x, float y) {
+    if (!pg) return;
+    p5_image_sized(pg, x, y, (float)pg->width, (float)pg->height);
+}
+
+static bool p5__incremental_image(const p5_graphics_t* pg, float x, float y, float w, float h);
+
+// Not recorded by command lists or frame capture (buffers are not serializable)
+void p5_image_sized(const p5_graphics_t* pg, float x, float y, float w, float h) {
+    if (!pg) return;
+    if (p5_state.recorder) {
+        printf("[WARNING] p5_image: not available while a recorder is active\n");
+        return;
+    }
+    if (p5__incremental_image(pg, x, y, w, h)) return;
+    p5__apply_transform();
+    p5__graphics_draw(pg, x, y, w, h);
+    p5__restore_transform();
+}
+
+// Command list functions
+void p5_cmdlist_begin(void) {
+    if (p5_state.recording || p5_state.recorder) {
+        printf("[WARNING] p5_cmdlist_begin: already recording (a command list, recorder or incremental frame)\n");
+        return;
+    }
+    p5_state.recording = (p5_cmdlist_t*)p5__calloc(1, sizeof(p5_cmdlist_t));
+}
+
+p5_cmdlist_t* p5_cmdlist_end(void) {
+    if (p5_state.recording == &p5_state.incremental.frame) return NULL;
+    p5_cmdlist_t* list = p5_state.recording;
+    p5_state.recording = NULL;
+    p5__recorded_scopes_end();
+    return list;
+}
+
+void p5_cmdlist_free(p5_cmdlist_t* list) {
+    if (!list) return;
+    p5__free(list->data);
+    p5__free(list);
+}
+
+// FNV-1a hash, used to compare shapes between frames
+static uint64_t p5__hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Canvas-space bounds of a shape command under the current style and transform
+static void p5__cmd_bounds(p5__cmd_op_t op, const float* a, p5__shape_record_t* r) {
+    float x0, y0, x1, y1;
+    float pad = p5_state.stroke_enabled ? fmaxf(p5_state.stroke_width, 1.0f) * 0.5f : 0.0f;
+    
+    switch (op) {
+        case P5__CMD_BACKGROUND:
+            r->x0 = -FLT_MAX; r->y0 = -FLT_MAX; r->x1 = FLT_MAX; r->y1 = FLT_MAX;
+            return;
+        case P5__CMD_POINT:
+            pad = fmaxf(p5_state.stroke_width, 1.0f) * 0.5f;
+            x0 = x1 = a[0]; y0 = y1 = a[1];
+            break;
+        case P5__CMD_RECT:
+            x0 = fminf(a[0], a[0] + a[2]); x1 = fmaxf(a[0], a[0] + a[2]);
+            y0 = fminf(a[1], a[1] + a[3]); y1 = fmaxf(a[1], a[1] + a[3]);
+            break;
+        case P5__CMD_IMAGE:
+            pad = 0.0f;
+            x0 = fminf(a[1], a[1] + a[3]); x1 = fmaxf(a[1], a[1] + a[3]);
+            y0 = fminf(a[2], a[2] + a[4]); y1 = fmaxf(a[2], a[2] + a[4]);
+            break;
+        case P5__CMD_ELLIPSE:
+        case P5__CMD_ARC:
+            x0 = a[0] - fabsf(a[2]) * 0.5f; x1 = a[0] + fabsf(a[2]) * 0.5f;
+            y0 = a[1] - fabsf(a[3]) * 0.5f; y1 = a[1] + fabsf(a[3]) * 0.5f;
+            break;
+        default: {
+            // Lines and polygons: bounds of their points
+            int count = p5__cmd_arg_count[op] / 2;
+            x0 = x1 = a[0]; y0 = y1 = a[1];
+            for (int i = 1; i < count; i++) {
+                x0 = fminf(x0, a[i*2]); x1 = fmaxf(x1, a[i*2]);
+                y0 = fminf(y0, a[i*2+1]); y1 = fmaxf(y1, a[i*2+1]);
+            }
+            break;
+        }
+    }
+    
+    // Pad for stroke and antialiasing, then apply translate * rotate * scale
+    x0 -= pad + 1.0f; y0 -= pad + 1.0f;
+    x1 += pad + 1.0f; y1 += pad + 1.0f;
+    const p5_transform_t* t = &p5_state.transform;
+    float c = cosf(t->rot), s = sinf(t->rot);
+    float corners[4][2] = { {x0, y0}, {x1, y0}, {x1, y1}, {x0, y1} };
+    r->x0 = r->y0 = FLT_MAX;
+    r->x1 = r->y1 = -FLT_MAX;
+    for (int i = 0; i < 4; i++) {
+        float px = corners[i][0] * t->sx, py = corners[i][1] * t->sy;
+        float tx = t->tx + px * c - py * s;
+        float ty = t->ty + px * s + py * c;
+        r->x0 = fminf(r->x0, tx); r->x1 = fmaxf(r->x1, tx);
+        r->y0 = fminf(r->y0, ty); r->y1 = fmaxf(r->y1, ty);
+    }
+}
+
+// Per-shape hook for incremental passes; returns false to skip drawing
+static bool p5__incremental_visit(p5__cmd_op_t op, const float* a) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    
+    if (inc->pass == P5__PASS_CULL) {
+        if (inc->shape_index >= inc->shape_count[inc->current]) return true;
+        const p5__shape_record_t* r = &inc->shapes[inc->current][inc->shape_index++];
+        return r->x1 >= inc->cull[0] && r->x0 <= inc->cull[2] &&
+               r->y1 >= inc->cull[1] && r->y0 <= inc->cull[3];
+    }
+    
+    // Measure pass: key and bounds of every shape
+    int cur = inc->current;
+    if (inc->shape_count[cur] == inc->shape_capacity[cur]) {
+        int capacity = inc->shape_capacity[cur] ? inc->shape_capacity[cur] * 2 : 256;
+        p5__shape_record_t* shapes = (p5__shape_record_t*)p5__realloc(inc->shapes[cur], 
+                                                                       capacity * sizeof(p5__shape_record_t));
+        if (!shapes) {
+            inc->full_redraw = true;
+            return false;
+        }
+        inc->shapes[cur] = shapes;
+        inc->shape_capacity[cur] = capacity;
+    }
+    p5__shape_record_t* r = &inc->shapes[cur][inc->shape_count[cur]++];
+    p5__cmd_bounds(op, a, r);
+    
+    uint64_t key = 14695981039346656037ull;
+    uint8_t op_byte = (uint8_t)op;
+    key = p5__hash_bytes(key, &op_byte, 1);
+    key = p5__hash_bytes(key, a, p5__cmd_arg_count[op] * sizeof(float));
+    if (op == P5__CMD_IMAGE && a[0] >= 0.0f && (int)a[0] < inc->image_count) {
+        // The slot is per frame; the buffer and its content are what matter
+        const p5_graphics_t* pg = inc->images[(int)a[0]];
+        key = p5__hash_bytes(key, &pg, sizeof(pg));
+        key = p5__hash_bytes(key, &pg->version, sizeof(pg->version));
+    }
+    if (op != P5__CMD_BACKGROUND) {
+        key = p5__hash_bytes(key, &p5_state.transform, sizeof(p5_transform_t));
+        key = p5__hash_bytes(key, &p5_state.fill_enabled, sizeof(bool));
+        key = p5__hash_bytes(key, &p5_state.stroke_enabled, sizeof(bool));
+        if (p5_state.fill_enabled) key = p5__hash_bytes(key, &p5_state.fill_color, sizeof(p5_color_t));
+        if (p5_state.stroke_enabled) {
+            key = p5__hash_bytes(key, &p5_state.stroke_color, sizeof(p5_color_t));
+            key = p5__hash_bytes(key, &p5_state.stroke_width, sizeof(float));
+        }
+    }
+    r->key = key;
+    return false;
+}
+
+// Draw one shape command (P5__CMD_POINT and up) with the current style
+static void p5__shape_draw(p5__cmd_op_t op, const float* a) {
+    switch (op) {
+        case P5__CMD_POINT: p5__point(a[0], a[1]); break;
+        case P5__CMD_LINE: p5__line(a[0], a[1], a[2], a[3]); break;
+        case P5__CMD_RECT: p5__rect(a[0], a[1], a[2], a[3]); break;
+        case P5__CMD_ELLIPSE: p5__ellipse(a[0], a[1], a[2], a[3]); break;
+        case P5__CMD_TRIANGLE: p5__triangle(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+        case P5__CMD_QUAD: p5__quad(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]); break;
+        case P5__CMD_ARC: p5__arc(a[0], a[1], a[2], a[3], a[4], a[5], (p5_arc_mode_t)a[6]); break;
+        default:
+            break;
+    }
+}
+
+// Execute recorded commands directly against the internal implementation,
+// bypassing argument conversion and recording checks of the public API
+static void p5__cmdlist_execute(const uint8_t* data, size_t size) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    float a[8];
+    int floor = p5_state.style_stack_depth;  // pop() never closes the caller's scopes
+    
+    while (p < end) {
+        p5__cmd_op_t op = (p5__cmd_op_t)*p++;
+        if (op >= P5__CMD_COUNT) {
+            printf("[WARNING] p5: invalid command list opcode %d\n", (int)op);
+            return;
+        }
+        size_t bytes = p5__cmd_arg_count[op] * sizeof(float);
+        if ((size_t)(end - p) < bytes) {
+            printf("[WARNING] p5: truncated command list\n");
+            return;
+        }
+        memcpy(a, p, bytes);
+        p += bytes;
+        
+        if (p5_state.incremental.pass != P5__PASS_NONE && p5__cmd_is_shape(op) &&
+            !p5__incremental_visit(op, a)) {
+            continue;
+        }
+        
+        switch (op) {
+            case P5__CMD_BACKGROUND:
+                p5__sgp_color((p5_color_t){a[0], a[1], a[2], a[3]});
+                p5__sgp_clear();
+                break;
+            case P5__CMD_FILL:
+                p5__style_save(P5__STYLE_FILL);
+                p5_state.fill_color = (p5_color_t){a[0], a[1], a[2], a[3]};
+                p5_state.fill_enabled = true;
+                break;
+            case P5__CMD_NO_FILL:
+                p5__style_save(P5__STYLE_FILL);
+                p5_state.fill_enabled = false;
+                break;
+            case P5__CMD_STROKE:
+                p5__style_save(P5__STYLE_STROKE);
+                p5_state.stroke_color = (p5_color_t){a[0], a[1], a[2], a[3]};
+                p5_state.stroke_enabled = true;
+                break;
+            case P5__CMD_NO_STROKE:
+                p5__style_save(P5__STYLE_STROKE);
+                p5_state.stroke_enabled = false;
+                break;
+            case P5__CMD_STROKE_WEIGHT:
+                p5__style_save(P5__STYLE_STROKE_WEIGHT);
+                p5_state.stroke_width = a[0];
+                break;
+            case P5__CMD_PUSH: p5__push(); break;
+            case P5__CMD_POP:
+                if (p5_state.style_stack_depth > floor) p5__pop();
+                break;
+            case P5__CMD_TRANSLATE:
+                p5__style_save(P5__STYLE_TRANSFORM);
+                p5_state.transform.tx += a[0];
+                p5_state.transform.ty += a[1];
+                break;
+            case P5__CMD_ROTATE:
+                p5__style_save(P5__STYLE_TRANSFORM);
+                p5_state.transform.rot += a[0];
+                break;
+            case P5__CMD_SCALE:
+                p5__style_save(P5__STYLE_TRANSFORM);
+                p5_state.transform.sx *= a[0];
+                p5_state.transform.sy *= a[1];
+                break;
+            case P5__CMD_IMAGE: {
+                // Slots only refer to buffers while the incremental frame itself runs
+                int slot = (int)a[0];
+                if (data != p5_state.incremental.frame.data ||
+                    slot < 0 || slot >= p5_state.incremental.image_count) break;
+                p5__apply_transform();
+                p5__graphics_draw(p5_state.incremental.images[slot], a[1], a[2], a[3], a[4]);
+                p5__restore_transform();
+                break;
+            }
+            default:
+                p5__shape_draw(op, a);
+                break;
+        }
+    }
+}
+
+// Append a list as one push() scope that it can neither leave nor leave
+// open: pop() commands beyond its own push() commands are dropped and
+// the scopes it leaves open are closed
+static void p5__cmdlist_append_scoped(p5_cmdlist_t* target, const p5_cmdlist_t* list) {
+    uint8_t push = P5__CMD_PUSH, pop = P5__CMD_POP;
+    p5__cmdlist_append(target, &push, 1);
+    int depth = 0;
+    size_t copied = 0;
+    for (size_t i = 0; i < list->size; ) {
+        uint8_t op = list->data[i];
+        if (op >= P5__CMD_COUNT) break;
+        size_t next = i + 1 + p5__cmd_arg_count[op] * sizeof(float);
+        if (next > list->size) break;
+        if (op == P5__CMD_PUSH) depth++;
+        if (op == P5__CMD_POP && depth-- == 0) {
+            depth = 0;
+            p5__cmdlist_append(target, list->data + copied, i - copied);
+            copied = next;
+        }
+        i = next;
+    }
+    p5__cmdlist_append(target, list->data + copied, list->size - copied);
+    for (; depth >= 0; depth--) p5__cmdlist_append(target, &pop, 1);
+}
+
+void p5_cmdlist_replay(const p5_cmdlist_t* list) {
+    if (!list || list->size == 0) return;
+    
+    // Replaying while recording nests the list into the active recording;
+    // while capturing, the list is captured and then drawn
+    if (p5_state.recording || p5_state.capture_file) {
+        p5_cmdlist_t* target = p5_state.recording ? p5_state.recording : &p5_state.capture;
+        p5__cmdlist_append_scoped(target, list);
+        if (p5_state.recording) return;
+    }
+    
+    // Scope the list so its style and transform changes do not leak out
+    int depth = p5_state.style_stack_depth;
+    p5__push();
+    p5__cmdlist_execute(list->data, list->size);
+    while (p5_state.style_stack_depth > depth) p5__pop();
+}
+
+// Recorder functions
+static const uint8_t p5__recorder_op_vertices[P5_DRAW_OP_COUNT] = {
+    3, 6, 2, 1, 0, 1    // Clears keep their color in one vertex
+};
+
+static bool p5__recorder_reserve(p5_recorder_t* rec, uint32_t vertices) {
+    if (rec->vertex_count + vertices > rec->vertex_capacity) {
+        uint32_t capacity = rec->vertex_capacity ? rec->vertex_capacity : 1024;
+        while (capacity < rec->vertex_count + vertices) capacity *= 2;
+        sgp_vertex* grown = (sgp_vertex*)p5__realloc(rec->vertices, capacity * sizeof(sgp_vertex));
+        if (!grown) {
+            printf("[WARNING] p5: out of memory growing recorder (%u vertices)\n", rec->vertex_count);
+            return false;
+        }
+        rec->vertices = grown;
+        rec->vertex_capacity = capacity;
+    }
+    if (rec->run_count == rec->run_capacity) {
+        uint32_t capacity = rec->run_capacity ? rec->run_capacity * 2 : 64;
+        p5__recorder_run_t* grown = (p5__recorder_run_t*)p5__realloc(rec->runs, capacity * sizeof(p5__recorder_run_t));
+        if (!grown) {
+            printf("[WARNING] p5: out of memory growing recorder (%u runs)\n", rec->run_count);
+            return false;
+        }
+        rec->runs = grown;
+        rec->run_capacity = capacity;
+    }
+    return true;
+}
+
+// Append one draw, transformed to canvas coordinates, in the vertex order
+// sgp would have produced for it
+static void p5__recorder_emit(p5_recorder_t* rec, p5_draw_op_t op, const float* xy, int count) {
+    static const uint8_t rect_order[6] = { 3, 2, 1, 0, 3, 1 };  // See sgp_draw_filled_rects
+    uint32_t n = p5__recorder_op_vertices[op];
+    if (!p5__recorder_reserve(rec, n)) return;
+    
+    p5__recorder_run_t* run = rec->run_count ? &rec->runs[rec->run_count - 1] : NULL;
+    if (!run || run->op != op) {
+        run = &rec->runs[rec->run_count++];
+        *run = (p5__recorder_run_t){ op, rec->vertex_count, 0 };
+    }
+    
+    const float (*m)[3] = (const float (*)[3])rec->transform;
+    sgp_vertex* v = rec->vertices + rec->vertex_count;
+    for (uint32_t i = 0; i < n; i++) {
+        int p = op == P5_DRAW_RECT ? rect_order[i] : (int)i;
+        float x = count ? xy[p*2] : 0.0f, y = count ? xy[p*2+1] : 0.0f;
+        v[i].position.x = m[0][0] * x + m[0][1] * y + m[0][2];
+        v[i].position.y = m[1][0] * x + m[1][1] * y + m[1][2];
+        v[i].texcoord = (sgp_vec2){ 0.0f, 0.0f };
+        v[i].color = rec->color;
+    }
+    rec->vertex_count += n;
+    run->count += n;
+}
+
+p5_recorder_t* p5_recorder_create(void) {
+    return (p5_recorder_t*)p5__calloc(1, sizeof(p5_recorder_t));
+}
+
+void p5_recorder_free(p5_recorder_t* recorder) {
+    if (!recorder) return;
+    if (p5_state.recorder == recorder) p5_state.recorder = NULL;
+    p5__free(recorder->vertices);
+    p5__free(recorder->runs);
+    p5__free(recorder);
+}
+
+void p5_recorder_begin(p5_recorder_t* recorder) {
+    if (!recorder) return;
+    if (p5_state.recorder || p5_state.recording) {
+        printf("[WARNING] p5_recorder_begin: already recording (a recorder, command list or incremental frame)\n");
+        return;
+    }
+    recorder->vertex_count = 0;
+    recorder->run_count = 0;
+    recorder->shapes = 0;
+    recorder->shapes_start = p5_state.timing.shapes;
+    recorder->color = (sgp_color_ub4){ 255, 255, 255, 255 };
+    p5_state.recorder = recorder;
+}
+
+void p5_recorder_end(void) {
+    p5_recorder_t* rec = p5_state.recorder;
+    if (!rec) return;
+    // Shapes count as drawn when the recorder is submitted
+    rec->shapes = p5_state.timing.shapes - rec->shapes_start;
+    p5_state.timing.shapes = rec->shapes_start;
+    p5_state.recorder = NULL;
+}
+
+int p5_recorder_vertex_count(const p5_recorder_t* recorder) {
+    return recorder ? (int)recorder->vertex_count : 0;
+}
+
+static inline void p5__recorder_set_color(sgp_color_ub4 c) {
+    sgp_set_color((c.r + 0.5f) / 255.0f, (c.g + 0.5f) / 255.0f, (c.b + 0.5f) / 255.0f, (c.a + 0.5f) / 255.0f);
+}
+
+// Draw by draw through the p5__sgp_* observers, so draw logs, the overdraw
+// heat map and batch diagnostics see what direct drawing would have sent
+static void p5__recorder_draw_observed(const p5_recorder_t* rec) {
+    for (uint32_t r = 0; r < rec->run_count; r++) {
+        const p5__recorder_run_t* run = &rec->runs[r];
+        uint32_t n = p5__recorder_op_vertices[run->op];
+        for (uint32_t i = 0; i < run->count; i += n) {
+            const sgp_vertex* v = rec->vertices + run->first + i;
+            p5__recorder_set_color(v[0].color);
+            switch (run->op) {
+                case P5_DRAW_TRIANGLE:
+                    p5__sgp_triangle(v[0].position.x, v[0].position.y, v[1].position.x, v[1].position.y,
+                                     v[2].position.x, v[2].position.y);
+                    break;
+                case P5_DRAW_RECT: {
+                    // Transformed rects are no longer axis-aligned: two triangles
+                    const float xy[] = { v[3].position.x, v[3].position.y, v[2].position.x, v[2].position.y,
+                                         v[1].position.x, v[1].position.y, v[0].position.x, v[0].position.y };
+                    const sgp_triangle triangles[2] = {
+                        { v[0].position, v[1].position, v[2].position },
+                        { v[3].position, v[4].position, v[5].position },
+                    };
+                    P5__BATCH_DRAW(SG_PRIMITIVETYPE_TRIANGLES, xy, 4);
+                    if (p5_state.draw_log) p5__draw_log(P5_DRAW_RECT, xy, 4);
+                    if (p5_state.overdraw.enabled) p5__overdraw_begin(SG_PRIMITIVETYPE_TRIANGLES, xy, 4);
+                    sgp_draw_filled_triangles(triangles, 2);
+                    if (p5_state.overdraw.enabled) p5__overdraw_end();
+                    break;
+                }
+                case P5_DRAW_LINE:
+                    p5__sgp_line(v[0].position.x, v[0].position.y, v[1].position.x, v[1].position.y);
+                    break;
+                case P5_DRAW_POINT:
+                    p5__sgp_point(v[0].position.x, v[0].position.y);
+                    break;
+                case P5_DRAW_CLEAR:
+                    p5__sgp_clear();
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// One sgp_draw per recorded draw, as direct drawing issues them: the
+// vertices are already tessellated and colored, and sgp still culls draws
+// outside the viewport and merges neighbouring draws into few commands
+static void p5__recorder_draw(const p5_recorder_t* rec) {
+    for (uint32_t r = 0; r < rec->run_count; r++) {
+        const p5__recorder_run_t* run = &rec->runs[r];
+        const sgp_vertex* v = rec->vertices + run->first;
+        if (run->op == P5_DRAW_CLEAR) {
+            for (uint32_t i = 0; i < run->count; i++) {
+                p5__recorder_set_color(v[i].color);
+                sgp_clear();
+            }
+            continue;
+        }
+        sg_primitive_type primitive = run->op == P5_DRAW_LINE ? SG_PRIMITIVETYPE_LINES :
+                                      run->op == P5_DRAW_POINT ? SG_PRIMITIVETYPE_POINTS :
+                                      SG_PRIMITIVETYPE_TRIANGLES;
+        uint32_t n = p5__recorder_op_vertices[run->op];
+        for (uint32_t i = 0; i < run->count; i += n) sgp_draw(primitive, v + i, n);
+    }
+}
+
+void p5_recorder_submit(const p5_recorder_t* recorder) {
+    if (!recorder || recorder->vertex_count == 0) return;
+    if (p5_state.recorder) {
+        printf("[WARNING] p5_recorder_submit: cannot submit while a recorder is active\n");
+        return;
+    }
+    P5__FLUSH_SHAPES();
+    
+    p5_state.timing.shapes += recorder->shapes;
+    bool observed = p5_state.draw_log || p5_state.overdraw.enabled;
+#ifdef P5_BATCH_DIAGNOSTICS
+    observed = observed || p5_state.batch.enabled;
+#endif
+    p5__apply_transform();
+    if (observed) {
+        p5__recorder_draw_observed(recorder);
+    } else {
+        p5__recorder_draw(recorder);
+    }
+    p5__restore_transform();
+}
+
+// Pipelined frame functions
+static P5__THREAD_FN(p5__pipeline_thread) {
+    p5__pipeline_t* pl = (p5__pipeline_t*)arg;
+    p5_context_make_current(pl->context);
+    p5__mutex_lock(&pl->lock);
+    for (;;) {
+        while (!pl->busy && !pl->stop) p5__cond_wait(&pl->cond, &pl->lock);
+        if (pl->stop) break;
+        p5__mutex_unlock(&pl->lock);
+        
+        p5__alloc_frame(true);
+        p5_run_coroutines();
+        p5_recorder_begin(pl->recorders[pl->recording]);
+        pl->draw_fn();
+        p5_recorder_end();
+        
+        p5__mutex_lock(&pl->lock);
+        pl->busy = false;
+        p5__cond_broadcast(&pl->cond);
+    }
+    p5__mutex_unlock(&pl->lock);
+    return P5__THREAD_RETURN;
+}
+
+static bool p5__pipeline_start(p5__pipeline_t* pl) {
+    pl->context = p5_context_create();
+    pl->recorders[0] = p5_recorder_create();
+    pl->recorders[1] = p5_recorder_create();
+    pl->presented = -1;
+    pl->recording = -1;
+    pl->busy = false;
+    pl->stop = false;
+    if (!pl->context || !pl->recorders[0] || !pl->recorders[1]) return false;
+    // The sketch's context picks up where the calling one is
+    pl->context->state.canvas = p5_state.canvas;
+    pl->context->state.looping = p5_state.looping;
+    pl->looping = p5_state.looping;
+    
+    p5__mutex_init(&pl->lock);
+    p5__cond_init(&pl->cond);
+    if (!p5__thread_start(&pl->thread, p5__pipeline_thread, pl)) {
+        p5__cond_destroy(&pl->cond);
+        p5__mutex_destroy(&pl->lock);
+        return false;
+    }
+    pl->running = true;
+    return true;
+}
+
+// Wait until the worker is idle; its context may then be used here
+static void p5__pipeline_wait(p5__pipeline_t* pl) {
+    p5__mutex_lock(&pl->lock);
+    while (pl->busy) p5__cond_wait(&pl->cond, &pl->lock);
+    p5__mutex_unlock(&pl->lock);
+}
+
+static void p5__pipeline_stop(p5__pipeline_t* pl) {
+    if (pl->running) {
+        p5__mutex_lock(&pl->lock);
+        while (pl->busy) p5__cond_wait(&pl->cond, &pl->lock);
+        pl->stop = true;
+        p5__cond_broadcast(&pl->cond);
+        p5__mutex_unlock(&pl->lock);
+        p5__thread_join(pl->thread);
+        p5__cond_destroy(&pl->cond);
+        p5__mutex_destroy(&pl->lock);
+        p5_state.canvas = pl->context->state.canvas;
+        p5_state.looping = pl->context->state.looping;
+    }
+    p5_recorder_free(pl->recorders[0]);
+    p5_recorder_free(pl->recorders[1]);
+    p5_context_destroy(pl->context);
+    *pl = (p5__pipeline_t){ .enabled = pl->enabled };
+}
+
+// Hand the next frame to the worker, unless the sketch is not looping
+static void p5__pipeline_kick(p5__pipeline_t* pl, void (*draw_fn)(void)) {
+    p5_state_t* sketch = &pl->context->state;
+    if (!sketch->looping && !sketch->redraw_pending && !p5_state.redraw_pending && pl->presented >= 0) return;
+    sketch->redraw_pending = false;
+    p5_state.redraw_pending = false;
+    
+    // The worker sees this frame's delta time and frame rate, and the count
+    // of the frame it draws for
+    sketch->timing = p5_state.timing;
+    if (pl->presented >= 0) sketch->timing.frame_count++;
+    pl->recording = pl->presented == 0 ? 1 : 0;
+    pl->draw_start[pl->recording] = p5__now_ns();
+    pl->draw_fn = draw_fn;
+    p5__mutex_lock(&pl->lock);
+    pl->busy = true;
+    p5__cond_broadcast(&pl->cond);
+    p5__mutex_unlock(&pl->lock);
+}
+
+// Wait for the frame to present; the first frame is recorded now
+static void p5__pipeline_collect(void (*draw_fn)(void)) {
+    p5__pipeline_t* pl = &p5_state.pipeline;
+    if (!pl->running && !p5__pipeline_start(pl)) {
+        printf("[WARNING] p5_pipelined: cannot start the draw thread, frames stay serial\n");
+        p5__pipeline_stop(pl);
+        pl->enabled = false;
+        return;
+    }
+    if (pl->presented < 0 && pl->recording < 0) p5__pipeline_kick(pl, draw_fn);
+    p5__pipeline_wait(pl);
+    if (pl->recording >= 0) {
+        pl->presented = pl->recording;
+        pl->recording = -1;
+    }
+    
+    // Settings the sketch changed while drawing apply from this frame on;
+    // loop()/noLoop() from event handlers on this thread reach the sketch
+    p5_state_t* sketch = &pl->context->state;
+    p5_state.canvas = sketch->canvas;
+    if (p5_state.looping != pl->looping) sketch->looping = p5_state.looping;
+    p5_state.looping = pl->looping = sketch->looping;
+    p5_state.timing.target_fps = sketch->timing.target_fps;
+    p5_state.timing.draw_start = pl->draw_start[pl->presented];
+}
+
+// Start the next frame's recording, then draw the collected one
+static void p5__pipeline_submit(void (*draw_fn)(void)) {
+    p5__pipeline_t* pl = &p5_state.pipeline;
+    if (!pl->running) {
+        draw_fn();  // The pipeline could not start
+        return;
+    }
+    p5__pipeline_kick(pl, draw_fn);
+    p5_recorder_submit(pl->recorders[pl->presented]);
+}
+
+void p5_pipelined(bool enabled) {
+    p5__pipeline_t* pl = &p5_state.pipeline;
+    if (p5_state.recorder) {
+        printf("[WARNING] p5_pipelined: cannot change while recording\n");
+        return;
+    }
+    if (!enabled) p5__pipeline_stop(pl);
+    pl->enabled = enabled;
+}
+
+bool p5_is_pipelined(void) {
+    return p5_state.pipeline.enabled;
+}
+
+void p5_pipeline_draw(void (*draw_fn)(void)) {
+    if (!draw_fn) return;
+    if (!p5_state.pipeline.enabled) {
+        draw_fn();
+        return;
+    }
+    p5__pipeline_collect(draw_fn);
+    p5__pipeline_submit(draw_fn);
+}
+
+// Parallel functions
+static p5__pool_t p5__pool;
+static P5__THREAD_LOCAL int p5__worker_index = -1;  // Queue of the calling worker thread
+
+static int p5__cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+// Wake one sleeping thread for new work, or all of them for a finished group
+static void p5__pool_wake(bool all) {
+    p5__pool_t* pool = &p5__pool;
+    if (P5__ATOMIC_ADD(&pool->sleeping, 0) == 0) return;
+    p5__mutex_lock(&pool->lock);
+    if (all) {
+        p5__cond_broadcast(&pool->cond);
+    } else {
+        p5__cond_signal(&pool->cond);
+    }
+    p5__mutex_unlock(&pool->lock);
+}
+
+// Queue a job on the calling worker's queue (other threads share the last
+// one); false when that queue is full
+static bool p5__pool_push(const p5__job_t* job) {
+    p5__pool_t* pool = &p5__pool;
+    int index = p5__worker_index >= 0 ? p5__worker_index : pool->queue_count - 1;
+    p5__job_queue_t* q = &pool->queues[index];
+    p5__mutex_lock(&q->lock);
+    bool full = q->bottom - q->top == P5__POOL_QUEUE;
+    if (!full) q->jobs[q->bottom++ & (P5__POOL_QUEUE - 1)] = *job;
+    p5__mutex_unlock(&q->lock);
+    if (full) return false;
+    P5__ATOMIC_ADD(&pool->pending, 1);
+    p5__pool_wake(false);
+    return true;
+}
+
+// Newest job of the calling worker's own queue, else the oldest of another
+static bool p5__pool_take(p5__job_t* job) {
+    p5__pool_t* pool = &p5__pool;
+    if (P5__ATOMIC_LOAD(&pool->pending) == 0) return false;
+    int self = p5__worker_index;
+    for (int i = 0; i < pool->queue_count; i++) {
+        int index = (self + pool->queue_count + i) % pool->queue_count;
+        p5__job_queue_t* q = &pool->queues[index];
+        p5__mutex_lock(&q->lock);
+        bool found = q->top != q->bottom;
+        if (found && index == self) {
+            *job = q->jobs[--q->bottom & (P5__POOL_QUEUE - 1)];
+        } else if (found) {
+            *job = q->jobs[q->top++ & (P5__POOL_QUEUE - 1)];
+        }
+        p5__mutex_unlock(&q->lock);
+        if (found) {
+            P5__ATOMIC_ADD(&pool->pending, -1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void p5__pool_complete(uint32_t* remaining, uint32_t count) {
+    // The group may be freed by its waiter as soon as it reaches zero
+    if (P5__ATOMIC_ADD(remaining, (uint32_t)0 - count) == 0) p5__pool_wake(true);
+}
+
+static void p5__job_run(p5__job_t* job) {
+    if (!job->range_fn) {
+        job->task_fn(job->ctx);
+        p5__pool_complete(job->remaining, 1);
+        return;
+    }
+    // Leave the upper half of the range for thieves until it fits the grain
+    while (job->end - job->begin > job->grain) {
+        p5__job_t upper = *job;
+        upper.begin = job->begin + (job->end - job->begin) / 2;
+        if (!p5__pool_push(&upper)) break;
+        job->end = upper.begin;
+    }
+    job->range_fn(job->begin, job->end, job->ctx);
+    p5__pool_complete(job->remaining, (uint32_t)(job->end - job->begin));
+}
+
+// Run queued jobs until the group is done, sleeping while there are none
+static void p5__pool_wait(uint32_t* remaining) {
+    p5__pool_t* pool = &p5__pool;
+    p5__job_t job;
+    while (P5__ATOMIC_LOAD(remaining) > 0) {
+        if (p5__pool_take(&job)) {
+            p5__job_run(&job);
+            continue;
+        }
+        p5__mutex_lock(&pool->lock);
+        P5__ATOMIC_ADD(&pool->sleeping, 1);
+        while (P5__ATOMIC_ADD(remaining, 0) > 0 && P5__ATOMIC_ADD(&pool->pending, 0) == 0) {
+            p5__cond_wait(&pool->cond, &pool->lock);
+        }
+        P5__ATOMIC_ADD(&pool->sleeping, -1);
+        p5__mutex_unlock(&pool->lock);
+    }
+}
+
+static P5__THREAD_FN(p5__pool_thread) {
+    p5__pool_t* pool = &p5__pool;
+    p5__worker_index = (int)(intptr_t)arg;
+    p5__job_t job;
+    for (;;) {
+        if (p5__pool_take(&job)) {
+            p5__job_run(&job);
+            continue;
+        }
+        p5__mutex_lock(&pool->lock);
+        P5__ATOMIC_ADD(&pool->sleeping, 1);
+        while (P5__ATOMIC_ADD(&pool->pending, 0) == 0 && !pool->stop) {
+            p5__cond_wait(&pool->cond, &pool->lock);
+        }
+        P5__ATOMIC_ADD(&pool->sleeping, -1);
+        bool stop = pool->stop && P5__ATOMIC_LOAD(&pool->pending) == 0;
+        p5__mutex_unlock(&pool->lock);
+        if (stop) break;
+    }
+    return P5__THREAD_RETURN;
+}
+
+// Start the pool on first use; threads that race here wait for the winner
+static p5__pool_t* p5__pool_get(void) {
+    p5__pool_t* pool = &p5__pool;
+    if (P5__ATOMIC_LOAD(&pool->started)) return pool;
+    while (P5__ATOMIC_ADD(&pool->starting, 1) != 1) {
+        P5__ATOMIC_ADD(&pool->starting, -1);
+        if (P5__ATOMIC_LOAD(&pool->started)) return pool;
+    }
+    if (!P5__ATOMIC_LOAD(&pool->started)) {
+        int count = pool->requested > 0 ? pool->requested : p5__cpu_count() - 1;
+        if (count < 1) count = 1;
+        if (count > P5__POOL_MAX_WORKERS) count = P5__POOL_MAX_WORKERS;
+        pool->queues = (p5__job_queue_t*)P5_MALLOC((size_t)(count + 1) * sizeof(p5__job_queue_t));
+        if (pool->queues) {
+            pool->queue_count = count + 1;
+            for (int i = 0; i < pool->queue_count; i++) {
+                pool->queues[i].top = pool->queues[i].bottom = 0;
+                p5__mutex_init(&pool->queues[i].lock);
+            }
+            p5__mutex_init(&pool->lock);
+            p5__cond_init(&pool->cond);
+            pool->stop = false;
+            while (pool->thread_count < count &&
+                   p5__thread_start(&pool->threads[pool->thread_count], p5__pool_thread,
+                                    (void*)(intptr_t)pool->thread_count)) {
+                pool->thread_count++;
+            }
+        }
+        if (pool->thread_count == 0) {
+            printf("[WARNING] p5 worker pool: cannot start threads, parallel work runs on the calling thread\n");
+        }
+        P5__ATOMIC_STORE(&pool->started, 1u);
+    }
+    P5__ATOMIC_ADD(&pool->starting, -1);
+    return pool;
+}
+
+// Finish queued work and join the workers; the next use starts a new pool
+static void p5__pool_stop(void) {
+    p5__pool_t* pool = &p5__pool;
+    if (!P5__ATOMIC_LOAD(&pool->started)) return;
+    if (pool->queues) {
+        p5__mutex_lock(&pool->lock);
+        pool->stop = true;
+        p5__cond_broadcast(&pool->cond);
+        p5__mutex_unlock(&pool->lock);
+        for (int i = 0; i < pool->thread_count; i++) p5__thread_join(pool->threads[i]);
+        
+        // Without workers, queued tasks were never picked up
+        p5__job_t job;
+        while (p5__pool_take(&job)) p5__job_run(&job);
+        for (int i = 0; i < pool->queue_count; i++) p5__mutex_destroy(&pool->queues[i].lock);
+        p5__cond_destroy(&pool->cond);
+        p5__mutex_destroy(&pool->lock);
+        P5_FREE(pool->queues);
+    }
+    int requested = pool->requested;
+    memset(pool, 0, sizeof(*pool));
+    pool->requested = requested;
+}
+
+void p5_parallel_for(int begin, int end, int grain, void (*fn)(int begin, int end, void* ctx), void* ctx) {
+    if (!fn || end <= begin) return;
+    p5__pool_t* pool = p5__pool_get();
+    if (grain <= 0) {
+        // A few slices per thread, so early finishers can steal
+        grain = (end - begin) / ((pool->thread_count + 1) * 4);
+        if (grain < 1) grain = 1;
+    }
+    if (pool->thread_count == 0 || end - begin <= grain) {
+        fn(begin, end, ctx);
+        return;
+    }
+    uint32_t remaining = (uint32_t)(end - begin);
+    p5__job_t job = { fn, NULL, ctx, begin, end, grain, &remaining };
+    p5__job_run(&job);
+    p5__pool_wait(&remaining);
+}
+
+p5_task_t* p5_async(void (*fn)(void* ctx), void* ctx) {
+    if (!fn) return NULL;
+    p5__pool_t* pool = p5__pool_get();
+    p5_task_t* task = (p5_task_t*)p5__malloc(sizeof(p5_task_t));
+    if (!task) {
+        printf("[WARNING] p5_async: out of memory, running the task now\n");
+        fn(ctx);
+        return NULL;
+    }
+    task->remaining = 1;
+    p5__job_t job = { NULL, fn, ctx, 0, 0, 0, &task->remaining };
+    if (pool->thread_count == 0 || !p5__pool_push(&job)) p5__job_run(&job);
+    return task;
+}
+
+bool p5_task_done(const p5_task_t* task) {
+    return !task || P5__ATOMIC_LOAD(&task->remaining) == 0;
+}
+
+void p5_task_wait(p5_task_t* task) {
+    if (!task) return;
+    p5__pool_wait(&task->remaining);
+    p5__free(task);
+}
+
+void p5_worker_threads(int count) {
+    p5__pool_stop();
+    p5__pool.requested = count > 0 ? count : 0;
+}
+
+int p5_worker_thread_count(void) {
+    return P5__ATOMIC_LOAD(&p5__pool.started) ? p5__pool.thread_count : 0;
+}
+
+// Shape batching functions
+static void p5__shape_batch_add(p5__cmd_op_t op, const float* args, int count) {
+    p5__shape_batch_t* b = &p5_state.shape_batch;
+    if (b->count == b->capacity) {
+        int capacity = b->capacity ? b->capacity * 2 : 1024;
+        p5__batched_shape_t* grown = (p5__batched_shape_t*)p5__realloc(b->shapes, capacity * sizeof(p5__batched_shape_t));
+        if (!grown) {
+            printf("[WARNING] p5: out of memory growing the shape batch (%d shapes)\n", b->count);
+            return;
+        }
+        b->shapes = grown;
+        b->capacity = capacity;
+    }
+    p5__batched_shape_t* shape = &b->shapes[b->count++];
+    shape->op = (uint8_t)op;
+    shape->fill_enabled = p5_state.fill_enabled;
+    shape->stroke_enabled = p5_state.stroke_enabled;
+    shape->fill_color = p5__color_ub4(p5_state.fill_color);
+    shape->stroke_color = p5__color_ub4(p5_state.stroke_color);
+    shape->stroke_width = p5_state.stroke_width;
+    shape->transform = p5_state.transform;
+    memcpy(shape->args, args, count * sizeof(float));
+}
+
+// Colors that p5__color_ub4() turns back into the stored bytes
+static inline p5_color_t p5__color_from_ub4(sgp_color_ub4 c) {
+    return (p5_color_t){ (c.r + 0.5f) / 255.0f, (c.g + 0.5f) / 255.0f, (c.b + 0.5f) / 255.0f, (c.a + 0.5f) / 255.0f };
+}
+
+typedef struct {
+    const p5__shape_batch_t* batch;
+    int count;
+    int chunks;
+} p5__shape_flush_t;
+
+// Tessellate chunks [begin, end) of the batch, each in its own context
+static void p5__shape_batch_tessellate(int begin, int end, void* ctx) {
+    const p5__shape_flush_t* flush = (const p5__shape_flush_t*)ctx;
+    p5_context_t* previous = p5_context_current();
+    for (int c = begin; c < end; c++) {
+        int first = (int)((int64_t)flush->count * c / flush->chunks);
+        int last = (int)((int64_t)flush->count * (c + 1) / flush->chunks);
+        p5_context_make_current(flush->batch->contexts[c]);
+        p5_recorder_begin(flush->batch->recorders[c]);
+        for (int i = first; i < last; i++) {
+            const p5__batched_shape_t* shape = &flush->batch->shapes[i];
+            p5_state.fill_enabled = shape->fill_enabled;
+            p5_state.stroke_enabled = shape->stroke_enabled;
+            p5_state.fill_color = p5__color_from_ub4(shape->fill_color);
+            p5_state.stroke_color = p5__color_from_ub4(shape->stroke_color);
+            p5_state.stroke_width = shape->stroke_width;
+            p5_state.transform = shape->transform;
+            p5__shape_draw((p5__cmd_op_t)shape->op, shape->args);
+        }
+        p5_recorder_end();
+    }
+    p5_context_make_current(previous);
+}
+
+void p5_flush_shapes(void) {
+    p5__shape_batch_t* b = &p5_state.shape_batch;
+    int count = b->count;
+    if (count == 0) return;
+    b->count = 0;  // Drawing the chunks below must not flush again
+    
+    // A few chunks per thread, so threads that finish early can steal
+    int threads = p5__pool_get()->thread_count + 1;
+    int chunks = count / P5__SHAPE_CHUNK_MIN;
+    if (chunks > threads * 4) chunks = threads * 4;
+    if (chunks > P5__SHAPE_MAX_CHUNKS) chunks = P5__SHAPE_MAX_CHUNKS;
+    if (chunks < 1) chunks = 1;
+    while (b->chunk_count < chunks) {
+        p5_context_t* context = p5_context_create();
+        p5_recorder_t* recorder = p5_recorder_create();
+        if (!context || !recorder) {
+            p5_context_destroy(context);
+            p5_recorder_free(recorder);
+            break;
+        }
+        b->contexts[b->chunk_count] = context;
+        b->recorders[b->chunk_count++] = recorder;
+    }
+    if (b->chunk_count == 0) {
+        printf("[WARNING] p5_flush_shapes: out of memory, %d shapes not drawn\n", count);
+        return;
+    }
+    if (chunks > b->chunk_count) chunks = b->chunk_count;
+    
+    p5__shape_flush_t flush = { b, count, chunks };
+    p5_parallel_for(0, chunks, 1, p5__shape_batch_tessellate, &flush);
+    
+    // The vertices are in canvas coordinates already
+    p5_transform_t transform = p5_state.transform;
+    p5_state.transform = (p5_transform_t){ 0.0f, 0.0f, 0.0f, 1.0f, 1.0f };
+    for (int c = 0; c < chunks; c++) p5_recorder_submit(b->recorders[c]);
+    p5_state.transform = transform;
+}
+
+void p5_shape_batching(bool enabled) {
+    if (!enabled) p5_flush_shapes();
+    p5_state.shape_batch.enabled = enabled;
+}
+
+bool p5_is_shape_batching(void) {
+    return p5_state.shape_batch.enabled;
+}
+
+int p5_batched_shape_count(void) {
+    return p5_state.shape_batch.count;
+}
+
+static void p5__shape_batch_free(void) {
+    p5__shape_batch_t* b = &p5_state.shape_batch;
+    for (int c = 0; c < b->chunk_count; c++) {
+        p5_context_destroy(b->contexts[c]);
+        p5_recorder_free(b->recorders[c]);
+    }
+    p5__free(b->shapes);
+    *b = (p5__shape_batch_t){0};
+}
+
+// Fixed-timestep update functions
+static void p5__update_step(p5__fixed_update_t* fu, uint64_t time) {
+    // Any slot neither published last nor read by draw()
+    p5__mutex_lock(&fu->lock);
+    int slot = 0;
+    while (slot == fu->latest || slot == fu->previous || slot == fu->reading[0] || slot == fu->reading[1]) slot++;
+    p5__mutex_unlock(&fu->lock);
+    
+    // Only this thread writes, so the latest state cannot change meanwhile
+    uint8_t* state = fu->states + (size_t)slot * fu->state_size;
+    memcpy(state, fu->states + (size_t)fu->latest * fu->state_size, fu->state_size);
+    fu->update_fn(state, (float)(fu->step_ns * 1e-9));
+    
+    p5__mutex_lock(&fu->lock);
+    fu->previous = fu->latest;
+    fu->latest = slot;
+    fu->times[slot] = time;
+    fu->steps++;
+    p5__mutex_unlock(&fu->lock);
+}
+
+// Run the steps due by now, dropping time beyond P5_UPDATE_MAX_CATCHUP steps
+static void p5__update_advance(p5__fixed_update_t* fu, uint64_t now) {
+    int steps = 0;
+    while (fu->next_step <= now && steps < P5_UPDATE_MAX_CATCHUP && !P5__ATOMIC_LOAD(&fu->stop)) {
+        p5__update_step(fu, fu->next_step);
+        fu->next_step += fu->step_ns;
+        steps++;
+    }
+    if (fu->next_step <= now) fu->next_step = now + fu->step_ns;
+}
+
+static P5__THREAD_FN(p5__update_thread) {
+    p5__fixed_update_t* fu = (p5__fixed_update_t*)arg;
+    while (!P5__ATOMIC_LOAD(&fu->stop)) {
+        // Sleep in short slices so stopping never waits for a slow rate. Steps
+        // may start a little late: they keep their scheduled time for blending, and
+        // spinning to the deadline would keep a core busy at every step
+        uint64_t now = p5__now_ns();
+        if (now < fu->next_step) {
+            uint64_t wait = fu->next_step - now;
+            p5__sleep_ns(wait < 10000000u ? wait : 10000000u);
+            continue;
+        }
+        p5__update_advance(fu, now);
+    }
+    return P5__THREAD_RETURN;
+}
+
+bool p5_fixed_update(void (*update_fn)(void* state, float dt), const void* initial_state, size_t state_size, float hz) {
+    p5_fixed_update_stop();
+    if (!update_fn || !initial_state || state_size == 0 || !(hz > 0.0f)) {
+        printf("[WARNING] p5_fixed_update: needs an update function, a state and a positive rate\n");
+        return false;
+    }
+    p5__fixed_update_t* fu = &p5_state.fixed_update;
+    fu->states = (uint8_t*)p5__malloc(P5__UPDATE_SLOTS * state_size);
+    if (!fu->states) {
+        printf("[WARNING] p5_fixed_update: out of memory for %d copies of %zu bytes\n", P5__UPDATE_SLOTS, state_size);
+        return false;
+    }
+    memcpy(fu->states, initial_state, state_size);
+    fu->update_fn = update_fn;
+    fu->state_size = state_size;
+    fu->step_ns = (uint64_t)(1e9 / hz);
+    if (fu->step_ns == 0) fu->step_ns = 1;
+    fu->latest = fu->previous = 0;
+    fu->reading[0] = fu->reading[1] = -1;
+    fu->steps = 0;
+    fu->times[0] = p5__now_ns();
+    fu->next_step = fu->times[0] + fu->step_ns;
+    fu->stop = 0;
+    p5__mutex_init(&fu->lock);
+    fu->threaded = p5__thread_start(&fu->thread, p5__update_thread, fu);
+    if (!fu->threaded) {
+        printf("[WARNING] p5_fixed_update: cannot start a thread, steps run in p5_update_states()\n");
+    }
+    fu->running = true;
+    return true;
+}
+
+void p5_fixed_update_stop(void) {
+    p5__fixed_update_t* fu = &p5_state.fixed_update;
+    if (!fu->running) return;
+    if (fu->threaded) {
+        P5__ATOMIC_STORE(&fu->stop, 1u);
+        p5__thread_join(fu->thread);
+    }
+    p5__mutex_destroy(&fu->lock);
+    p5__free(fu->states);
+    *fu = (p5__fixed_update_t){0};
+}
+
+float p5_update_states(const void** previous, const void** current) {
+    p5__fixed_update_t* fu = &p5_state.fixed_update;
+    if (!fu->running) {
+        if (previous) *previous = NULL;
+        if (current) *current = NULL;
+        return 0.0f;
+    }
+    uint64_t now = p5__now_ns();
+    if (!fu->threaded) p5__update_advance(fu, now);
+    
+    p5__mutex_lock(&fu->lock);
+    fu->reading[0] = fu->previous;
+    fu->reading[1] = fu->latest;
+    uint64_t time = fu->times[fu->latest];
+    p5__mutex_unlock(&fu->lock);
+    
+    if (previous) *previous = fu->states + (size_t)fu->reading[0] * fu->state_size;
+    if (current) *current = fu->states + (size_t)fu->reading[1] * fu->state_size;
+    // The current state is shown one step after its time, blended in from the previous one
+    float alpha = now > time ? (float)((double)(now - time) / (double)fu->step_ns) : 0.0f;
+    return alpha < 1.0f ? alpha : 1.0f;
+}
+
+uint64_t p5_update_step_count(void) {
+    p5__fixed_update_t* fu = &p5_state.fixed_update;
+    if (!fu->running) return 0;
+    p5__mutex_lock(&fu->lock);
+    uint64_t steps = fu->steps;
+    p5__mutex_unlock(&fu->lock);
+    return steps;
+}
+
+// Coroutine functions
+p5_coroutine_t* p5_coroutine_start(bool (*step_fn)(void* ctx), void* ctx) {
+    if (!step_fn) return NULL;
+    p5_coroutine_t* co = (p5_coroutine_t*)p5__malloc(sizeof(p5_coroutine_t));
+    if (!co) {
+        printf("[WARNING] p5_coroutine_start: out of memory\n");
+        return NULL;
+    }
+    *co = (p5_coroutine_t){ .step_fn = step_fn, .ctx = ctx, .owner = &p5_state.coroutines };
+    p5_coroutine_t** link = &p5_state.coroutines.pending;
+    while (*link) link = &(*link)->next;
+    *link = co;
+    return co;
+}
+
+bool p5_coroutine_done(const p5_coroutine_t* coroutine) {
+    return !coroutine || coroutine->done;
+}
+
+static void p5__coroutine_unlink(p5_coroutine_t* co) {
+    if (!co->owner) return;
+    for (p5_coroutine_t** link = &co->owner->pending; *link; link = &(*link)->next) {
+        if (*link == co) {
+            *link = co->next;
+            co->owner->unlinked = true;
+            break;
+        }
+    }
+    co->next = NULL;
+}
+
+static bool p5__coroutine_step(p5_coroutine_t* co) {
+    co->stepping = true;
+    bool more = co->step_fn(co->ctx);
+    co->stepping = false;
+    return more;
+}
+
+// Run the remaining steps, unless one of them cancels the coroutine
+static void p5__coroutine_finish_steps(p5_coroutine_t* co) {
+    // No budget: each step may do as much as it likes
+    uint64_t deadline = p5_state.coroutines.deadline;
+    p5_state.coroutines.deadline = 0;
+    while (p5__coroutine_step(co) && !(co->released && !co->finish)) {}
+    p5_state.coroutines.deadline = deadline;
+}
+
+// Free a coroutine released during its own step, now that the step returned
+static void p5__coroutine_release(p5_coroutine_t* co, bool more) {
+    co->released = false;
+    if (more && co->finish) p5__coroutine_finish_steps(co);
+    p5__free(co);
+}
+
+// A coroutine finished or cancelled from its own step is only marked, and
+// freed once that step returns
+void p5_coroutine_finish(p5_coroutine_t* coroutine) {
+    if (!coroutine) return;
+    if (coroutine->stepping) {
+        coroutine->released = true;
+        coroutine->finish = true;
+        return;
+    }
+    if (!coroutine->done) {
+        p5__coroutine_unlink(coroutine);
+        p5__coroutine_finish_steps(coroutine);
+    }
+    p5__free(coroutine);
+}
+
+void p5_coroutine_cancel(p5_coroutine_t* coroutine) {
+    if (!coroutine) return;
+    if (coroutine->stepping) {
+        coroutine->released = true;
+        coroutine->finish = false;
+        return;
+    }
+    if (!coroutine->done) p5__coroutine_unlink(coroutine);
+    p5__free(coroutine);
+}
+
+bool p5_coroutine_should_yield(void) {
+    uint64_t deadline = p5_state.coroutines.deadline;
+    return deadline != 0 && p5__now_ns() >= deadline;
+}
+
+void p5_coroutine_budget_ms(float ms) {
+    p5_state.coroutines.budget_ms = ms > 0.0f ? ms : 0.0f;
+}
+
+int p5_run_coroutines(void) {
+    p5__coroutines_t* cs = &p5_state.coroutines;
+    if (!cs->pending || cs->deadline) return 0;  // Nothing to do, or called from a step
+    double budget_ms = cs->budget_ms > 0.0f ? cs->budget_ms : P5_COROUTINE_BUDGET_MS;
+    cs->deadline = p5__now_ns() + (uint64_t)(budget_ms * 1e6);
+    
+    // One step of each pending coroutine per pass
+    int steps = 0;
+    bool out_of_time = false;
+    while (cs->pending && !out_of_time) {
+        p5_coroutine_t** link = &cs->pending;
+        while (*link) {
+            p5_coroutine_t* co = *link;
+            cs->unlinked = false;
+            bool more = p5__coroutine_step(co);
+            steps++;
+            // The step may have removed others from the list, or shut the context down
+            if (cs->unlinked || co->owner != cs) {
+                link = &cs->pending;
+                while (*link && *link != co) link = &(*link)->next;
+            }
+            if (*link != co) {
+                // Detached by p5_shutdown(): the handle stays valid unless released
+                co->done = !more;
+                if (co->released) p5__coroutine_release(co, more);
+            } else if (more && !co->released) {
+                link = &co->next;
+            } else {
+                co->done = true;
+                *link = co->next;
+                co->next = NULL;
+                if (co->released) p5__coroutine_release(co, more);
+            }
+            out_of_time = p5__now_ns() >= cs->deadline;
+            if (out_of_time) break;
+        }
+        // Whoever did not get a turn this frame goes first next frame
+        if (out_of_time && *link && link != &cs->pending) {
+            p5_coroutine_t* first = *link;
+            *link = NULL;
+            p5_coroutine_t* last = first;
+            while (last->next) last = last->next;
+            last->next = cs->pending;
+            cs->pending = first;
+        }
+    }
+    cs->deadline = 0;
+    return steps;
+}
+
+// Frame capture functions
+static void p5__capture_style(p5_capture_style_t* s) {
+    const p5_transform_t* t = &p5_state.transform;
+    const p5_color_t f = p5_state.fill_color, k = p5_state.stroke_color;
+    *s = (p5_capture_style_t){
+        { f.r, f.g, f.b, f.a }, { k.r, k.g, k.b, k.a }, p5_state.stroke_width,
+        { t->tx, t->ty, t->rot, t->sx, t->sy },
+        (p5_state.fill_enabled ? P5_CAPTURE_FILL : 0u) | (p5_state.stroke_enabled ? P5_CAPTURE_STROKE : 0u)
+    };
+}
+
+bool p5_capture_begin(const char* path, int frames) {
+    if (p5_state.capture_file) {
+        printf("[WARNING] p5_capture_begin: a capture is already in progress\n");
+        return false;
+    }
+    
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("[WARNING] p5_capture_begin: cannot open %s\n", path);
+        return false;
+    }
+    
+    p5_capture_header_t header = { {'P', '5', 'C', 'F'}, P5_CAPTURE_VERSION, 0, 0 };
+    fwrite(&header, sizeof(header), 1, file);
+    
+    p5_state.capture_file = file;
+    p5_state.capture_frames_left = frames;
+    p5_state.capture_frame_count = 0;
+    p5_state.capture.size = 0;
+    p5__capture_style(&p5_state.capture_style);
+    return true;
+}
+
+void p5_capture_frame(void) {
+    if (!p5_state.capture_file) return;
+    
+    p5_capture_frame_t frame = {
+        (uint32_t)p5_state.capture.size, p5_width(), p5_height(), 0, p5_state.capture_style
+    };
+    fwrite(&frame, sizeof(frame), 1, p5_state.capture_file);
+    if (p5_state.capture.size > 0) {
+        static const uint8_t padding[4] = {0};
+        fwrite(p5_state.capture.data, 1, p5_state.capture.size, p5_state.capture_file);
+        fwrite(padding, 1, P5_CAPTURE_PADDED_SIZE(frame.size) - frame.size, p5_state.capture_file);
+    }
+    p5_state.capture.size = 0;
+    p5_state.capture_frame_count++;
+    p5__capture_style(&p5_state.capture_style);
+    
+    if (p5_state.capture_frames_left > 0 && --p5_state.capture_frames_left == 0) {
+        p5_capture_end();
+    }
+}
+
+void p5_capture_end(void) {
+    if (!p5_state.capture_file) return;
+    
+    // Patch the frame count now that it is known
+    fseek(p5_state.capture_file, offsetof(p5_capture_header_t, frame_count), SEEK_SET);
+    fwrite(&p5_state.capture_frame_count, sizeof(uint32_t), 1, p5_state.capture_file);
+    fclose(p5_state.capture_file);
+    p5_state.capture_file = NULL;
+    
+    p5__free(p5_state.capture.data);
+    p5_state.capture = (p5_cmdlist_t){0};
+}
+
+bool p5_capture_active(void) {
+    return p5_state.capture_file != NULL;
+}
+
+void p5_capture_replay(const p5_capture_frame_t* frame) {
+    const p5_capture_style_t* s = &frame->style;
+    p5__style_save(P5__STYLE_FILL);
+    p5__style_save(P5__STYLE_STROKE);
+    p5__style_save(P5__STYLE_STROKE_WEIGHT);
+    p5__style_save(P5__STYLE_TRANSFORM);
+    p5_state.fill_color = (p5_color_t){ s->fill[0], s->fill[1], s->fill[2], s->fill[3] };
+    p5_state.stroke_color = (p5_color_t){ s->stroke[0], s->stroke[1], s->stroke[2], s->stroke[3] };
+    p5_state.fill_enabled = (s->flags & P5_CAPTURE_FILL) != 0;
+    p5_state.stroke_enabled = (s->flags & P5_CAPTURE_STROKE) != 0;
+    p5_state.stroke_width = s->stroke_weight;
+    p5_state.transform = (p5_transform_t){
+        s->transform[0], s->transform[1], s->transform[2], s->transform[3], s->transform[4]
+    };
+    p5__cmdlist_execute((const uint8_t*)(frame + 1), frame->size);
+}
+
+// Incremental rendering functions
+void p5_incremental(bool enabled) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    if (inc->enabled == enabled) return;
+    inc->enabled = enabled;
+    inc->full_redraw = true;
+    if (!enabled && inc->target) {
+        p5_remove_graphics(inc->target);
+        inc->target = NULL;
+    }
+}
+
+bool p5_is_incremental(void) {
+    return p5_state.incremental.enabled;
+}
+
+float p5_incremental_redraw_fraction(void) {
+    return p5_state.incremental.redraw_fraction;
+}
+
+void p5_incremental_frame_begin(void) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    if (!inc->enabled || p5_state.recording) return;
+    inc->frame.size = 0;
+    inc->image_count = 0;
+    p5_state.recording = &inc->frame;
+}
+
+// Record p5_image() into the incremental frame; false when not in one
+static bool p5__incremental_image(const p5_graphics_t* pg, float x, float y, float w, float h) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    if (p5_state.recording != &inc->frame) return false;
+    
+    if (inc->image_count == inc->image_capacity) {
+        int capacity = inc->image_capacity ? inc->image_capacity * 2 : 16;
+        const p5_graphics_t** images = (const p5_graphics_t**)p5__realloc((void*)inc->images,
+                                                                          capacity * sizeof(*images));
+        if (!images) {
+            printf("[WARNING] p5_image: out of memory recording an incremental frame\n");
+            return true;
+        }
+        inc->images = images;
+        inc->image_capacity = capacity;
+    }
+    inc->images[inc->image_count] = pg;
+    const float args[] = { (float)inc->image_count++, x, y, w, h };
+    p5__cmdlist_write(&inc->frame, P5__CMD_IMAGE, args, 5);
+    return true;
+}
+
+// Append recorded commands without P5__CMD_IMAGE, whose slots mean nothing
+// outside the incremental frame
+static void p5__cmdlist_append_portable(p5_cmdlist_t* target, const uint8_t* data, size_t size) {
+    size_t copied = 0;
+    for (size_t i = 0; i < size; ) {
+        uint8_t op = data[i];
+        if (op >= P5__CMD_COUNT) break;
+        size_t next = i + 1 + p5__cmd_arg_count[op] * sizeof(float);
+        if (next > size) break;
+        if (op == P5__CMD_IMAGE) {
+            p5__cmdlist_append(target, data + copied, i - copied);
+            copied = next;
+        }
+        i = next;
+    }
+    p5__cmdlist_append(target, data + copied, size - copied);
+}
+
+// Add a dirty region, merging into the closest one when the list is full.
+// Regions inside an existing one (such as a shape whose content changed in
+// place, which is dirty in both frames) add nothing.
+static void p5__incremental_add_dirty(float x0, float y0, float x1, float y1) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    
+    for (int i = 0; i < inc->dirty_count; i++) {
+        const float* d = inc->dirty[i];
+        if (x0 >= d[0] && y0 >= d[1] && x1 <= d[2] && y1 <= d[3]) return;
+    }
+    if (inc->dirty_count < P5_MAX_DIRTY_RECTS) {
+        float* d = inc->dirty[inc->dirty_count++];
+        d[0] = x0; d[1] = y0; d[2] = x1; d[3] = y1;
+        return;
+    }
+    
+    int best = 0;
+    float best_growth = FLT_MAX;
+    for (int i = 0; i < inc->dirty_count; i++) {
+        float* d = inc->dirty[i];
+        float area = (d[2] - d[0]) * (d[3] - d[1]);
+        float merged = (fmaxf(d[2], x1) - fminf(d[0], x0)) * (fmaxf(d[3], y1) - fminf(d[1], y0));
+        if (merged - area < best_growth) {
+            best_growth = merged - area;
+            best = i;
+        }
+    }
+    float* d = inc->dirty[best];
+    d[0] = fminf(d[0], x0); d[1] = fminf(d[1], y0);
+    d[2] = fmaxf(d[2], x1); d[3] = fmaxf(d[3], y1);
+}
+
+// Compare this frame's shapes with the previous frame's, position by position.
+// A pixel can only change if a shape covering it differs at some position,
+// so the bounds of both shapes at every differing position are dirty.
+static void p5__incremental_diff(int width, int height) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    const p5__shape_record_t* cur = inc->shapes[inc->current];
+    const p5__shape_record_t* prev = inc->shapes[!inc->current];
+    int cur_count = inc->shape_count[inc->current];
+    int prev_count = inc->shape_count[!inc->current];
+    int count = cur_count > prev_count ? cur_count : prev_count;
+    
+    inc->dirty_count = 0;
+    if (inc->full_redraw) {
+        p5__incremental_add_dirty(0.0f, 0.0f, (float)width, (float)height);
+        inc->full_redraw = false;
+    } else {
+        for (int i = 0; i < count; i++) {
+            const p5__shape_record_t* a = i < cur_count ? &cur[i] : NULL;
+            const p5__shape_record_t* b = i < prev_count ? &prev[i] : NULL;
+            if (a && b && a->key == b->key) continue;
+            if (a) p5__incremental_add_dirty(a->x0, a->y0, a->x1, a->y1);
+            if (b) p5__incremental_add_dirty(b->x0, b->y0, b->x1, b->y1);
+        }
+    }
+    
+    // Clip to the canvas and snap outwards to whole pixels
+    float area = 0.0f;
+    int kept = 0;
+    for (int i = 0; i < inc->dirty_count; i++) {
+        float* d = inc->dirty[i];
+        float x0 = floorf(fmaxf(d[0], 0.0f)), y0 = floorf(fmaxf(d[1], 0.0f));
+        float x1 = ceilf(fminf(d[2], (float)width)), y1 = ceilf(fminf(d[3], (float)height));
+        if (x1 <= x0 || y1 <= y0) continue;
+        float* k = inc->dirty[kept++];
+        k[0] = x0; k[1] = y0; k[2] = x1; k[3] = y1;
+        area += (x1 - x0) * (y1 - y0);
+    }
+    inc->dirty_count = kept;
+    inc->redraw_fraction = fminf(1.0f, area / ((float)width * (float)height));
+}
+
+// Style fields replayed by every incremental pass
+typedef struct {
+    p5_color_t fill_color, stroke_color;
+    bool fill_enabled, stroke_enabled;
+    float stroke_width;
+    p5_transform_t transform;
+    p5_angle_mode_t angle_mode;
+    p5_color_mode_t color_mode;
+    float color_maxes[4];
+    int style_stack_count, style_stack_depth, style_lost_depth;
+    uint32_t style_dirty;
+} p5__style_snapshot_t;
+
+static void p5__style_snapshot(p5__style_snapshot_t* s, bool restore) {
+    #define P5__SNAPSHOT_FIELD(f) if (restore) p5_state.f = s->f; else s->f = p5_state.f
+    P5__SNAPSHOT_FIELD(fill_color);
+    P5__SNAPSHOT_FIELD(stroke_color);
+    P5__SNAPSHOT_FIELD(fill_enabled);
+    P5__SNAPSHOT_FIELD(stroke_enabled);
+    P5__SNAPSHOT_FIELD(stroke_width);
+    P5__SNAPSHOT_FIELD(transform);
+    P5__SNAPSHOT_FIELD(angle_mode);
+    P5__SNAPSHOT_FIELD(color_mode);
+    P5__SNAPSHOT_FIELD(style_stack_count);
+    P5__SNAPSHOT_FIELD(style_stack_depth);
+    P5__SNAPSHOT_FIELD(style_lost_depth);
+    P5__SNAPSHOT_FIELD(style_dirty);
+    #undef P5__SNAPSHOT_FIELD
+    if (restore) memcpy(p5_state.color_maxes, s->color_maxes, sizeof(s->color_maxes));
+    else memcpy(s->color_maxes, p5_state.color_maxes, sizeof(s->color_maxes));
+}
+
+void p5_incremental_frame_end(void) {
+    p5__incremental_t* inc = &p5_state.incremental;
+    if (p5_state.recording != &inc->frame) return;
+    p5_state.recording = NULL;
+    p5__recorded_scopes_end();
+    
+    if (p5_state.capture_file) {
+        p5__cmdlist_append_portable(&p5_state.capture, inc->frame.data, inc->frame.size);
+    }
+    
+    // (Re)create the persistent canvas target when the canvas size changes
+    int width = p5_width(), height = p5_height();
+    if (inc->enabled && (!inc->target || inc->target->width != width || inc->target->height != height)) {
+        if (inc->target) p5_remove_graphics(inc->target);
+        inc->target = p5_create_graphics(width, height);
+        inc->full_redraw = true;
+    }
+    if (!inc->enabled || !inc->target) {
+        // Disabled mid-frame or no render target: draw the frame directly
+        p5__cmdlist_execute(inc->frame.data, inc->frame.size);
+        return;
+    }
+    
+    p5__style_snapshot_t snapshot;
+    p5__style_snapshot(&snapshot, false);
+    
+    // Measure pass: shape keys and bounds, leaves the style as at frame end
+    inc->current = !inc->current;
+    inc->shape_count[inc->current] = 0;
+    inc->pass = P5__PASS_MEASURE;
+    p5__cmdlist_execute(inc->frame.data, inc->frame.size);
+    inc->pass = P5__PASS_NONE;
+    p5__incremental_diff(width, height);
+    
+    // Redraw each dirty region: clear it, then draw the shapes touching it
+    if (inc->dirty_count > 0) {
+        sgp_begin(width, height);
+        P5__BATCH_BEGIN();
+        for (int i = 0; i < inc->dirty_count; i++) {
+            float* d = inc->dirty[i];
+            p5__style_snapshot(&snapshot, true);
+            sgp_scissor((int)d[0], (int)d[1], (int)(d[2] - d[0]), (int)(d[3] - d[1]));
+            P5__BATCH_BARRIER();
+            sgp_set_color(0.0f, 0.0f, 0.0f, 0.0f);
+            p5__sgp_clear();
+            memcpy(inc->cull, d, sizeof(inc->cull));
+            inc->shape_index = 0;
+            inc->pass = P5__PASS_CULL;
+            p5__cmdlist_execute(inc->frame.data, inc->frame.size);
+            inc->pass = P5__PASS_NONE;
+        }
+        sgp_reset_scissor();
+        P5__BATCH_BARRIER();
+        p5__graphics_submit(inc->target);
+    }
+    
+    p5__graphics_draw(inc->target, 0.0f, 0.0f, (float)width, (float)height);
+}
+
+#endif // P5_IMPLEMENTATION
+
+// Application call wrappers: batch-break diagnostics tag drawing calls with
+// their call site, and tracing counts and times sketch-facing calls. Defined
+// after the implementation so only application code is wrapped.
+#if defined(P5_BATCH_DIAGNOSTICS) || defined(P5_TRACE)
+#ifdef P5_BATCH_DIAGNOSTICS
+#define P5__BATCH_SITE(call) (p5_batch_call_site(__FILE__, __LINE__), call, p5_batch_call_site(NULL, 0))
+#else
+#define P5__BATCH_SITE(call) call
+#endif
+#ifdef P5_TRACE
+#define P5__TRACE(name, call) (p5_trace_enter(), call, p5_trace_leave(P5__TRACE_##name))
+#define P5__TRACE_INT(name, call) (p5_trace_enter(), p5_trace_leave_int(P5__TRACE_##name, call))
+#define P5__TRACE_COLOR(name, call) (p5_trace_enter(), p5_trace_leave_color(P5__TRACE_##name, call))
+#define P5__TRACE_PTR(type, name, call) ((type)(p5_trace_enter(), p5_trace_leave_ptr(P5__TRACE_##name, call)))
+#else
+#define P5__TRACE(name, call) call
+#endif
+
+#define p5_background(...) P5__TRACE(p5_background, P5__BATCH_SITE(p5_background(__VA_ARGS__)))
+#define p5_background_rgb(...) P5__TRACE(p5_background_rgb, P5__BATCH_SITE(p5_background_rgb(__VA_ARGS__)))
+#define p5_point(...) P5__TRACE(p5_point, P5__BATCH_SITE(p5_point(__VA_ARGS__)))
+#define p5_line(...) P5__TRACE(p5_line, P5__BATCH_SITE(p5_line(__VA_ARGS__)))
+#define p5_rect(...) P5__TRACE(p5_rect, P5__BATCH_SITE(p5_rect(__VA_ARGS__)))
+#define p5_square(...) P5__TRACE(p5_square, P5__BATCH_SITE(p5_square(__VA_ARGS__)))
+#define p5_circle(...) P5__TRACE(p5_circle, P5__BATCH_SITE(p5_circle(__VA_ARGS__)))
+#define p5_ellipse(...) P5__TRACE(p5_ellipse, P5__BATCH_SITE(p5_ellipse(__VA_ARGS__)))
+#define p5_triangle(...) P5__TRACE(p5_triangle, P5__BATCH_SITE(p5_triangle(__VA_ARGS__)))
+#define p5_quad(...) P5__TRACE(p5_quad, P5__BATCH_SITE(p5_quad(__VA_ARGS__)))
+#define p5_arc(...) P5__TRACE(p5_arc, P5__BATCH_SITE(p5_arc(__VA_ARGS__)))
+#define p5_arc_with_mode(...) P5__TRACE(p5_arc_with_mode, P5__BATCH_SITE(p5_arc_with_mode(__VA_ARGS__)))
+#define p5_image(...) P5__TRACE(p5_image, P5__BATCH_SITE(p5_image(__VA_ARGS__)))
+#define p5_image_sized(...) P5__TRACE(p5_image_sized, P5__BATCH_SITE(p5_image_sized(__VA_ARGS__)))
+#define p5_cmdlist_replay(...) P5__TRACE(p5_cmdlist_replay, P5__BATCH_SITE(p5_cmdlist_replay(__VA_ARGS__)))
+#define p5_recorder_submit(...) P5__TRACE(p5_recorder_submit, P5__BATCH_SITE(p5_recorder_submit(__VA_ARGS__)))
+#define p5_capture_replay(...) P5__TRACE(p5_capture_replay, P5__BATCH_SITE(p5_capture_replay(__VA_ARGS__)))
+#ifdef P5_TRACE
+#define p5_create_canvas(...) P5__TRACE(p5_create_canvas, p5_create_canvas(__VA_ARGS__))
+#define p5_create_canvas_positioned(...) P5__TRACE(p5_create_canvas_positioned, p5_create_canvas_positioned(__VA_ARGS__))
+#define p5_width(...) P5__TRACE_INT(p5_width, p5_width(__VA_ARGS__))
+#define p5_height(...) P5__TRACE_INT(p5_height, p5_height(__VA_ARGS__))
+#define p5_window_width(...) P5__TRACE_INT(p5_window_width, p5_window_width(__VA_ARGS__))
+#define p5_window_height(...) P5__TRACE_INT(p5_window_height, p5_window_height(__VA_ARGS__))
+#define p5_color(...) P5__TRACE_COLOR(p5_color, p5_color(__VA_ARGS__))
+#define p5_color_rgb(...) P5__TRACE_COLOR(p5_color_rgb, p5_color_rgb(__VA_ARGS__))
+#define p5_color_rgba(...) P5__TRACE_COLOR(p5_color_rgba, p5_color_rgba(__VA_ARGS__))
+#define p5_fill(...) P5__TRACE(p5_fill, p5_fill(__VA_ARGS__))
+#define p5_fill_rgb(...) P5__TRACE(p5_fill_rgb, p5_fill_rgb(__VA_ARGS__))
+#define p5_fill_rgba(...) P5__TRACE(p5_fill_rgba, p5_fill_rgba(__VA_ARGS__))
+#define p5_stroke(...) P5__TRACE(p5_stroke, p5_stroke(__VA_ARGS__))
+#define p5_stroke_rgb(...) P5__TRACE(p5_stroke_rgb, p5_stroke_rgb(__VA_ARGS__))
+#define p5_stroke_rgba(...) P5__TRACE(p5_stroke_rgba, p5_stroke_rgba(__VA_ARGS__))
+#define p5_stroke_weight(...) P5__TRACE(p5_stroke_weight, p5_stroke_weight(__VA_ARGS__))
+#define p5_no_fill(...) P5__TRACE(p5_no_fill, p5_no_fill(__VA_ARGS__))
+#define p5_no_stroke(...) P5__TRACE(p5_no_stroke, p5_no_stroke(__VA_ARGS__))
+#define p5_angle_mode(...) P5__TRACE(p5_angle_mode, p5_angle_mode(__VA_ARGS__))
+#define p5_color_mode(...) P5__TRACE(p5_color_mode, p5_color_mode(__VA_ARGS__))
+#define p5_color_mode_range(...) P5__TRACE(p5_color_mode_range, p5_color_mode_range(__VA_ARGS__))
+#define p5_text_output(...) P5__TRACE(p5_text_output, p5_text_output(__VA_ARGS__))
+#define p5_push(...) P5__TRACE(p5_push, p5_push(__VA_ARGS__))
+#define p5_pop(...) P5__TRACE(p5_pop, p5_pop(__VA_ARGS__))
+#define p5_translate(...) P5__TRACE(p5_translate, p5_translate(__VA_ARGS__))
+#define p5_rotate(...) P5__TRACE(p5_rotate, p5_rotate(__VA_ARGS__))
+#define p5_scale(...) P5__TRACE(p5_scale, p5_scale(__VA_ARGS__))
+#define p5_scale_xy(...) P5__TRACE(p5_scale_xy, p5_scale_xy(__VA_ARGS__))
+#define p5_no_loop(...) P5__TRACE(p5_no_loop, p5_no_loop(__VA_ARGS__))
+#define p5_loop(...) P5__TRACE(p5_loop, p5_loop(__VA_ARGS__))
+#define p5_redraw(...) P5__TRACE(p5_redraw, p5_redraw(__VA_ARGS__))
+#define p5_create_graphics(...) P5__TRACE_PTR(p5_graphics_t*, p5_create_graphics, p5_create_graphics(__VA_ARGS__))
+#define p5_remove_graphics(...) P5__TRACE(p5_remove_graphics, p5_remove_graphics(__VA_ARGS__))
+#define p5_graphics_begin(...) P5__TRACE(p5_graphics_begin, p5_graphics_begin(__VA_ARGS__))
+#define p5_graphics_end(...) P5__TRACE(p5_graphics_end, p5_graphics_end(__VA_ARGS__))
+#define p5_cmdlist_begin(...) P5__TRACE(p5_cmdlist_begin, p5_cmdlist_begin(__VA_ARGS__))
+#define p5_cmdlist_end(...) P5__TRACE_PTR(p5_cmdlist_t*, p5_cmdlist_end, p5_cmdlist_end(__VA_ARGS__))
+#define p5_cmdlist_free(...) P5__TRACE(p5_cmdlist_free, p5_cmdlist_free(__VA_ARGS__))
+#define p5_recorder_begin(...) P5__TRACE(p5_recorder_begin, p5_recorder_begin(__VA_ARGS__))
+#define p5_recorder_end(...) P5__TRACE(p5_recorder_end, p5_recorder_end(__VA_ARGS__))
+#define p5_parallel_for(...) P5__TRACE(p5_parallel_for, p5_parallel_for(__VA_ARGS__))
+#define p5_async(...) P5__TRACE_PTR(p5_task_t*, p5_async, p5_async(__VA_ARGS__))
+#define p5_task_wait(...) P5__TRACE(p5_task_wait, p5_task_wait(__VA_ARGS__))
+#define p5_flush_shapes(...) P5__TRACE(p5_flush_shapes, p5_flush_shapes(__VA_ARGS__))
+#define p5_run_coroutines(...) P5__TRACE_INT(p5_run_coroutines, p5_run_coroutines(__VA_ARGS__))
+#endif // P5_TRACE
+#ifndef P5_NO_SHORT_NAMES
+#define background(...) p5_background(__VA_ARGS__)
+#define background_rgb(...) p5_background_rgb(__VA_ARGS__)
+#define point(...) p5_point(__VA_ARGS__)
+#define line(...) p5_line(__VA_ARGS__)
+#define rect(...) p5_rect(__VA_ARGS__)
+#define square(...) p5_square(__VA_ARGS__)
+#define circle(...) p5_circle(__VA_ARGS__)
+#define ellipse(...) p5_ellipse(__VA_ARGS__)
+#define triangle(...) p5_triangle(__VA_ARGS__)
+#define quad(...) p5_quad(__VA_ARGS__)
+#define arc(...) p5_arc(__VA_ARGS__)
+#define arc_with_mode(...) p5_arc_with_mode(__VA_ARGS__)
+#define image(...) p5_image(__VA_ARGS__)
+#define image_sized(...) p5_image_sized(__VA_ARGS__)
+#ifdef P5_TRACE
+#define createCanvas(...) p5_create_canvas(__VA_ARGS__)
+#define createCanvasPositioned(...) p5_create_canvas_positioned(__VA_ARGS__)
+#define width(...) p5_width(__VA_ARGS__)
+#define height(...) p5_height(__VA_ARGS__)
+#define windowWidth(...) p5_window_width(__VA_ARGS__)
+#define windowHeight(...) p5_window_height(__VA_ARGS__)
+#define fill(...) p5_fill(__VA_ARGS__)
+#define fill_rgb(...) p5_fill_rgb(__VA_ARGS__)
+#define fill_rgba(...) p5_fill_rgba(__VA_ARGS__)
+#define stroke(...) p5_stroke(__VA_ARGS__)
+#define stroke_rgb(...) p5_stroke_rgb(__VA_ARGS__)
+#define stroke_rgba(...) p5_stroke_rgba(__VA_ARGS__)
+#define strokeWeight(...) p5_stroke_weight(__VA_ARGS__)
+#define noFill(...) p5_no_fill(__VA_ARGS__)
+#define noStroke(...) p5_no_stroke(__VA_ARGS__)
+#define angleMode(...) p5_angle_mode(__VA_ARGS__)
+#define colorMode(...) p5_color_mode(__VA_ARGS__)
+#define textOutput(...) p5_text_output(__VA_ARGS__)
+#define push(...) p5_push(__VA_ARGS__)
+#define pop(...) p5_pop(__VA_ARGS__)
+#define translate(...) p5_translate(__VA_ARGS__)
+#define rotate(...) p5_rotate(__VA_ARGS__)
+#define scale(...) p5_scale(__VA_ARGS__)
+#define scale_xy(...) p5_scale_xy(__VA_ARGS__)
+#define noLoop(...) p5_no_loop(__VA_ARGS__)
+#define loop(...) p5_loop(__VA_ARGS__)
+#define redraw(...) p5_redraw(__VA_ARGS__)
+#define createGraphics(...) p5_create_graphics(__VA_ARGS__)
+#endif // P5_TRACE
+#endif // P5_NO_SHORT_NAMES
+#endif // P5_BATCH_DIAGNOSTICS || P5_TRACE
 
 #endif // P5_H
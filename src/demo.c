@@ -19,7 +19,8 @@ static struct {
 
 void frame() {
     // update time for animation
-    state.time += 1.0f/60.0f;
+    p5_frame_begin();
+    state.time += p5_delta_time() / 1000.0f;
     
     // begin sokol gp frame
     sgp_begin(sapp_width(), sapp_height());
@@ -68,6 +69,9 @@ void frame() {
                 500.0f + i * 10.0f, 250.0f + offset);
     }
     
+    // overdraw heat map legend (F2 toggles the heat map)
+    p5_overdraw_legend();
+    
     // dispatch draw commands to GPU
     sg_begin_pass(&(sg_pass){
         .swapchain = sglue_swapchain()
@@ -76,6 +80,7 @@ void frame() {
     sgp_end();
     sg_end_pass();
     sg_commit();
+    p5_frame_end();
 }
 
 void event(const sapp_event* ev) {
@@ -83,6 +88,9 @@ void event(const sapp_event* ev) {
         if (ev->key_code == SAPP_KEYCODE_ESCAPE) {
             sapp_quit();
         }
+        if (ev->key_code == SAPP_KEYCODE_F2 && !ev->key_repeat) {
+            p5_overdraw(!p5_is_overdraw());
+        }
     }
 }
 
@@ -11,7 +11,7 @@
 #define P5_IMPLEMENTATION
 #include "../p5.h"
 
-static float time = 0.0f;
+static float elapsed = 0.0f;
 
 void setup() {
     // Called once at startup - initialize your sketch here
@@ -20,7 +20,7 @@ void setup() {
 
 void draw() {
     // Called every frame - your drawing code here
-    time += 1.0f/60.0f;
+    elapsed += deltaTime() / 1000.0f;
     
     // Background
     p5_background_rgb(25, 25, 50);
@@ -28,7 +28,7 @@ void draw() {
     // Animated rotating rectangle (responsive to canvas size)
     p5_push();
     p5_translate(width()/2, height()/2);
-    p5_rotate(time);
+    p5_rotate(elapsed);
     p5_fill_rgb(255, 128, 50);
     p5_stroke_rgb(255, 255, 255);
     p5_rect(-50.0f, -30.0f, 100.0f, 60.0f);
@@ -39,7 +39,7 @@ void draw() {
         float x = 80.0f + i * (width() - 160) / 3.0f;
         float y = 80.0f;
         float r = (float)i / 3.0f;
-        float g = 0.5f + 0.5f * sinf(time + i);
+        float g = 0.5f + 0.5f * sinf(elapsed + i);
         float b = 0.8f;
         
         p5_fill_rgb((unsigned int)(r * 255), (unsigned int)(g * 255), (unsigned int)(b * 255));
@@ -50,7 +50,7 @@ void draw() {
     // Animated triangle (responsive to canvas size)
     p5_push();
     p5_translate(width()/2, height() - 80);
-    p5_scale(1.5f + 0.5f * sinf(time * 2.0f));
+    p5_scale(1.5f + 0.5f * sinf(elapsed * 2.0f));
     p5_fill_rgb(50, 255, 128);
     p5_stroke_rgb(0, 0, 0);
     p5_triangle(-30.0f, 15.0f, 30.0f, 15.0f, 0.0f, -20.0f);
@@ -0,0 +1,272 @@
+/*
+test_cmdlist.c - Test command list recording and replay
+Checks that a replayed list draws with the caller's style, that its style
+and transform changes stay inside it, that its unbalanced pop() calls
+cannot close the caller's push() scopes, that replaying into an active
+recording nests the list with the same scoping, that recorded push() and
+pop() scope the live angle and color modes, and that replaying a frame
+capture reproduces the frames that were captured.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+static bool record_is(int index, uint8_t red, uint8_t green, uint8_t blue, float x) {
+    const p5_draw_record_t* r = &draw_log.records[index];
+    return r->color[0] == red && r->color[1] == green && r->color[2] == blue && fabsf(r->xy[0] - x) < 0.01f;
+}
+
+// Changes style, leaves a scope open and pops more than it pushed
+static p5_cmdlist_t* record_unbalanced(void) {
+    p5_cmdlist_begin();
+    p5_rect(0, 0, 10, 10);           // Caller's style
+    p5_fill_rgb(255, 0, 0);
+    p5_translate(100, 0);
+    p5_pop();
+    p5_pop();
+    p5_rect(0, 0, 10, 10);
+    p5_push();
+    p5_fill_rgb(0, 0, 255);
+    p5_rect(0, 0, 10, 10);
+    return p5_cmdlist_end();
+}
+
+void test_cmdlist_scoping(void) {
+    p5_init();
+    p5_no_stroke();
+    p5_cmdlist_t* list = record_unbalanced();
+    TEST_ASSERT_TRUE(list != NULL);
+
+    begin_logged_frame();
+    p5_fill_rgb(0, 255, 0);
+    p5_push();
+    p5_fill_rgb(255, 255, 0);
+    p5_cmdlist_replay(list);
+    p5_rect(0, 0, 10, 10);           // Still yellow: the list's pop() calls stayed inside
+    p5_pop();
+    p5_rect(0, 0, 10, 10);           // Green: the caller's scope was still open
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 5);
+    TEST_ASSERT_TRUE(record_is(0, 255, 255, 0, 0));
+    TEST_ASSERT_TRUE(record_is(1, 255, 0, 0, 100));
+    TEST_ASSERT_TRUE(record_is(2, 0, 0, 255, 100));
+    TEST_ASSERT_TRUE(record_is(3, 255, 255, 0, 0));
+    TEST_ASSERT_TRUE(record_is(4, 0, 255, 0, 0));
+
+    // Balanced again: one more pop() is ignored
+    p5_pop();
+    begin_logged_frame();
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(record_is(0, 0, 255, 0, 0));
+    p5_cmdlist_free(list);
+}
+
+void test_cmdlist_nested_recording(void) {
+    p5_init();
+    p5_no_stroke();
+    p5_cmdlist_t* inner = record_unbalanced();
+
+    // Reference: the outer calls drawn directly
+    begin_logged_frame();
+    p5_push();
+    p5_fill_rgb(0, 255, 0);
+    p5_cmdlist_replay(inner);
+    p5_rect(0, 0, 10, 10);
+    p5_pop();
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+    uint64_t expected = p5_draw_log_hash(&draw_log);
+    TEST_ASSERT_TRUE(draw_log.count == 5);
+    TEST_ASSERT_TRUE(record_is(3, 0, 255, 0, 0));
+
+    // The same calls recorded, with the inner list nested into the recording
+    p5_cmdlist_begin();
+    p5_push();
+    p5_fill_rgb(0, 255, 0);
+    p5_cmdlist_replay(inner);
+    p5_rect(0, 0, 10, 10);
+    p5_pop();
+    p5_rect(0, 0, 10, 10);
+    p5_cmdlist_t* outer = p5_cmdlist_end();
+    TEST_ASSERT_TRUE(outer != NULL);
+
+    begin_logged_frame();
+    p5_cmdlist_replay(outer);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected);
+
+    // Nothing leaked into the caller
+    begin_logged_frame();
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(record_is(0, 255, 255, 255, 0));
+
+    p5_cmdlist_free(outer);
+    p5_cmdlist_free(inner);
+}
+
+void test_cmdlist_records_without_drawing(void) {
+    p5_init();
+    begin_logged_frame();
+    p5_cmdlist_begin();
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(0, 0, 10, 10);
+    p5_cmdlist_t* list = p5_cmdlist_end();
+    p5_rect(0, 0, 10, 10);           // Style changes made while recording were not applied
+    end_logged_frame();
+    TEST_ASSERT_TRUE(draw_log.count == 5);  // Fill plus four stroke lines
+    TEST_ASSERT_TRUE(record_is(0, 255, 255, 255, 0));
+    p5_cmdlist_free(list);
+}
+
+void test_cmdlist_scopes_modes(void) {
+    p5_init();
+    p5_push();
+    p5_angle_mode(P5_DEGREES);
+    p5_cmdlist_begin();
+    p5_push();
+    p5_angle_mode(P5_RADIANS);
+    p5_color_mode_range(P5_HSB, 360, 100, 100, 100);
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(0, 0, 10, 10);
+    p5_pop();
+    TEST_ASSERT_TRUE(p5_state.angle_mode == P5_DEGREES);
+    TEST_ASSERT_TRUE(p5_state.color_mode == P5_RGB);
+    p5_fill_rgb(0, 255, 0);
+    p5_rect(20, 0, 10, 10);
+    p5_color_mode(P5_HSB);           // Left open by the list
+    p5_pop();                        // Not the list's scope: recorded only
+    p5_cmdlist_t* list = p5_cmdlist_end();
+    TEST_ASSERT_TRUE(p5_state.angle_mode == P5_DEGREES);
+    TEST_ASSERT_TRUE(p5_state.color_mode == P5_HSB);
+    p5_pop();
+    TEST_ASSERT_TRUE(p5_state.angle_mode == P5_RADIANS);
+    TEST_ASSERT_TRUE(p5_state.color_mode == P5_RGB);
+
+    p5_no_stroke();
+    begin_logged_frame();
+    p5_cmdlist_replay(list);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(draw_log.count == 2);
+    TEST_ASSERT_TRUE(record_is(0, 255, 0, 0, 0));
+    TEST_ASSERT_TRUE(record_is(1, 0, 255, 0, 20));
+
+    // A scope still open when recording ends is closed
+    p5_cmdlist_begin();
+    p5_push();
+    p5_angle_mode(P5_DEGREES);
+    p5_cmdlist_free(p5_cmdlist_end());
+    TEST_ASSERT_TRUE(p5_state.angle_mode == P5_RADIANS);
+    p5_cmdlist_free(list);
+}
+
+#define CAPTURE_PATH "test_cmdlist_capture.p5cf"
+#define CAPTURE_FRAMES 3
+
+// Style and transform carry over from frame to frame, as in a sketch
+static void draw_capture_frame(int frame) {
+    p5_rect(0, 0, 10, 10);
+    p5_fill_rgb(255, (uint8_t)(80 * frame), 0);
+    p5_translate(20, 5);
+    p5_rotate(0.1f);
+    p5_stroke_weight(1.0f + frame);
+    p5_ellipse(0, 0, 8, 8);
+    if (frame == 1) p5_no_stroke();
+    p5_push();
+    p5_scale(2);
+    p5_rect(0, 0, 4, 4);
+    p5_pop();
+    p5_pop();                        // Extra pop
+}
+
+void test_capture_replay_round_trip(void) {
+    p5_init();
+    p5_fill_rgb(0, 0, 255);
+    p5_translate(7, 3);
+    uint64_t expected[CAPTURE_FRAMES];
+    
+    TEST_ASSERT_TRUE(p5_capture_begin(CAPTURE_PATH, CAPTURE_FRAMES));
+    for (int i = 0; i < CAPTURE_FRAMES; i++) {
+        begin_logged_frame();
+        draw_capture_frame(i);
+        p5_capture_frame();
+        end_logged_frame();
+        expected[i] = p5_draw_log_hash(&draw_log);
+    }
+    TEST_ASSERT_FALSE(p5_capture_active());
+    
+    FILE* file = fopen(CAPTURE_PATH, "rb");
+    TEST_ASSERT_TRUE(file != NULL);
+    if (!file) return;
+    static uint8_t data[1 << 16];
+    size_t size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    remove(CAPTURE_PATH);
+    
+    const p5_capture_header_t* header = (const p5_capture_header_t*)data;
+    TEST_ASSERT_TRUE(size > sizeof(*header));
+    TEST_ASSERT_TRUE(header->version == P5_CAPTURE_VERSION);
+    TEST_ASSERT_TRUE(header->frame_count == CAPTURE_FRAMES);
+    
+    // Replay from a different style; each frame must match what was drawn
+    p5_init();
+    p5_fill_rgb(0, 255, 0);
+    p5_no_stroke();
+    p5_scale(3);
+    size_t offset = sizeof(*header);
+    for (uint32_t i = 0; i < header->frame_count && offset < size; i++) {
+        const p5_capture_frame_t* frame = (const p5_capture_frame_t*)(data + offset);
+        offset += sizeof(*frame) + P5_CAPTURE_PADDED_SIZE(frame->size);
+        TEST_ASSERT_TRUE(offset <= size);
+        begin_logged_frame();
+        p5_capture_replay(frame);
+        end_logged_frame();
+        TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected[i]);
+    }
+}
+
+void test_truncated_list_is_rejected(void) {
+    p5_init();
+    p5_cmdlist_begin();
+    p5_rect(0, 0, 10, 10);
+    p5_quad(0, 0, 10, 0, 10, 10, 0, 10);
+    p5_cmdlist_t* list = p5_cmdlist_end();
+    
+    // A capture frame holding the list without the last argument bytes
+    static union { p5_capture_frame_t frame; uint8_t bytes[4096]; } buffer;
+    size_t size = list->size;  // test_headless.h includes the implementation
+    TEST_ASSERT_TRUE(size > 4 && size < sizeof(buffer) - sizeof(p5_capture_frame_t));
+    p5_init();
+    buffer.frame.size = (uint32_t)(size - 4);
+    memcpy(&buffer.frame + 1, list->data, size - 4);
+    memcpy(&buffer.frame.style, &(p5_capture_style_t){ {1, 1, 1, 1}, {0, 0, 0, 1}, 1, {0, 0, 0, 1, 1},
+                                                       P5_CAPTURE_FILL | P5_CAPTURE_STROKE },
+           sizeof(p5_capture_style_t));
+    
+    begin_logged_frame();
+    p5_capture_replay(&buffer.frame);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(draw_log.count == 5);  // The rectangle only
+    p5_cmdlist_free(list);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_cmdlist_scoping);
+    RUN_TEST(test_cmdlist_nested_recording);
+    RUN_TEST(test_cmdlist_records_without_drawing);
+    RUN_TEST(test_cmdlist_scopes_modes);
+    RUN_TEST(test_capture_replay_round_trip);
+    RUN_TEST(test_truncated_list_is_rejected);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
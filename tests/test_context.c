@@ -0,0 +1,143 @@
+/*
+test_context.c - Test p5 context objects (instance mode)
+Checks that contexts keep independent style, transform and canvas state,
+that the current context is per thread, and that worker threads can record
+command lists in their own contexts for the main thread to draw.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+#include <pthread.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+#define WORKER_COUNT 4
+
+void test_context_isolation(void) {
+    p5_context_t* context = p5_context_create();
+    TEST_ASSERT_TRUE(context != NULL);
+    TEST_ASSERT_TRUE(p5_context_current() == p5_context_default());
+
+    p5_init();
+    p5_no_stroke();
+    p5_fill_rgb(255, 0, 0);
+    p5_create_canvas(200, 100);
+
+    p5_context_make_current(context);
+    TEST_ASSERT_TRUE(p5_context_current() == context);
+    TEST_ASSERT_TRUE(p5_width() == TEST_WIDTH);  // Canvas of the default context not visible
+    p5_no_stroke();
+    p5_fill_rgb(0, 0, 255);
+    p5_translate(50, 0);
+
+    // Each context draws with its own style and transform (the draw log is
+    // context state too, so both contexts log into the same log)
+    begin_logged_frame();
+    p5_rect(0, 0, 10, 10);
+    p5_draw_log_end();
+    p5_context_make_current(NULL);
+    p5_draw_log_begin(&draw_log);
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 2);
+    TEST_ASSERT_TRUE(draw_log.records[0].color[2] == 255 && draw_log.records[0].xy[0] == 50.0f);
+    TEST_ASSERT_TRUE(draw_log.records[1].color[0] == 255 && draw_log.records[1].xy[0] == 0.0f);
+    TEST_ASSERT_TRUE(p5_width() == 200);
+
+    p5_context_destroy(context);
+}
+
+void test_context_destroy_current(void) {
+    p5_context_t* context = p5_context_create();
+    p5_context_make_current(context);
+    p5_context_destroy(context);
+    TEST_ASSERT_TRUE(p5_context_current() == p5_context_default());
+
+    // The default context cannot be destroyed
+    p5_context_destroy(p5_context_default());
+    TEST_ASSERT_TRUE(p5_context_current() == p5_context_default());
+}
+
+typedef struct {
+    int index;
+    p5_context_t* context;
+    p5_cmdlist_t* list;
+    p5_context_t* seen_before;    // Current context when the thread started
+} worker_t;
+
+// Tessellation-free recording: style, transforms and shapes into a command list
+static void record_layer(int index) {
+    p5_cmdlist_begin();
+    p5_no_stroke();
+    p5_fill_rgb(index * 60, 255 - index * 60, 128);
+    for (int i = 0; i < 200; i++) {
+        p5_push();
+        p5_translate(10.0f + (i % 20) * 15.0f, 10.0f + index * 50.0f + (i / 20) * 4.0f);
+        p5_rotate(i * 0.1f);
+        p5_rect(-3, -3, 6, 6);
+        p5_pop();
+    }
+}
+
+static void* worker_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    worker->seen_before = p5_context_current();
+    p5_context_make_current(worker->context);
+    record_layer(worker->index);
+    worker->list = p5_cmdlist_end();
+    p5_context_make_current(NULL);
+    return NULL;
+}
+
+void test_context_threads(void) {
+    // Reference: all layers recorded and drawn on the main thread
+    p5_init();
+    p5_cmdlist_t* reference[WORKER_COUNT];
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        record_layer(i);
+        reference[i] = p5_cmdlist_end();
+    }
+    begin_logged_frame();
+    for (int i = 0; i < WORKER_COUNT; i++) p5_cmdlist_replay(reference[i]);
+    end_logged_frame();
+    uint64_t expected = p5_draw_log_hash(&draw_log);
+
+    // Layers recorded concurrently, each thread in its own context
+    worker_t workers[WORKER_COUNT];
+    pthread_t threads[WORKER_COUNT];
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        workers[i] = (worker_t){ .index = i, .context = p5_context_create() };
+        pthread_create(&threads[i], NULL, worker_run, &workers[i]);
+    }
+    for (int i = 0; i < WORKER_COUNT; i++) pthread_join(threads[i], NULL);
+
+    begin_logged_frame();
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        TEST_ASSERT_TRUE(workers[i].seen_before == p5_context_default());
+        TEST_ASSERT_TRUE(workers[i].list != NULL);
+        p5_cmdlist_replay(workers[i].list);
+    }
+    end_logged_frame();
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected);
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_RECT] == WORKER_COUNT * 200);
+
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        p5_cmdlist_free(workers[i].list);
+        p5_cmdlist_free(reference[i]);
+        p5_context_destroy(workers[i].context);
+    }
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_context_isolation);
+    RUN_TEST(test_context_destroy_current);
+    RUN_TEST(test_context_threads);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
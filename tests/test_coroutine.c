@@ -0,0 +1,215 @@
+/*
+test_coroutine.c - Test coroutines (long work spread over frames)
+Checks that p5_run_coroutines() keeps within its per-frame budget while a
+long job yields and resumes until it is done with the same result as
+running it in one go, that pending coroutines take turns, that coroutines
+can be finished early or cancelled, also from steps, and that handles
+outlive the context that started them.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+#define MESH_VERTICES 400000
+
+// A mesh built a slice at a time; next is where the build resumes
+typedef struct {
+    float* xy;
+    int count;
+    int next;
+    int steps;
+} mesh_t;
+
+static bool build_mesh(void* ctx) {
+    mesh_t* mesh = (mesh_t*)ctx;
+    mesh->steps++;
+    while (mesh->next < mesh->count) {
+        int i = mesh->next++;
+        float angle = i * 0.001f;
+        mesh->xy[i * 2] = cosf(angle) * sqrtf((float)i);
+        mesh->xy[i * 2 + 1] = sinf(angle) * sqrtf((float)i);
+        if (i % 1024 == 0 && p5_coroutine_should_yield()) return mesh->next < mesh->count;
+    }
+    return false;
+}
+
+static mesh_t mesh_create(int count) {
+    return (mesh_t){ (float*)calloc((size_t)count * 2, sizeof(float)), count, 0, 0 };
+}
+
+void test_coroutine_budget(void) {
+    mesh_t reference = mesh_create(MESH_VERTICES);
+    mesh_t mesh = mesh_create(MESH_VERTICES);
+    TEST_ASSERT_TRUE(reference.xy != NULL && mesh.xy != NULL);
+    if (!reference.xy || !mesh.xy) return;
+    while (build_mesh(&reference)) {}
+    TEST_ASSERT_TRUE(reference.steps == 1);  // Outside the frame loop nothing yields
+
+    p5_coroutine_budget_ms(1.0f);
+    p5_coroutine_t* co = p5_coroutine_start(build_mesh, &mesh);
+    TEST_ASSERT_TRUE(co != NULL);
+    int frames = 0;
+    double slowest = 0.0;
+    while (!p5_coroutine_done(co) && frames < 100000) {
+        double start = test_now_ms();
+        p5_run_coroutines();
+        double took = test_now_ms() - start;
+        if (took > slowest) slowest = took;
+        frames++;
+    }
+    printf("%d vertices over %d frames, slowest frame %.3f ms\n", MESH_VERTICES, frames, slowest);
+    TEST_ASSERT_TRUE(p5_coroutine_done(co));
+    TEST_ASSERT_TRUE(frames > 1 && mesh.steps == frames);
+    TEST_ASSERT_TRUE(memcmp(mesh.xy, reference.xy, MESH_VERTICES * 2 * sizeof(float)) == 0);
+    p5_coroutine_finish(co);
+    TEST_ASSERT_TRUE(p5_run_coroutines() == 0);
+    p5_coroutine_budget_ms(0.0f);
+    free(mesh.xy);
+    free(reference.xy);
+}
+
+typedef struct {
+    int id;
+    int remaining;
+    int* order;
+    int* turns;
+} worker_t;
+
+// Each step uses up the whole budget
+static bool slow_step(void* ctx) {
+    worker_t* worker = (worker_t*)ctx;
+    worker->order[(*worker->turns)++] = worker->id;
+    while (!p5_coroutine_should_yield()) {}
+    return --worker->remaining > 0;
+}
+
+void test_coroutine_turns(void) {
+    int order[16] = {0};
+    int turns = 0;
+    worker_t workers[3];
+    p5_coroutine_t* cos[3];
+    p5_coroutine_budget_ms(0.5f);
+    for (int i = 0; i < 3; i++) {
+        workers[i] = (worker_t){ i, 2, order, &turns };
+        cos[i] = p5_coroutine_start(slow_step, &workers[i]);
+    }
+    // One step per frame, handed around in turn
+    for (int frame = 0; frame < 6; frame++) TEST_ASSERT_TRUE(p5_run_coroutines() == 1);
+    TEST_ASSERT_TRUE(turns == 6);
+    bool in_turn = true;
+    for (int i = 0; i < 6; i++) in_turn = in_turn && order[i] == i % 3;
+    TEST_ASSERT_TRUE(in_turn);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(p5_coroutine_done(cos[i]));
+        p5_coroutine_finish(cos[i]);
+    }
+    p5_coroutine_budget_ms(0.0f);
+}
+
+void test_coroutine_finish_cancel(void) {
+    mesh_t a = mesh_create(50000);
+    mesh_t b = mesh_create(50000);
+    p5_coroutine_t* first = p5_coroutine_start(build_mesh, &a);
+    p5_coroutine_t* second = p5_coroutine_start(build_mesh, &b);
+    TEST_ASSERT_FALSE(p5_coroutine_done(first));
+
+    // Finishing runs the rest now; cancelling leaves the work undone
+    p5_coroutine_finish(first);
+    TEST_ASSERT_TRUE(a.next == a.count);
+    p5_coroutine_cancel(second);
+    TEST_ASSERT_TRUE(b.next == 0);
+    TEST_ASSERT_TRUE(p5_run_coroutines() == 0);
+
+    TEST_ASSERT_TRUE(p5_coroutine_start(NULL, NULL) == NULL);
+    TEST_ASSERT_TRUE(p5_coroutine_done(NULL));
+    p5_coroutine_finish(NULL);
+    p5_coroutine_cancel(NULL);
+    free(a.xy);
+    free(b.xy);
+}
+
+// Steps that end coroutines, their own included, while the list is stepped;
+// the other coroutines step until the budget is used up
+typedef struct {
+    int steps;
+    p5_coroutine_t* self;
+    p5_coroutine_t* other;
+    bool finish;                // End self with p5_coroutine_finish()
+} ender_t;
+
+static bool end_in_step(void* ctx) {
+    ender_t* ender = (ender_t*)ctx;
+    if (++ender->steps > 1) return ender->steps < 4;
+    if (ender->other) p5_coroutine_cancel(ender->other);
+    if (ender->finish) {
+        p5_coroutine_finish(ender->self);
+    } else {
+        p5_coroutine_cancel(ender->self);
+    }
+    return true;
+}
+
+static bool count_step(void* ctx) {
+    (*(int*)ctx)++;
+    return true;
+}
+
+void test_coroutine_end_in_step(void) {
+    // Cancelling itself and the coroutine before it, which already stepped
+    int counted = 0;
+    ender_t cancel = {0};
+    p5_coroutine_t* before = p5_coroutine_start(count_step, &counted);
+    cancel.self = p5_coroutine_start(end_in_step, &cancel);
+    cancel.other = before;
+    int after = 0;
+    p5_coroutine_t* last = p5_coroutine_start(count_step, &after);
+    TEST_ASSERT_TRUE(p5_run_coroutines() >= 3);
+    TEST_ASSERT_TRUE(cancel.steps == 1 && counted == 1 && after >= 1);
+    int after_first = after;
+
+    // Finishing itself runs the rest once the step returns
+    ender_t finish = { .finish = true };
+    finish.self = p5_coroutine_start(end_in_step, &finish);
+    p5_run_coroutines();
+    TEST_ASSERT_TRUE(finish.steps == 4);
+    TEST_ASSERT_TRUE(after > after_first);
+    TEST_ASSERT_FALSE(p5_coroutine_done(last));
+    p5_coroutine_cancel(last);
+    TEST_ASSERT_TRUE(p5_run_coroutines() == 0);
+}
+
+void test_coroutine_outlives_context(void) {
+    mesh_t a = mesh_create(5000);
+    mesh_t b = mesh_create(5000);
+    p5_context_t* context = p5_context_create();
+    p5_context_make_current(context);
+    p5_coroutine_t* first = p5_coroutine_start(build_mesh, &a);
+    p5_coroutine_t* second = p5_coroutine_start(build_mesh, &b);
+    p5_context_make_current(NULL);
+    p5_context_destroy(context);
+
+    // Detached handles can still be finished or cancelled
+    TEST_ASSERT_FALSE(p5_coroutine_done(first));
+    p5_coroutine_cancel(second);
+    p5_coroutine_finish(first);
+    TEST_ASSERT_TRUE(a.next == a.count && b.next == 0);
+    free(a.xy);
+    free(b.xy);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_coroutine_budget);
+    RUN_TEST(test_coroutine_turns);
+    RUN_TEST(test_coroutine_finish_cancel);
+    RUN_TEST(test_coroutine_end_in_step);
+    RUN_TEST(test_coroutine_outlives_context);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
@@ -20,3 +20,14 @@
 #define SOKOL_GP_IMPL  
 #include "../deps/sokol_gp.h"
 #endif
+
+// Headless Sokol (dummy backend, no window or GPU) for draw stream tests
+#ifdef TEST_HEADLESS
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#define SOKOL_TRACE_HOOKS
+#include "../deps/sokol_gfx.h"
+
+#define SOKOL_GP_IMPL
+#include "../deps/sokol_gp.h"
+#endif
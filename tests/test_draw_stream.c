@@ -0,0 +1,269 @@
+/*
+test_draw_stream.c - Test what p5.h sends to sokol_gp
+Records every sgp draw with a p5_draw_log_t (headless, sokol dummy backend)
+and checks primitives, vertex budgets, colors and transforms, plus a hash of
+the whole draw stream as a fast golden check.
+*/
+
+#include "test_utils.h"
+
+// Heap hooks that can refuse to grow, to test running out of memory
+static bool refuse_realloc;
+static void* test_realloc(void* ptr, size_t size) {
+    return refuse_realloc ? NULL : realloc(ptr, size);
+}
+#define P5_MALLOC(size) malloc(size)
+#define P5_REALLOC(ptr, size) test_realloc(ptr, size)
+#define P5_FREE(ptr) free(ptr)
+
+#include "test_headless.h"
+#include <time.h>
+
+#define TEST_WIDTH 400
+#define TEST_HEIGHT 300
+#define NESTING_DEPTH 300
+
+// Start a logged frame with a fresh p5 state
+static void begin_fresh_frame(void) {
+    p5_init();
+    begin_logged_frame();
+}
+
+static bool point_near(const p5_draw_record_t* r, int i, float x, float y) {
+    return fabsf(r->xy[i*2] - x) < 0.01f && fabsf(r->xy[i*2+1] - y) < 0.01f;
+}
+
+static bool color_is(const p5_draw_record_t* r, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
+    return r->color[0] == red && r->color[1] == green && r->color[2] == blue && r->color[3] == alpha;
+}
+
+void test_circle_vertex_budget(void) {
+    // Small filled circle: 16 segments (the minimum), one triangle each
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_circle(100, 100, 20);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_TRIANGLE] == 16);
+    TEST_ASSERT_TRUE(draw_log.vertices <= 48);
+
+    // Thin stroke adds one line per segment
+    begin_fresh_frame();
+    p5_circle(100, 100, 20);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_LINE] == 16);
+    TEST_ASSERT_TRUE(draw_log.vertices <= 48 + 32);
+
+    // Large circles are capped at 128 segments
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_circle(200, 150, 2000);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_TRIANGLE] == 128);
+    TEST_ASSERT_TRUE(draw_log.vertices <= 128 * 3);
+}
+
+void test_rect_geometry(void) {
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(10, 20, 100, 50);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 1);
+    const p5_draw_record_t* r = &draw_log.records[0];
+    TEST_ASSERT_TRUE(r->op == P5_DRAW_RECT);
+    TEST_ASSERT_TRUE(r->vertices == 6);
+    TEST_ASSERT_TRUE(color_is(r, 255, 0, 0, 255));
+    TEST_ASSERT_TRUE(point_near(r, 0, 10, 20));
+    TEST_ASSERT_TRUE(point_near(r, 2, 110, 70));
+
+    // Thin stroke outline: four lines in the stroke color
+    begin_fresh_frame();
+    p5_no_fill();
+    p5_stroke_rgb(0, 0, 255);
+    p5_rect(10, 20, 100, 50);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_LINE] == 4);
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_RECT] == 0);
+    TEST_ASSERT_TRUE(draw_log.count > 0 && color_is(&draw_log.records[0], 0, 0, 255, 255));
+}
+
+void test_background_clears(void) {
+    begin_fresh_frame();
+    p5_background_rgb(10, 20, 30);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 1);
+    TEST_ASSERT_TRUE(draw_log.records[0].op == P5_DRAW_CLEAR);
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[0], 10, 20, 30, 255));
+}
+
+void test_transforms_applied(void) {
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_translate(100, 50);
+    p5_rotate(HALF_PI);
+    p5_rect(0, 0, 10, 20);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 1);
+    const p5_draw_record_t* r = &draw_log.records[0];
+    TEST_ASSERT_TRUE(point_near(r, 0, 100, 50));
+    TEST_ASSERT_TRUE(point_near(r, 1, 100, 60));   // (10, 0) rotated a quarter turn
+    TEST_ASSERT_TRUE(point_near(r, 3, 80, 50));    // (0, 20)
+}
+
+void test_push_pop_style(void) {
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_fill_rgb(0, 255, 0);
+    p5_push();
+    p5_fill_rgb(255, 0, 255);
+    p5_translate(50, 0);
+    p5_rect(0, 0, 10, 10);
+    p5_pop();
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 2);
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[0], 255, 0, 255, 255));
+    TEST_ASSERT_TRUE(point_near(&draw_log.records[0], 0, 50, 0));
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[1], 0, 255, 0, 255));
+    TEST_ASSERT_TRUE(point_near(&draw_log.records[1], 0, 0, 0));
+}
+
+void test_push_pop_deep_nesting(void) {
+    // Each level changes fill, translation, both or neither
+    static int fill_at[NESTING_DEPTH + 1];
+    static float x_at[NESTING_DEPTH + 1];
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_fill_rgb(0, 0, 0);
+    fill_at[0] = 0;
+    x_at[0] = 0.0f;
+    for (int i = 0; i < NESTING_DEPTH; i++) {
+        p5_push();
+        fill_at[i + 1] = fill_at[i];
+        x_at[i + 1] = x_at[i];
+        if (i % 4 == 0 || i % 4 == 2) {
+            fill_at[i + 1] = i % 256;
+            p5_fill_rgb(i % 256, 0, 0);
+        }
+        if (i % 4 == 1 || i % 4 == 2) {
+            x_at[i + 1] += 1.0f;
+            p5_translate(1, 0);
+            p5_fill_rgb(fill_at[i + 1], 0, 0);  // Again in the same scope: saved once
+        }
+    }
+    p5_rect(0, 0, 10, 10);
+    for (int i = NESTING_DEPTH; i > 0; i--) {
+        p5_pop();
+        p5_rect(0, 0, 10, 10);
+    }
+    p5_pop();  // Unbalanced pop() is ignored
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == NESTING_DEPTH + 2);
+    int wrong = 0;
+    for (int r = 0; r <= NESTING_DEPTH; r++) {
+        int level = NESTING_DEPTH - r;
+        const p5_draw_record_t* record = &draw_log.records[r];
+        if (!color_is(record, (uint8_t)fill_at[level], 0, 0, 255) || !point_near(record, 0, x_at[level], 0)) wrong++;
+    }
+    TEST_ASSERT_TRUE(wrong == 0);
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[NESTING_DEPTH + 1], 0, 0, 0, 255));
+}
+
+void test_push_out_of_memory(void) {
+    begin_fresh_frame();
+    p5_no_stroke();
+    p5_fill_rgb(0, 255, 0);
+    for (int i = 0; i < 10; i++) p5_push();
+    p5_fill_rgb(255, 0, 0);
+
+    // Scopes beyond the allocation find no memory; their pop() must not
+    // close the scopes that did open
+    refuse_realloc = true;
+    for (int i = 0; i < 5000; i++) p5_push();
+    refuse_realloc = false;
+    // Changes inside are saved by the innermost scope that opened
+    p5_fill_rgb(0, 0, 255);
+    p5_translate(5, 0);
+    p5_rect(0, 0, 10, 10);
+    for (int i = 0; i < 5000; i++) p5_pop();
+    p5_rect(0, 0, 10, 10);
+    for (int i = 0; i < 10; i++) p5_pop();
+    p5_rect(0, 0, 10, 10);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(draw_log.count == 3);
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[0], 0, 0, 255, 255) && point_near(&draw_log.records[0], 0, 5, 0));
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[1], 255, 0, 0, 255) && point_near(&draw_log.records[1], 0, 0, 0));
+    TEST_ASSERT_TRUE(color_is(&draw_log.records[2], 0, 255, 0, 255));
+}
+
+static void draw_scene(void) {
+    p5_background_rgb(220, 220, 220);
+    p5_stroke_weight(3);
+    for (int i = 0; i < 10; i++) {
+        p5_fill_rgb(i * 25, 100, 255 - i * 25);
+        p5_circle(30.0f + i * 35.0f, 60, 25);
+    }
+    p5_push();
+    p5_translate(200, 180);
+    p5_rotate(0.3f);
+    p5_rect(-60, -30, 120, 60);
+    p5_arc(0, 0, 80, 80, 0, PI + HALF_PI);
+    p5_pop();
+    p5_stroke_weight(1);
+    p5_line(0, 290, 400, 250);
+    p5_triangle(20, 280, 60, 200, 100, 280);
+    p5_point(380, 20);
+}
+
+void test_draw_stream_golden(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    begin_fresh_frame();
+    draw_scene();
+    end_logged_frame();
+    uint64_t hash = p5_draw_log_hash(&draw_log);
+    int vertices = draw_log.vertices;
+
+    // The same calls always produce the same stream
+    begin_fresh_frame();
+    draw_scene();
+    end_logged_frame();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+    printf("Scene: %d draws, %d vertices, recorded twice in %.3f ms\n", draw_log.count, vertices, ms);
+
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == hash);
+    TEST_ASSERT_TRUE(draw_log.vertices == vertices);
+    TEST_ASSERT_TRUE(compare_hash(hash, "tests/golden/draw_stream_scene.hash"));
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_circle_vertex_budget);
+    RUN_TEST(test_rect_geometry);
+    RUN_TEST(test_background_clears);
+    RUN_TEST(test_transforms_applied);
+    RUN_TEST(test_push_pop_style);
+    RUN_TEST(test_push_pop_deep_nesting);
+    RUN_TEST(test_push_out_of_memory);
+    RUN_TEST(test_draw_stream_golden);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
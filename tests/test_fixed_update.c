@@ -0,0 +1,140 @@
+/*
+test_fixed_update.c - Test the fixed-timestep update thread
+Checks that p5_fixed_update() steps the simulation at its rate whatever the
+drawing does, that draw() gets two consecutive states that stay intact while
+it reads them, that a slow step holds up neither reading nor the clock, and
+that the update can be stopped and restarted.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+#include <time.h>
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+#define PARTICLE_COUNT 1000
+
+typedef struct {
+    int steps;
+    float time;
+    float x[PARTICLE_COUNT];
+} world_t;
+
+static world_t initial_world;
+static int step_sleep_ms;         // Extra time each step takes
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void update_world(void* state, float dt) {
+    world_t* world = (world_t*)state;
+    world->steps++;
+    world->time += dt;
+    for (int i = 0; i < PARTICLE_COUNT; i++) world->x[i] = (float)(world->steps * (i + 1));
+    if (step_sleep_ms > 0) sleep_ms(step_sleep_ms);
+}
+
+static bool world_intact(const world_t* world) {
+    for (int i = 0; i < PARTICLE_COUNT; i++) {
+        if (world->x[i] != (float)(world->steps * (i + 1))) return false;
+    }
+    return true;
+}
+
+void test_fixed_update_rate(void) {
+    const void* previous;
+    const void* current;
+    step_sleep_ms = 0;
+    TEST_ASSERT_TRUE(p5_update_states(&previous, &current) == 0.0f && current == NULL);
+    TEST_ASSERT_TRUE(p5_fixed_update(update_world, &initial_world, sizeof(world_t), 200.0f));
+
+    // Frames that take 50 ms each do not slow the simulation
+    double start = test_now_ms();
+    for (int frame = 0; frame < 6; frame++) {
+        float alpha = p5_update_states(&previous, &current);
+        TEST_ASSERT_TRUE(alpha >= 0.0f && alpha <= 1.0f);
+        sleep_ms(50);
+    }
+    uint64_t steps = p5_update_step_count();
+    double elapsed = test_now_ms() - start;
+    printf("%llu steps at 200 Hz in %.1f ms\n", (unsigned long long)steps, elapsed);
+    TEST_ASSERT_TRUE(steps >= (uint64_t)(elapsed * 0.2 * 0.5) && steps <= (uint64_t)(elapsed * 0.2) + 2);
+
+    // Two consecutive, complete states
+    p5_update_states(&previous, &current);
+    const world_t* a = (const world_t*)previous;
+    const world_t* b = (const world_t*)current;
+    TEST_ASSERT_TRUE(b->steps == a->steps + 1);
+    TEST_ASSERT_TRUE(fabsf(b->time - b->steps / 200.0f) < 1e-3f);
+    TEST_ASSERT_TRUE(world_intact(a) && world_intact(b));
+
+    // Held states stay intact while the simulation moves on
+    int held = b->steps;
+    sleep_ms(60);
+    TEST_ASSERT_TRUE(b->steps == held && world_intact(a) && world_intact(b));
+    TEST_ASSERT_TRUE(p5_update_step_count() > (uint64_t)held);
+    p5_fixed_update_stop();
+    TEST_ASSERT_TRUE(p5_update_step_count() == 0);
+}
+
+void test_fixed_update_slow_step(void) {
+    const void* previous;
+    const void* current;
+    step_sleep_ms = 40;  // Far longer than the 120 Hz timestep
+    TEST_ASSERT_TRUE(p5_fixed_update(update_world, &initial_world, sizeof(world_t), 120.0f));
+    sleep_ms(20);
+
+    // Reading never waits for the step in progress
+    double worst = 0.0;
+    for (int frame = 0; frame < 20; frame++) {
+        double start = test_now_ms();
+        float alpha = p5_update_states(&previous, &current);
+        double took = test_now_ms() - start;
+        if (took > worst) worst = took;
+        TEST_ASSERT_TRUE(alpha >= 0.0f && alpha <= 1.0f);
+        sleep_ms(10);
+    }
+    uint64_t steps = p5_update_step_count();
+    printf("%llu slow steps, slowest read %.3f ms\n", (unsigned long long)steps, worst);
+    TEST_ASSERT_TRUE(worst < 10.0);
+    // The simulation runs as fast as its steps allow, without piling up
+    TEST_ASSERT_TRUE(steps >= 2 && steps <= 8);
+    p5_fixed_update_stop();
+    step_sleep_ms = 0;
+}
+
+void test_fixed_update_restart(void) {
+    const void* previous;
+    const void* current;
+    TEST_ASSERT_FALSE(p5_fixed_update(NULL, &initial_world, sizeof(world_t), 60.0f));
+    TEST_ASSERT_FALSE(p5_fixed_update(update_world, &initial_world, sizeof(world_t), 0.0f));
+
+    // Restarting begins again from the new initial state
+    TEST_ASSERT_TRUE(p5_fixed_update(update_world, &initial_world, sizeof(world_t), 500.0f));
+    sleep_ms(30);
+    world_t later = initial_world;
+    later.steps = 1000;
+    TEST_ASSERT_TRUE(p5_fixed_update(update_world, &later, sizeof(world_t), 500.0f));
+    p5_update_states(&previous, &current);
+    TEST_ASSERT_TRUE(((const world_t*)current)->steps >= 1000);
+
+    // p5_shutdown() stops the update
+    p5_shutdown();
+    p5_update_states(&previous, &current);
+    TEST_ASSERT_TRUE(previous == NULL && current == NULL);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_fixed_update_rate);
+    RUN_TEST(test_fixed_update_slow_step);
+    RUN_TEST(test_fixed_update_restart);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
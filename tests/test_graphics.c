@@ -0,0 +1,100 @@
+/*
+test_graphics.c - Test graphics buffers and their render target pool
+Checks that removed buffers are reused for the same size, and that
+p5_frame_begin() destroys parked targets that stay unused or exceed the
+pool limit.
+*/
+
+#include "test_utils.h"
+
+#define P5_GRAPHICS_POOL_MAX 2
+#define P5_GRAPHICS_POOL_FRAMES 4
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+static int pooled_targets(bool parked) {
+    int count = 0;
+    for (p5_graphics_t* pg = p5_state.graphics_pool; pg; pg = pg->next) {
+        if (pg->in_use != parked) count++;
+    }
+    return count;
+}
+
+static void run_frames(int frames) {
+    for (int i = 0; i < frames; i++) {
+        p5_frame_begin();
+        p5_frame_end();
+    }
+}
+
+void test_graphics_reuse_same_size(void) {
+    p5_graphics_t* a = p5_create_graphics(64, 32);
+    TEST_ASSERT_TRUE(a != NULL);
+    p5_remove_graphics(a);
+    TEST_ASSERT_TRUE(pooled_targets(true) == 1);
+    
+    p5_graphics_t* other = p5_create_graphics(32, 64);
+    TEST_ASSERT_TRUE(other != NULL && other != a);
+    p5_graphics_t* b = p5_create_graphics(64, 32);
+    TEST_ASSERT_TRUE(b == a);
+    TEST_ASSERT_TRUE(b->needs_clear);
+    TEST_ASSERT_TRUE(pooled_targets(true) == 0);
+    
+    p5_remove_graphics(b);
+    p5_remove_graphics(other);
+    run_frames(P5_GRAPHICS_POOL_FRAMES + 1);
+    TEST_ASSERT_TRUE(p5_state.graphics_pool == NULL);
+}
+
+void test_graphics_unused_targets_expire(void) {
+    p5_graphics_t* kept = p5_create_graphics(16, 16);
+    p5_graphics_t* parked = p5_create_graphics(8, 8);
+    p5_remove_graphics(parked);
+    
+    run_frames(P5_GRAPHICS_POOL_FRAMES);
+    TEST_ASSERT_TRUE(pooled_targets(true) == 1);    // Not yet expired
+    TEST_ASSERT_TRUE(p5_create_graphics(8, 8) == parked);
+    p5_remove_graphics(parked);                     // Parked again, expiry restarts
+    run_frames(P5_GRAPHICS_POOL_FRAMES);
+    TEST_ASSERT_TRUE(pooled_targets(true) == 1);
+    run_frames(1);
+    TEST_ASSERT_TRUE(pooled_targets(true) == 0);
+    TEST_ASSERT_TRUE(pooled_targets(false) == 1);   // Buffers in use are never trimmed
+    
+    p5_remove_graphics(kept);
+    run_frames(P5_GRAPHICS_POOL_FRAMES + 1);
+    TEST_ASSERT_TRUE(p5_state.graphics_pool == NULL);
+}
+
+void test_graphics_pool_limit(void) {
+    p5_graphics_t* buffers[P5_GRAPHICS_POOL_MAX + 2];
+    int count = P5_GRAPHICS_POOL_MAX + 2;
+    for (int i = 0; i < count; i++) buffers[i] = p5_create_graphics(10 + i, 10);
+    for (int i = 0; i < count; i++) {
+        p5_remove_graphics(buffers[i]);
+        run_frames(1);
+    }
+    
+    // The two most recently parked targets remain
+    TEST_ASSERT_TRUE(pooled_targets(true) == P5_GRAPHICS_POOL_MAX);
+    TEST_ASSERT_TRUE(p5_create_graphics(10 + count - 1, 10) == buffers[count - 1]);
+    TEST_ASSERT_TRUE(p5_create_graphics(10 + count - 2, 10) == buffers[count - 2]);
+    p5_graphics_t* fresh = p5_create_graphics(10, 10);
+    TEST_ASSERT_TRUE(fresh != NULL);
+    TEST_ASSERT_TRUE(pooled_targets(true) == 0);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+    
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+    
+    RUN_TEST(test_graphics_reuse_same_size);
+    RUN_TEST(test_graphics_unused_targets_expire);
+    RUN_TEST(test_graphics_pool_limit);
+    
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
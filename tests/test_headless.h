@@ -0,0 +1,86 @@
+/*
+test_headless.h - Real p5.h on the sokol dummy backend for API tests
+Include once per test program, link with test_deps_headless.o (TEST_HEADLESS).
+Drawing between headless_frame_begin() and headless_frame_end() reaches
+sokol_gp without a window or GPU, and can be checked with a p5_draw_log_t:
+begin_logged_frame() and end_logged_frame() wrap a frame and collect its
+draws in draw_log.
+*/
+
+#ifndef TEST_HEADLESS_H
+#define TEST_HEADLESS_H
+
+#include "sokol_gfx.h"
+#include "sokol_gp.h"
+
+#define P5_IMPLEMENTATION
+#define P5_HEADLESS
+#define P5_NO_SHORT_NAMES
+#include "../p5.h"
+
+static int headless_width = 0;
+static int headless_height = 0;
+static p5_draw_log_t draw_log;  // Draws of the last logged frame
+
+static inline bool headless_setup(int width, int height) {
+    sg_setup(&(sg_desc){
+        .environment.defaults = {
+            .color_format = SG_PIXELFORMAT_RGBA8,
+            .depth_format = SG_PIXELFORMAT_NONE,
+            .sample_count = 1,
+        },
+    });
+    sgp_setup(&(sgp_desc){ .max_vertices = 1 << 20 });
+    if (!sgp_is_valid()) {
+        printf("ERROR: sgp_setup failed: %s\n", sgp_get_error_message(sgp_get_last_error()));
+        return false;
+    }
+    headless_width = width;
+    headless_height = height;
+    p5_headless_size(width, height);
+    p5_init();
+    return true;
+}
+
+static inline void headless_frame_begin(void) {
+    sgp_begin(headless_width, headless_height);
+    sgp_viewport(0, 0, headless_width, headless_height);
+    sgp_project(0.0f, (float)headless_width, 0.0f, (float)headless_height);
+}
+
+static inline void headless_frame_end(void) {
+    sg_begin_pass(&(sg_pass){
+        .swapchain = {
+            .width = headless_width,
+            .height = headless_height,
+            .sample_count = 1,
+            .color_format = SG_PIXELFORMAT_RGBA8,
+            .depth_format = SG_PIXELFORMAT_NONE,
+        },
+    });
+    sgp_flush();
+    sgp_end();
+    sg_end_pass();
+    sg_commit();
+}
+
+// A headless frame with an empty draw log recording its draws
+static inline void begin_logged_frame(void) {
+    headless_frame_begin();
+    p5_draw_log_clear(&draw_log);
+    p5_draw_log_begin(&draw_log);
+}
+
+static inline void end_logged_frame(void) {
+    p5_draw_log_end();
+    headless_frame_end();
+}
+
+static inline void headless_shutdown(void) {
+    p5_draw_log_free(&draw_log);
+    p5_shutdown();
+    sgp_shutdown();
+    sg_shutdown();
+}
+
+#endif // TEST_HEADLESS_H
@@ -0,0 +1,168 @@
+/*
+test_image_compare.c - Test the golden image comparator
+Checks channel tolerance, failing-pixel share, max-error and perceptual
+limits and the diff image on synthetic RGBA buffers, including 4K frames.
+*/
+
+#include "test_utils.h"
+
+#define WIDTH_4K 3840
+#define HEIGHT_4K 2160
+
+static unsigned char* make_gradient(int width, int height) {
+    unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * 4);
+    if (!pixels) return NULL;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char* p = pixels + ((size_t)y * width + x) * 4;
+            p[0] = (unsigned char)(x * 255 / width);
+            p[1] = (unsigned char)(y * 255 / height);
+            p[2] = (unsigned char)((x + y) & 0xFF);
+            p[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+// Fill a rect of the image with one color
+static void paint_rect(unsigned char* pixels, int width, int x0, int y0, int w, int h,
+                       unsigned char r, unsigned char g, unsigned char b) {
+    for (int y = y0; y < y0 + h; y++) {
+        for (int x = x0; x < x0 + w; x++) {
+            unsigned char* p = pixels + ((size_t)y * width + x) * 4;
+            p[0] = r; p[1] = g; p[2] = b;
+        }
+    }
+}
+
+void test_identical_4k(void) {
+    unsigned char* golden = make_gradient(WIDTH_4K, HEIGHT_4K);
+    unsigned char* test = make_gradient(WIDTH_4K, HEIGHT_4K);
+    TEST_ASSERT_TRUE(golden && test);
+    if (!golden || !test) return;
+
+    image_compare_result_t result;
+    TEST_ASSERT_TRUE(compare_pixels(test, golden, WIDTH_4K, HEIGHT_4K, NULL, &result));
+    TEST_ASSERT_TRUE(result.failing_pixels == 0);
+    TEST_ASSERT_TRUE(result.max_error == 0);
+    printf("4K identical: %.2f ms\n", result.ms);
+
+    free(golden);
+    free(test);
+}
+
+void test_antialiasing_noise_passes(void) {
+    unsigned char* golden = make_gradient(WIDTH_4K, HEIGHT_4K);
+    unsigned char* test = make_gradient(WIDTH_4K, HEIGHT_4K);
+    if (!golden || !test) return;
+
+    // One-level differences on a third of all channels
+    size_t bytes = (size_t)WIDTH_4K * HEIGHT_4K * 4;
+    for (size_t i = 0; i < bytes; i += 3) {
+        if ((i & 3) != 3) test[i] = test[i] < 255 ? test[i] + 1 : test[i] - 1;
+    }
+
+    image_compare_result_t result;
+    TEST_ASSERT_TRUE(compare_pixels(test, golden, WIDTH_4K, HEIGHT_4K, NULL, &result));
+    TEST_ASSERT_TRUE(result.failing_pixels == 0);
+    TEST_ASSERT_TRUE(result.max_error == 1);
+    TEST_ASSERT_TRUE(result.mean_error > 0.0);
+    printf("4K with AA noise: %.2f ms\n", result.ms);
+
+    free(golden);
+    free(test);
+}
+
+void test_broken_region_fails(void) {
+    int width = 400, height = 300;
+    unsigned char* golden = make_gradient(width, height);
+    unsigned char* test = make_gradient(width, height);
+    if (!golden || !test) return;
+
+    // A 0.9% region drawn in the wrong color
+    paint_rect(test, width, 100, 100, 36, 30, 255, 0, 255);
+
+    image_compare_options_t options = image_compare_defaults();
+    options.diff_image = "tests/test_output_compare_diff.png";
+    image_compare_result_t result;
+    TEST_ASSERT_FALSE(compare_pixels(test, golden, width, height, &options, &result));
+    TEST_ASSERT_TRUE(result.failing_pixels == 36 * 30);
+    TEST_ASSERT_TRUE(result.failing_percent > 0.89f && result.failing_percent < 0.91f);
+    TEST_ASSERT_TRUE(file_exists("tests/test_output_compare_diff.png"));
+
+    // The diff marks exactly the broken region in red
+    int w, h, channels;
+    unsigned char* diff = stbi_load("tests/test_output_compare_diff.png", &w, &h, &channels, 4);
+    TEST_ASSERT_TRUE(diff && w == width && h == height);
+    if (diff) {
+        const unsigned char* inside = diff + ((size_t)110 * width + 110) * 4;
+        const unsigned char* outside = diff + ((size_t)10 * width + 10) * 4;
+        TEST_ASSERT_TRUE(inside[0] == 255 && inside[1] == 0 && inside[2] == 0);
+        TEST_ASSERT_TRUE(outside[0] == outside[1] && outside[1] == outside[2]);
+        stbi_image_free(diff);
+    }
+
+    free(golden);
+    free(test);
+}
+
+void test_max_error_limit(void) {
+    int width = 64, height = 64;
+    unsigned char* golden = make_gradient(width, height);
+    unsigned char* test = make_gradient(width, height);
+    if (!golden || !test) return;
+
+    // A single hot pixel is within the failing-pixel share...
+    test[(32 * width + 32) * 4 + 1] ^= 0x80;
+    image_compare_options_t options = image_compare_defaults();
+    options.max_failing_percent = 1.0f;
+    TEST_ASSERT_TRUE(compare_pixels(test, golden, width, height, &options, NULL));
+
+    // ...but not within a max-error limit
+    options.max_error = 32;
+    image_compare_result_t result;
+    TEST_ASSERT_FALSE(compare_pixels(test, golden, width, height, &options, &result));
+    TEST_ASSERT_TRUE(result.max_error == 128);
+
+    free(golden);
+    free(test);
+}
+
+void test_perceptual_threshold(void) {
+    int width = 64, height = 64;
+    unsigned char* golden = make_gradient(width, height);
+    unsigned char* test = make_gradient(width, height);
+    if (!golden || !test) return;
+
+    // Blue shifted by 6 everywhere: beyond channel tolerance, barely visible
+    for (int i = 0; i < width * height; i++) {
+        test[i * 4 + 2] = golden[i * 4 + 2] < 250 ? golden[i * 4 + 2] + 6 : golden[i * 4 + 2] - 6;
+    }
+    image_compare_options_t options = image_compare_defaults();
+    TEST_ASSERT_FALSE(compare_pixels(test, golden, width, height, &options, NULL));
+
+    options.perceptual_threshold = 0.005f;
+    image_compare_result_t result;
+    TEST_ASSERT_TRUE(compare_pixels(test, golden, width, height, &options, &result));
+    TEST_ASSERT_TRUE(result.max_perceptual > 0.0f && result.max_perceptual < 0.005f);
+
+    // A visible change still fails
+    paint_rect(test, width, 0, 0, 16, 16, 255, 255, 255);
+    TEST_ASSERT_FALSE(compare_pixels(test, golden, width, height, &options, &result));
+    TEST_ASSERT_TRUE(result.failing_pixels >= 16 * 16 - 1);
+
+    free(golden);
+    free(test);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    RUN_TEST(test_identical_4k);
+    RUN_TEST(test_antialiasing_noise_passes);
+    RUN_TEST(test_broken_region_fails);
+    RUN_TEST(test_max_error_limit);
+    RUN_TEST(test_perceptual_threshold);
+
+    TEST_RUNNER_END();
+}
@@ -0,0 +1,138 @@
+/*
+test_incremental.c - Test incremental (dirty-rectangle) rendering
+Checks that unchanged frames redraw nothing, that drawing into a graphics
+buffer inside an incremental frame goes to the buffer instead of the frame,
+and that p5_image() is redrawn into the persistent canvas target in call
+order when its position or buffer content changes.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+#define IMAGE_WIDTH 40
+#define IMAGE_HEIGHT 30
+
+static void begin_incremental_frame(void) {
+    begin_logged_frame();
+    p5_incremental_frame_begin();
+}
+
+static void end_incremental_frame(void) {
+    p5_incremental_frame_end();
+    end_logged_frame();
+}
+
+static int count_op(p5_draw_op_t op) {
+    int count = 0;
+    for (int i = 0; i < draw_log.count; i++) {
+        if (draw_log.records[i].op == op) count++;
+    }
+    return count;
+}
+
+static void fill_buffer(p5_graphics_t* pg, uint8_t red) {
+    p5_graphics_begin(pg);
+    p5_fill_rgb(red, 0, 0);
+    p5_rect(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT);
+    p5_graphics_end();
+}
+
+void test_incremental_unchanged_frame(void) {
+    p5_init();
+    p5_incremental(true);
+    for (int frame = 0; frame < 2; frame++) {
+        begin_incremental_frame();
+        p5_background_rgb(30, 30, 30);
+        p5_rect(10, 10, 50, 50);
+        end_incremental_frame();
+    }
+    TEST_ASSERT_TRUE(p5_incremental_redraw_fraction() == 0.0f);
+    TEST_ASSERT_TRUE(draw_log.count == 1);                      // Only the composite
+    TEST_ASSERT_TRUE(draw_log.records[0].op == P5_DRAW_TEXTURED_RECT);
+    p5_incremental(false);
+}
+
+void test_incremental_graphics_buffer_drawing(void) {
+    p5_init();
+    p5_graphics_t* pg = p5_create_graphics(IMAGE_WIDTH, IMAGE_HEIGHT);
+    TEST_ASSERT_TRUE(pg != NULL);
+    p5_incremental(true);
+    
+    begin_incremental_frame();
+    p5_rect(10, 10, 50, 50);
+    size_t recorded = p5_state.incremental.frame.size;
+    p5_graphics_begin(pg);
+    p5_rect(0, 0, 10, 10);
+    p5_fill_rgb(255, 0, 0);
+    TEST_ASSERT_TRUE(draw_log.count > 0);                       // Drawn right away
+    p5_graphics_end();
+    TEST_ASSERT_TRUE(p5_state.incremental.frame.size == recorded);
+    TEST_ASSERT_TRUE(p5_state.recording == &p5_state.incremental.frame);
+    TEST_ASSERT_TRUE(p5_state.fill_color.g == 1.0f);            // Style stayed in the buffer
+    end_incremental_frame();
+    
+    p5_incremental(false);
+    p5_remove_graphics(pg);
+}
+
+void test_incremental_image(void) {
+    p5_init();
+    p5_no_stroke();
+    p5_graphics_t* pg = p5_create_graphics(IMAGE_WIDTH, IMAGE_HEIGHT);
+    fill_buffer(pg, 255);
+    p5_incremental(true);
+    float image_x = 100.0f;
+    
+    for (int frame = 0; frame < 4; frame++) {
+        if (frame == 2) fill_buffer(pg, 128);   // New content, same position
+        if (frame == 3) image_x = 200.0f;       // Same content, new position
+        begin_incremental_frame();
+        p5_background_rgb(30, 30, 30);
+        p5_fill_rgb(0, 255, 0);
+        p5_rect(0, 0, 20, 20);
+        p5_image(pg, image_x, 50);
+        p5_rect(image_x, 50, 10, 10);           // Drawn over the image
+        end_incremental_frame();
+        
+        float fraction = p5_incremental_redraw_fraction();
+        float image_area = (IMAGE_WIDTH + 2.0f) * (IMAGE_HEIGHT + 2.0f) / (TEST_WIDTH * TEST_HEIGHT);
+        if (frame == 0) TEST_ASSERT_TRUE(fraction == 1.0f);
+        if (frame == 1) TEST_ASSERT_TRUE(fraction == 0.0f);
+        if (frame == 2) TEST_ASSERT_TRUE(fraction > 0.0f && fraction <= image_area + 1e-6f);
+        if (frame == 3) TEST_ASSERT_TRUE(fraction > image_area && fraction <= 2.0f * image_area + 1e-6f);
+        
+        // The image is drawn into the canvas target between the two rects,
+        // and the target is composited last
+        int last = draw_log.count - 1;
+        TEST_ASSERT_TRUE(draw_log.records[last].op == P5_DRAW_TEXTURED_RECT);
+        TEST_ASSERT_TRUE(count_op(P5_DRAW_TEXTURED_RECT) == (frame == 1 ? 1 : 2));
+        if (frame != 1) {
+            int image = -1, rect = -1;
+            for (int i = 0; i < last; i++) {
+                const p5_draw_record_t* r = &draw_log.records[i];
+                if (r->op == P5_DRAW_TEXTURED_RECT) image = i;
+                if (r->op == P5_DRAW_RECT && fabsf(r->xy[0] - image_x) < 0.01f) rect = i;
+            }
+            TEST_ASSERT_TRUE(image >= 0 && fabsf(draw_log.records[image].xy[0] - image_x) < 0.01f);
+            TEST_ASSERT_TRUE(rect > image);
+        }
+    }
+    
+    p5_incremental(false);
+    p5_remove_graphics(pg);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+    
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+    
+    RUN_TEST(test_incremental_unchanged_frame);
+    RUN_TEST(test_incremental_graphics_buffer_drawing);
+    RUN_TEST(test_incremental_image);
+    
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
@@ -0,0 +1,130 @@
+/*
+test_loop.c - Test noLoop() frame caching
+Checks that the frame which calls noLoop() is kept and re-presented
+without running the sketch again, that re-presenting costs one textured
+draw, and that redraw(), loop() and canvas size changes draw new frames.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+static int sketch_draws = 0;
+static bool stop_in_draw = false;
+
+static void sketch_draw(void) {
+    sketch_draws++;
+    p5_background_rgb(20, 20, 20);
+    p5_rect(10, 10, 50, 50);
+    p5_ellipse(100, 100, 40, 40);
+    if (stop_in_draw) p5_no_loop();
+}
+
+// One p5_sokol_frame() worth of loop handling, logged
+static void run_frame(void) {
+    begin_logged_frame();
+    if (p5_loop_frame_begin()) sketch_draw();
+    p5_loop_frame_end();
+    end_logged_frame();
+}
+
+static bool presents_cached_frame(void) {
+    return draw_log.count == 1 && draw_log.records[0].op == P5_DRAW_TEXTURED_RECT;
+}
+
+void test_looping_draws_every_frame(void) {
+    p5_init();
+    sketch_draws = 0;
+    for (int i = 0; i < 3; i++) run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 3);
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_TEXTURED_RECT] == 0);
+    TEST_ASSERT_TRUE(p5_state.loop_target == NULL);
+}
+
+void test_no_loop_keeps_its_frame(void) {
+    p5_init();
+    sketch_draws = 0;
+    stop_in_draw = true;
+    run_frame();
+    stop_in_draw = false;
+    TEST_ASSERT_TRUE(sketch_draws == 1);
+    TEST_ASSERT_FALSE(p5_is_looping());
+    TEST_ASSERT_TRUE(p5_state.loop_target != NULL);
+    
+    // The sketch does not run again; each frame is one textured quad
+    for (int i = 0; i < 3; i++) {
+        run_frame();
+        TEST_ASSERT_TRUE(presents_cached_frame());
+    }
+    TEST_ASSERT_TRUE(sketch_draws == 1);
+    TEST_ASSERT_TRUE(draw_log.vertices == 6);
+    
+    p5_redraw();
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 2);
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 2 && presents_cached_frame());
+    
+    p5_loop();
+    run_frame();
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 4);
+    TEST_ASSERT_TRUE(draw_log.ops[P5_DRAW_TEXTURED_RECT] == 0);
+    TEST_ASSERT_TRUE(p5_state.loop_target == NULL);
+}
+
+static void resize(int width, int height) {
+    headless_width = width;
+    headless_height = height;
+    p5_headless_size(width, height);
+}
+
+void test_no_loop_redraws_after_resize(void) {
+    p5_init();
+    sketch_draws = 0;
+    p5_no_loop();
+    run_frame();
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 1);
+    
+    resize(TEST_WIDTH / 2, TEST_HEIGHT / 2);
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 2);
+    TEST_ASSERT_TRUE(p5_state.loop_target->width == TEST_WIDTH / 2);
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 2 && presents_cached_frame());
+    
+    // A frame that stops looping while resizing was drawn for the old size
+    p5_loop();
+    run_frame();
+    stop_in_draw = true;
+    headless_frame_begin();
+    if (p5_loop_frame_begin()) {
+        sketch_draw();
+        resize(TEST_WIDTH, TEST_HEIGHT);
+    }
+    p5_loop_frame_end();
+    headless_frame_end();
+    stop_in_draw = false;
+    TEST_ASSERT_TRUE(sketch_draws == 4);
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 5);
+    run_frame();
+    TEST_ASSERT_TRUE(sketch_draws == 5 && presents_cached_frame());
+    p5_loop();
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+    
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+    
+    RUN_TEST(test_looping_draws_every_frame);
+    RUN_TEST(test_no_loop_keeps_its_frame);
+    RUN_TEST(test_no_loop_redraws_after_resize);
+    
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
@@ -0,0 +1,203 @@
+/*
+test_parallel.c - Test the worker pool (p5_parallel_for, p5_async)
+Checks that parallel loops cover their range exactly once, also when nested
+and with more slices than a job queue holds, that async tasks complete and
+can be polled from draw(), and that the pool can be resized and restarted.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+#define PARTICLE_COUNT 100000
+
+static void count_items(int begin, int end, void* ctx) {
+    unsigned char* hits = (unsigned char*)ctx;
+    for (int i = begin; i < end; i++) hits[i]++;
+}
+
+static bool all_hit_once(const unsigned char* hits, int count) {
+    for (int i = 0; i < count; i++) {
+        if (hits[i] != 1) return false;
+    }
+    return true;
+}
+
+void test_parallel_for_covers_range(void) {
+    int count = 1000000;
+    unsigned char* hits = (unsigned char*)calloc(count, 1);
+    TEST_ASSERT_TRUE(hits != NULL);
+    if (!hits) return;
+
+    p5_parallel_for(0, count, 1000, count_items, hits);
+    TEST_ASSERT_TRUE(all_hit_once(hits, count));
+    TEST_ASSERT_TRUE(p5_worker_thread_count() >= 1);
+
+    // Automatic grain, an offset range and one item per slice (far more
+    // slices than a job queue holds)
+    memset(hits, 0, count);
+    p5_parallel_for(0, count, 0, count_items, hits);
+    TEST_ASSERT_TRUE(all_hit_once(hits, count));
+    memset(hits, 0, count);
+    p5_parallel_for(500, 20500, 1, count_items, hits);
+    TEST_ASSERT_TRUE(all_hit_once(hits + 500, 20000));
+    TEST_ASSERT_TRUE(hits[499] == 0 && hits[20500] == 0);
+
+    // Empty ranges do nothing
+    p5_parallel_for(600, 600, 1, count_items, hits);
+    p5_parallel_for(600, 500, 1, count_items, hits);
+    TEST_ASSERT_TRUE(hits[600] == 1);
+    free(hits);
+}
+
+typedef struct {
+    unsigned char* hits;
+    int columns;
+} grid_t;
+
+static void count_row_cells(int begin, int end, void* ctx) {
+    grid_t* grid = (grid_t*)ctx;
+    for (int row = begin; row < end; row++) {
+        count_items(row * grid->columns, (row + 1) * grid->columns, grid->hits);
+    }
+}
+
+// Each row is a parallel loop of its own
+static void count_rows(int begin, int end, void* ctx) {
+    grid_t* grid = (grid_t*)ctx;
+    for (int row = begin; row < end; row++) {
+        grid_t cells = { grid->hits + row * grid->columns, 1 };
+        p5_parallel_for(0, grid->columns, 64, count_row_cells, &cells);
+    }
+}
+
+void test_parallel_for_nested(void) {
+    grid_t grid = { (unsigned char*)calloc(512 * 512, 1), 512 };
+    TEST_ASSERT_TRUE(grid.hits != NULL);
+    if (!grid.hits) return;
+    p5_parallel_for(0, 512, 8, count_rows, &grid);
+    TEST_ASSERT_TRUE(all_hit_once(grid.hits, 512 * 512));
+    free(grid.hits);
+}
+
+typedef struct {
+    int index;
+    double sum;
+} job_t;
+
+static void sum_series(void* ctx) {
+    job_t* job = (job_t*)ctx;
+    double sum = 0.0;
+    for (int i = 1; i <= 20000; i++) sum += 1.0 / ((double)i * i);
+    job->sum = sum + job->index;
+}
+
+void test_async_tasks(void) {
+    enum { TASK_COUNT = 700 };  // More than a job queue holds
+    static job_t jobs[TASK_COUNT];
+    static p5_task_t* tasks[TASK_COUNT];
+    job_t reference = { 0, 0.0 };
+    sum_series(&reference);
+    int started = 0;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        jobs[i] = (job_t){ i, 0.0 };
+        tasks[i] = p5_async(sum_series, &jobs[i]);
+        if (tasks[i]) started++;
+    }
+    TEST_ASSERT_TRUE(started == TASK_COUNT);
+
+    // Poll as draw() would, then wait for the rest
+    int polls = 0;
+    while (!p5_task_done(tasks[0])) polls++;
+    int done = 0;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        p5_task_wait(tasks[i]);
+        if (jobs[i].sum == reference.sum + i) done++;
+    }
+    printf("%d tasks done (%d polls for the first)\n", done, polls);
+    TEST_ASSERT_TRUE(done == TASK_COUNT);
+
+    // Waiting for nothing is fine
+    TEST_ASSERT_TRUE(p5_task_done(NULL));
+    p5_task_wait(NULL);
+}
+
+typedef struct {
+    float* x;
+    float* y;
+    float* vx;
+    float* vy;
+} particles_t;
+
+static void update_particles(int begin, int end, void* ctx) {
+    particles_t* p = (particles_t*)ctx;
+    for (int i = begin; i < end; i++) {
+        for (int step = 0; step < 20; step++) {
+            p->vx[i] += sinf(p->y[i] * 0.01f) * 0.1f;
+            p->vy[i] += cosf(p->x[i] * 0.01f) * 0.1f;
+            p->x[i] += p->vx[i];
+            p->y[i] += p->vy[i];
+        }
+    }
+}
+
+static void reset_particles(particles_t* p) {
+    for (int i = 0; i < PARTICLE_COUNT; i++) {
+        p->x[i] = (float)(i % 640);
+        p->y[i] = (float)(i / 640);
+        p->vx[i] = p->vy[i] = 0.0f;
+    }
+}
+
+void test_worker_threads(void) {
+    float* buffer = (float*)malloc(PARTICLE_COUNT * 4 * sizeof(float));
+    TEST_ASSERT_TRUE(buffer != NULL);
+    if (!buffer) return;
+    particles_t p = { buffer, buffer + PARTICLE_COUNT, buffer + PARTICLE_COUNT * 2, buffer + PARTICLE_COUNT * 3 };
+
+    // Reference: one thread
+    reset_particles(&p);
+    double start = test_now_ms();
+    update_particles(0, PARTICLE_COUNT, &p);
+    double serial_ms = test_now_ms() - start;
+    float expected_x = p.x[PARTICLE_COUNT - 1];
+
+    // The same update on pools of 1 and 3 workers gives the same result
+    int sizes[2] = { 1, 3 };
+    for (int s = 0; s < 2; s++) {
+        p5_worker_threads(sizes[s]);
+        reset_particles(&p);
+        start = test_now_ms();
+        p5_parallel_for(0, PARTICLE_COUNT, 0, update_particles, &p);
+        double parallel_ms = test_now_ms() - start;
+        TEST_ASSERT_TRUE(p5_worker_thread_count() == sizes[s]);
+        TEST_ASSERT_TRUE(p.x[PARTICLE_COUNT - 1] == expected_x);
+        printf("%d particles: %.2f ms on one thread, %.2f ms with %d workers (%d CPUs)\n",
+               PARTICLE_COUNT, serial_ms, parallel_ms, sizes[s], (int)sysconf(_SC_NPROCESSORS_ONLN));
+    }
+
+    // Shutting down the default context stops the pool; the next use restarts it
+    p5_shutdown();
+    TEST_ASSERT_TRUE(p5_worker_thread_count() == 0);
+    job_t job = { 0, 0.0 };
+    p5_task_wait(p5_async(sum_series, &job));
+    TEST_ASSERT_TRUE(job.sum > 1.0);
+    TEST_ASSERT_TRUE(p5_worker_thread_count() == 3);
+    p5_worker_threads(0);
+    free(buffer);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_parallel_for_covers_range);
+    RUN_TEST(test_parallel_for_nested);
+    RUN_TEST(test_async_tasks);
+    RUN_TEST(test_worker_threads);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
@@ -0,0 +1,166 @@
+/*
+test_pipeline.c - Test pipelined frames
+Checks that with p5_pipelined() draw() runs one frame ahead on the worker
+thread, that the presented frames are exactly those of serial drawing, that
+the added frame of latency shows in p5_frame_latency_ms(), and that noLoop()
+and redraw() behave as in serial mode.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+#include <time.h>
+
+#define TEST_WIDTH 400
+#define TEST_HEIGHT 300
+#define FRAME_COUNT 6
+
+static int draws;                 // draw() calls, on whichever thread runs them
+static int last_frame_count;      // p5_frame_count() seen by the last draw()
+
+// A logged frame inside p5_frame_begin()/p5_frame_end()
+static void begin_timed_frame(void) {
+    p5_frame_begin();
+    begin_logged_frame();
+}
+
+static void end_timed_frame(void) {
+    end_logged_frame();
+    p5_frame_end();
+}
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { 0, ms * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// A frame whose content depends on the frame count
+static void draw_frame(void) {
+    draws++;
+    last_frame_count = p5_frame_count();
+    p5_background_rgb(20, 20, 30);
+    p5_stroke_weight(2);
+    p5_fill_rgb((last_frame_count * 40) % 256, 120, 200);
+    p5_push();
+    p5_translate(200, 150);
+    p5_rotate(last_frame_count * 0.2f);
+    p5_rect(-50, -20, 100, 40);
+    p5_pop();
+    p5_circle(20.0f + last_frame_count * 10.0f, 40, 30);
+}
+
+void test_pipeline_matches_serial(void) {
+    uint64_t expected[FRAME_COUNT];
+    p5_init();
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        begin_timed_frame();
+        p5_pipeline_draw(draw_frame);  // Not pipelined: draws right away
+        end_timed_frame();
+        expected[i] = p5_draw_log_hash(&draw_log);
+    }
+
+    p5_init();
+    p5_pipelined(true);
+    TEST_ASSERT_TRUE(p5_is_pipelined());
+    draws = 0;
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        begin_timed_frame();
+        p5_pipeline_draw(draw_frame);
+        end_timed_frame();
+        TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected[i]);
+    }
+    // The last frame was presented while the one after it was drawn
+    p5_pipelined(false);
+    TEST_ASSERT_FALSE(p5_is_pipelined());
+    TEST_ASSERT_TRUE(draws == FRAME_COUNT + 1);
+    TEST_ASSERT_TRUE(last_frame_count == FRAME_COUNT + 1);
+
+    // Serial again, in the calling context
+    begin_timed_frame();
+    p5_pipeline_draw(draw_frame);
+    end_timed_frame();
+    TEST_ASSERT_TRUE(draws == FRAME_COUNT + 2);
+    TEST_ASSERT_TRUE(last_frame_count == FRAME_COUNT + 1);
+}
+
+void test_pipeline_latency(void) {
+    // Frames 4 ms apart, as if paced by a display
+    p5_init();
+    float serial = 0.0f;
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        begin_timed_frame();
+        p5_pipeline_draw(draw_frame);
+        end_timed_frame();
+        serial = p5_frame_latency_ms();
+        sleep_ms(4);
+    }
+
+    p5_pipelined(true);
+    float pipelined = 0.0f;
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        begin_timed_frame();
+        p5_pipeline_draw(draw_frame);
+        end_timed_frame();
+        pipelined = p5_frame_latency_ms();
+        sleep_ms(4);
+    }
+    p5_pipelined(false);
+
+    // The presented draw() started a whole frame before this frame began
+    printf("Latency: %.3f ms serial, %.3f ms pipelined\n", serial, pipelined);
+    TEST_ASSERT_TRUE(serial < 4.0f);
+    TEST_ASSERT_TRUE(pipelined >= 4.0f);
+}
+
+static void draw_once(void) {
+    draw_frame();
+    p5_no_loop();
+}
+
+void test_pipeline_no_loop(void) {
+    p5_init();
+    p5_pipelined(true);
+    draws = 0;
+    uint64_t first = 0;
+    for (int i = 0; i < 4; i++) {
+        begin_timed_frame();
+        p5_pipeline_draw(draw_once);
+        end_timed_frame();
+        if (i == 0) first = p5_draw_log_hash(&draw_log);
+        // The last frame is presented again without drawing
+        TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == first);
+        TEST_ASSERT_FALSE(p5_is_looping());
+    }
+    TEST_ASSERT_TRUE(draws == 1);
+
+    // redraw() records one more frame, presented on the frame after
+    p5_redraw();
+    for (int i = 0; i < 2; i++) {
+        begin_timed_frame();
+        p5_pipeline_draw(draw_once);
+        end_timed_frame();
+    }
+    TEST_ASSERT_TRUE(draws == 2);
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) != first);
+
+    // loop() from this thread reaches the sketch
+    p5_loop();
+    begin_timed_frame();
+    p5_pipeline_draw(draw_frame);
+    end_timed_frame();
+    p5_pipelined(false);
+    TEST_ASSERT_TRUE(draws == 3);
+    TEST_ASSERT_TRUE(p5_is_looping());
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_pipeline_matches_serial);
+    RUN_TEST(test_pipeline_latency);
+    RUN_TEST(test_pipeline_no_loop);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
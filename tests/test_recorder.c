@@ -0,0 +1,329 @@
+/*
+test_recorder.c - Test recorders of tessellated geometry
+Checks that recorded shapes reach sokol_gp exactly as direct drawing would,
+that recorders submitted without a draw log hand sokol_gfx the same vertices
+and draws, that recorders filled on worker threads are drawn in the order the
+main thread submits them, and that plain fills are merged into one sgp draw.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 400
+#define TEST_HEIGHT 300
+#define WORKER_COUNT 4
+#define MAX_SUBMITTED_DRAWS 4096
+
+// Every kind of draw p5 tessellates: fills, thin and thick strokes, points,
+// transformed rects and a background
+static void draw_scene(void) {
+    p5_background_rgb(30, 30, 40);
+    p5_stroke_weight(4);
+    p5_stroke_rgb(250, 200, 0);
+    for (int i = 0; i < 6; i++) {
+        p5_fill_rgba(40 * i, 90, 200, 180);
+        p5_ellipse(40.0f + i * 60.0f, 60, 50, 30);
+    }
+    p5_push();
+    p5_translate(200, 160);
+    p5_rotate(0.4f);
+    p5_scale_xy(1.5f, 0.75f);
+    p5_rect(-40, -20, 80, 40);
+    p5_arc_with_mode(0, 0, 60, 60, 0, PI, P5_PIE);
+    p5_pop();
+    p5_stroke_weight(1);
+    p5_line(0, 290, 400, 250);
+    p5_quad(300, 200, 380, 210, 370, 280, 310, 270);
+    p5_triangle(20, 280, 60, 200, 100, 280);
+    p5_point(380, 20);
+    p5_stroke_weight(6);
+    p5_point(360, 20);
+}
+
+void test_recorder_matches_direct(void) {
+    p5_init();
+    begin_logged_frame();
+    draw_scene();
+    end_logged_frame();
+    uint64_t expected = p5_draw_log_hash(&draw_log);
+    int vertices = draw_log.vertices;
+    int count = draw_log.count;
+
+    p5_recorder_t* recorder = p5_recorder_create();
+    p5_init();
+    p5_recorder_begin(recorder);
+    draw_scene();
+    p5_recorder_end();
+
+    begin_logged_frame();
+    p5_recorder_submit(recorder);
+    end_logged_frame();
+
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected);
+    TEST_ASSERT_TRUE(draw_log.count == count);
+    TEST_ASSERT_TRUE(draw_log.vertices == vertices);
+    // The background keeps only its color
+    TEST_ASSERT_TRUE(p5_recorder_vertex_count(recorder) == vertices - 5);
+
+    p5_recorder_free(recorder);
+}
+
+// What sgp_flush() hands sokol_gfx, seen through its trace hooks
+typedef struct {
+    unsigned char* vertices;
+    size_t size;
+    struct { uint32_t pipeline; int base, count; } draws[MAX_SUBMITTED_DRAWS];
+    int draw_count;
+    uint32_t pipeline;
+} submitted_t;
+
+static void trace_append_buffer(sg_buffer buf, const sg_range* data, int result, void* user_data) {
+    (void)buf; (void)result;
+    submitted_t* out = (submitted_t*)user_data;
+    out->vertices = (unsigned char*)realloc(out->vertices, out->size + data->size);
+    memcpy(out->vertices + out->size, data->ptr, data->size);
+    out->size += data->size;
+}
+
+static void trace_apply_pipeline(sg_pipeline pip, void* user_data) {
+    ((submitted_t*)user_data)->pipeline = pip.id;
+}
+
+static void trace_draw(int base_element, int num_elements, int num_instances, void* user_data) {
+    (void)num_instances;
+    submitted_t* out = (submitted_t*)user_data;
+    if (out->draw_count == MAX_SUBMITTED_DRAWS) return;
+    out->draws[out->draw_count].pipeline = out->pipeline;
+    out->draws[out->draw_count].base = base_element;
+    out->draws[out->draw_count].count = num_elements;
+    out->draw_count++;
+}
+
+static void end_traced_frame(submitted_t* out) {
+    memset(out, 0, sizeof(*out));
+    sg_trace_hooks hooks = {
+        .user_data = out,
+        .append_buffer = trace_append_buffer,
+        .apply_pipeline = trace_apply_pipeline,
+        .draw = trace_draw,
+    };
+    sg_trace_hooks previous = sg_install_trace_hooks(&hooks);
+    headless_frame_end();
+    sg_install_trace_hooks(&previous);
+}
+
+// Positions up to rounding of the transform, and colors; untextured draws
+// never read the texcoords sgp fills in for rects
+static bool same_vertices(const submitted_t* a, const submitted_t* b) {
+    if (a->size != b->size) return false;
+    const sgp_vertex* va = (const sgp_vertex*)a->vertices;
+    const sgp_vertex* vb = (const sgp_vertex*)b->vertices;
+    for (size_t i = 0; i < a->size / sizeof(sgp_vertex); i++) {
+        if (fabsf(va[i].position.x - vb[i].position.x) > 1e-5f ||
+            fabsf(va[i].position.y - vb[i].position.y) > 1e-5f ||
+            memcmp(&va[i].color, &vb[i].color, sizeof(sgp_color_ub4)) != 0) return false;
+    }
+    return true;
+}
+
+// Mixed primitives that overlap, with some shapes partly or wholly off the canvas
+static void draw_scattered(void) {
+    for (int i = 0; i < 400; i++) {
+        float x = (float)((i * 97) % 520) - 60.0f;
+        float y = (float)((i * 61) % 420) - 60.0f;
+        p5_stroke_weight((float)(i % 3));
+        p5_stroke_rgb(i % 256, 0, 255 - i % 256);
+        p5_fill_rgba(0, (i * 5) % 256, 90, 200);
+        switch (i % 4) {
+            case 0: p5_circle(x, y, 20); break;
+            case 1: p5_line(x, y, x + 30, y + 10); break;
+            case 2: p5_point(x, y); break;
+            default: p5_rect(x, y, 12, 18); break;
+        }
+    }
+}
+
+void test_recorder_fast_path_matches_direct(void) {
+    static submitted_t direct, recorded;
+    void (*scenes[2])(void) = { draw_scene, draw_scattered };
+    for (int s = 0; s < 2; s++) {
+        p5_init();
+        headless_frame_begin();
+        scenes[s]();
+        end_traced_frame(&direct);
+
+        p5_recorder_t* recorder = p5_recorder_create();
+        p5_init();
+        p5_recorder_begin(recorder);
+        scenes[s]();
+        p5_recorder_end();
+        headless_frame_begin();
+        p5_recorder_submit(recorder);
+        end_traced_frame(&recorded);
+        p5_recorder_free(recorder);
+
+        // sgp culled and merged the recorded draws as it did the direct ones
+        TEST_ASSERT_TRUE(direct.draw_count > 1 && direct.draw_count < MAX_SUBMITTED_DRAWS);
+        TEST_ASSERT_TRUE(recorded.draw_count == direct.draw_count);
+        TEST_ASSERT_TRUE(memcmp(recorded.draws, direct.draws, sizeof(direct.draws)) == 0);
+        TEST_ASSERT_TRUE(recorded.size == direct.size);
+        TEST_ASSERT_TRUE(same_vertices(&recorded, &direct));
+        free(direct.vertices);
+        free(recorded.vertices);
+    }
+}
+
+void test_recorder_style_and_limits(void) {
+    p5_init();
+    p5_recorder_t* recorder = p5_recorder_create();
+    p5_recorder_begin(recorder);
+    p5_no_stroke();
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(0, 0, 10, 10);
+
+    // Nested recording and GPU resources are refused
+    p5_recorder_begin(recorder);
+    p5_cmdlist_begin();
+    TEST_ASSERT_TRUE(p5_cmdlist_end() == NULL);
+    p5_image(NULL, 0, 0);
+    p5_recorder_end();
+
+    // Style changes made while recording stay in the context
+    begin_logged_frame();
+    p5_recorder_submit(recorder);
+    p5_rect(20, 0, 10, 10);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(draw_log.count == 2);
+    TEST_ASSERT_TRUE(draw_log.records[0].color[0] == 255 && draw_log.records[1].color[0] == 255);
+
+    // Submitting applies the current transform; begin() discards old content
+    p5_translate(100, 0);
+    begin_logged_frame();
+    p5_recorder_submit(recorder);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(draw_log.count == 1 && draw_log.records[0].xy[0] == 100.0f);
+
+    p5_recorder_begin(recorder);
+    p5_recorder_end();
+    TEST_ASSERT_TRUE(p5_recorder_vertex_count(recorder) == 0);
+    p5_recorder_free(recorder);
+}
+
+void test_recorder_merges_draws(void) {
+    p5_init();
+    p5_recorder_t* recorder = p5_recorder_create();
+    p5_recorder_begin(recorder);
+    p5_no_stroke();
+    for (int i = 0; i < 1000; i++) {
+        p5_fill_rgb(i % 256, 128, 255 - i % 256);
+        p5_circle((float)(i % 40) * 10.0f, (float)(i / 40) * 12.0f, 8);
+    }
+    p5_recorder_end();
+    TEST_ASSERT_TRUE(p5_recorder_vertex_count(recorder) == 1000 * 16 * 3);
+
+    // Without a draw log sgp merges the circles into one draw call
+    headless_frame_begin();
+    p5_recorder_submit(recorder);
+    headless_frame_end();
+    sg_frame_stats stats = sg_query_frame_stats();
+    printf("1000 circles: %d vertices, %u draw calls\n", p5_recorder_vertex_count(recorder), stats.num_draw);
+    TEST_ASSERT_TRUE(stats.num_draw == 1);
+
+    p5_recorder_free(recorder);
+}
+
+typedef struct {
+    int index;
+    p5_context_t* context;
+    p5_recorder_t* recorder;
+} worker_t;
+
+static void record_layer(int index) {
+    p5_stroke_weight(3);
+    p5_stroke_rgb(0, 0, 0);
+    p5_fill_rgb(index * 60, 255 - index * 60, 128);
+    for (int i = 0; i < 300; i++) {
+        p5_push();
+        p5_translate(10.0f + (i % 30) * 13.0f, 20.0f + index * 20.0f + (i / 30) * 6.0f);
+        p5_rotate(i * 0.1f);
+        if (i % 3 == 0) {
+            p5_rect(-4, -4, 8, 8);
+        } else {
+            p5_ellipse(0, 0, 14, 10);
+        }
+        p5_pop();
+    }
+}
+
+static void* worker_run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    p5_context_make_current(worker->context);
+    p5_recorder_begin(worker->recorder);
+    record_layer(worker->index);
+    p5_recorder_end();
+    p5_context_make_current(NULL);
+    return NULL;
+}
+
+void test_recorder_threads_in_order(void) {
+    static const int order[WORKER_COUNT] = { 2, 0, 3, 1 };
+
+    // Reference: the layers recorded one after another on the main thread
+    p5_recorder_t* reference[WORKER_COUNT];
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        p5_init();
+        reference[i] = p5_recorder_create();
+        p5_recorder_begin(reference[i]);
+        record_layer(i);
+        p5_recorder_end();
+    }
+    begin_logged_frame();
+    for (int i = 0; i < WORKER_COUNT; i++) p5_recorder_submit(reference[order[i]]);
+    end_logged_frame();
+    uint64_t expected = p5_draw_log_hash(&draw_log);
+
+    // The same layers recorded concurrently, submitted in the same order
+    worker_t workers[WORKER_COUNT];
+    pthread_t threads[WORKER_COUNT];
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        workers[i] = (worker_t){ .index = i, .context = p5_context_create(), .recorder = p5_recorder_create() };
+        pthread_create(&threads[i], NULL, worker_run, &workers[i]);
+    }
+    for (int i = 0; i < WORKER_COUNT; i++) pthread_join(threads[i], NULL);
+
+    begin_logged_frame();
+    for (int i = 0; i < WORKER_COUNT; i++) p5_recorder_submit(workers[order[i]].recorder);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected);
+
+    // Another order is another frame
+    begin_logged_frame();
+    for (int i = 0; i < WORKER_COUNT; i++) p5_recorder_submit(workers[i].recorder);
+    end_logged_frame();
+    TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) != expected);
+
+    for (int i = 0; i < WORKER_COUNT; i++) {
+        TEST_ASSERT_TRUE(p5_recorder_vertex_count(workers[i].recorder) == p5_recorder_vertex_count(reference[i]));
+        p5_recorder_free(workers[i].recorder);
+        p5_recorder_free(reference[i]);
+        p5_context_destroy(workers[i].context);
+    }
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_recorder_matches_direct);
+    RUN_TEST(test_recorder_fast_path_matches_direct);
+    RUN_TEST(test_recorder_style_and_limits);
+    RUN_TEST(test_recorder_merges_draws);
+    RUN_TEST(test_recorder_threads_in_order);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
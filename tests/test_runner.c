@@ -0,0 +1,194 @@
+/*
+test_runner.c - Run test cases of several test binaries in parallel
+Lists each binary's RUN_TEST cases (TEST_LIST=1), then runs every case in
+its own process (TEST_FILTER=<case>) on a pool of worker threads, and
+reports per-test timings. Golden images are decoded once into the shared
+cache in tests/.golden_cache (see load_golden in test_utils.c).
+POSIX only (popen, pthreads).
+
+Usage: test_runner [-j jobs] <test binary>...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MAX_CASE_NAME 128
+
+typedef struct {
+    const char* binary;
+    char name[MAX_CASE_NAME];
+    bool passed;
+    double wall_ms;               // Process run time, including setup
+    double case_ms;               // Time of the case itself, as reported by RUN_TEST
+    char* output;
+} test_job_t;
+
+static struct {
+    test_job_t* jobs;
+    int job_count;
+    int next_job;
+    int finished;
+    pthread_mutex_t lock;
+} runner = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Run a shell command, returning its exit status and whole output
+static int run_command(const char* command, char** output) {
+    FILE* pipe = popen(command, "r");
+    if (!pipe) {
+        *output = NULL;
+        return -1;
+    }
+    size_t size = 0, capacity = 4096;
+    char* text = (char*)malloc(capacity);
+    size_t bytes;
+    while (text && (bytes = fread(text + size, 1, capacity - size - 1, pipe)) > 0) {
+        size += bytes;
+        if (capacity - size < 1024) {
+            char* grown = (char*)realloc(text, capacity * 2);
+            if (!grown) break;
+            text = grown;
+            capacity *= 2;
+        }
+    }
+    if (text) text[size] = '\0';
+    int status = pclose(pipe);
+    *output = text;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static bool add_job(const char* binary, const char* name) {
+    test_job_t* jobs = (test_job_t*)realloc(runner.jobs, (runner.job_count + 1) * sizeof(test_job_t));
+    if (!jobs) return false;
+    runner.jobs = jobs;
+    test_job_t* job = &jobs[runner.job_count++];
+    memset(job, 0, sizeof(*job));
+    job->binary = binary;
+    snprintf(job->name, sizeof(job->name), "%s", name);
+    return true;
+}
+
+static int list_cases(const char* binary) {
+    char command[1024];
+    snprintf(command, sizeof(command), "TEST_LIST=1 '%s' 2>/dev/null", binary);
+    char* output = NULL;
+    run_command(command, &output);
+    int count = 0;
+    for (char* line = output ? strtok(output, "\n") : NULL; line; line = strtok(NULL, "\n")) {
+        char name[MAX_CASE_NAME];
+        if (sscanf(line, "TEST_CASE %127s", name) == 1 && add_job(binary, name)) count++;
+    }
+    free(output);
+    return count;
+}
+
+static void* worker(void* arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&runner.lock);
+        int index = runner.next_job < runner.job_count ? runner.next_job++ : -1;
+        pthread_mutex_unlock(&runner.lock);
+        if (index < 0) return NULL;
+
+        test_job_t* job = &runner.jobs[index];
+        char command[1024];
+        snprintf(command, sizeof(command), "TEST_FILTER='%s' '%s' 2>&1", job->name, job->binary);
+        double start = now_ms();
+        job->passed = run_command(command, &job->output) == 0;
+        job->wall_ms = now_ms() - start;
+
+        // "--- <case> took <ms> ms ---" from RUN_TEST
+        char marker[MAX_CASE_NAME + 16];
+        snprintf(marker, sizeof(marker), "--- %s took ", job->name);
+        const char* took = job->output ? strstr(job->output, marker) : NULL;
+        job->case_ms = took ? atof(took + strlen(marker)) : job->wall_ms;
+        if (!took) job->passed = false;  // The case did not run
+
+        pthread_mutex_lock(&runner.lock);
+        runner.finished++;
+        printf("[%3d/%d] %s %9.2f ms  %s:%s\n", runner.finished, runner.job_count,
+               job->passed ? "PASS" : "FAIL", job->case_ms, job->binary, job->name);
+        fflush(stdout);
+        pthread_mutex_unlock(&runner.lock);
+    }
+}
+
+static int compare_slowest(const void* a, const void* b) {
+    double ta = (*(const test_job_t* const*)a)->wall_ms;
+    double tb = (*(const test_job_t* const*)b)->wall_ms;
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int first = 1;
+    if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+        jobs = atol(argv[2]);
+        first = 3;
+    }
+    if (jobs < 1) jobs = 1;
+    if (first >= argc) {
+        printf("Usage: %s [-j jobs] <test binary>...\n", argv[0]);
+        return 1;
+    }
+
+    double start = now_ms();
+    for (int i = first; i < argc; i++) {
+        if (list_cases(argv[i]) == 0) {
+            printf("ERROR: No test cases found in %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (jobs > runner.job_count) jobs = runner.job_count;
+    printf("Running %d test cases from %d binaries on %ld workers\n",
+           runner.job_count, argc - first, jobs);
+
+    pthread_t* threads = (pthread_t*)malloc(jobs * sizeof(pthread_t));
+    if (!threads) return 1;
+    for (long i = 0; i < jobs; i++) pthread_create(&threads[i], NULL, worker, NULL);
+    for (long i = 0; i < jobs; i++) pthread_join(threads[i], NULL);
+    free(threads);
+    double elapsed = now_ms() - start;
+
+    // Full output of failures, in listing order
+    int failed = 0;
+    double total_ms = 0.0;
+    test_job_t** sorted = (test_job_t**)malloc(runner.job_count * sizeof(test_job_t*));
+    for (int i = 0; i < runner.job_count; i++) {
+        test_job_t* job = &runner.jobs[i];
+        total_ms += job->wall_ms;
+        if (sorted) sorted[i] = job;
+        if (job->passed) continue;
+        failed++;
+        printf("\n========== FAIL %s:%s ==========\n%s", job->binary, job->name,
+               job->output ? job->output : "(no output)\n");
+    }
+
+    printf("\n=========================================\n");
+    if (sorted) {
+        qsort(sorted, runner.job_count, sizeof(test_job_t*), compare_slowest);
+        printf("Slowest test cases (process time):\n");
+        for (int i = 0; i < runner.job_count && i < 5; i++) {
+            printf("  %9.2f ms  %s:%s\n", sorted[i]->wall_ms, sorted[i]->binary, sorted[i]->name);
+        }
+        free(sorted);
+    }
+    printf("%d passed, %d failed in %.1f ms (%.1f ms of test processes, %.2fx)\n",
+           runner.job_count - failed, failed, elapsed, total_ms, elapsed > 0.0 ? total_ms / elapsed : 0.0);
+    printf("=========================================\n");
+
+    for (int i = 0; i < runner.job_count; i++) free(runner.jobs[i].output);
+    free(runner.jobs);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/*
+test_shape_batch.c - Test batched shape tessellation
+Checks that with p5_shape_batching() shapes are only stored until the next
+flush, that the flushed frame is exactly the directly drawn one also when
+the shapes are split over many chunks and worker threads, that without a
+draw log the batch costs the same draw calls and vertices as direct drawing,
+that other draws, recorder submits and graphics buffer composites flush the
+batch first so call order holds, that shapes replayed by incremental frames
+are drawn into the canvas target right away, and that batched circles are
+merged into few draw calls.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 400
+#define TEST_HEIGHT 300
+
+// End a logged frame after drawing the shapes still batched
+static void end_batched_frame(void) {
+    p5_flush_shapes();
+    end_logged_frame();
+}
+
+// Every batched shape kind with style and transform changes in between,
+// enough of them for many chunks
+static void draw_scene(void) {
+    p5_background_rgb(30, 30, 40);
+    for (int i = 0; i < 3000; i++) {
+        p5_push();
+        p5_translate((float)(i % 50) * 8.0f, (float)(i / 50) * 5.0f);
+        p5_rotate(i * 0.05f);
+        p5_stroke_weight((float)(i % 4));
+        p5_stroke_rgb(250, (i * 7) % 256, 0);
+        p5_fill_rgba((i * 13) % 256, 90, 200, 180);
+        if (i % 5 == 0) p5_no_stroke();
+        if (i % 11 == 0) p5_no_fill();
+        switch (i % 7) {
+            case 0: p5_ellipse(0, 0, 12, 8); break;
+            case 1: p5_rect(-4, -3, 8, 6); break;
+            case 2: p5_line(-5, 0, 5, 2); break;
+            case 3: p5_triangle(-4, 3, 0, -4, 4, 3); break;
+            case 4: p5_quad(-4, -4, 4, -3, 5, 4, -3, 3); break;
+            case 5: p5_arc_with_mode(0, 0, 10, 10, 0, PI, (p5_arc_mode_t)(i % 3)); break;
+            default: p5_point(0, 0); break;
+        }
+        p5_pop();
+    }
+}
+
+void test_shape_batch_matches_direct(void) {
+    p5_init();
+    begin_logged_frame();
+    draw_scene();
+    end_batched_frame();
+    uint64_t expected = p5_draw_log_hash(&draw_log);
+    int vertices = draw_log.vertices;
+
+    int sizes[2] = { 1, 4 };
+    for (int s = 0; s < 2; s++) {
+        p5_worker_threads(sizes[s]);
+        p5_init();
+        p5_shape_batching(true);
+        TEST_ASSERT_TRUE(p5_is_shape_batching());
+        begin_logged_frame();
+        draw_scene();
+        // Only the background has been drawn so far
+        TEST_ASSERT_TRUE(draw_log.count == 1);
+        TEST_ASSERT_TRUE(p5_batched_shape_count() > 2000);
+        end_batched_frame();
+        TEST_ASSERT_TRUE(p5_batched_shape_count() == 0);
+        TEST_ASSERT_TRUE(p5_draw_log_hash(&draw_log) == expected);
+        TEST_ASSERT_TRUE(draw_log.vertices == vertices);
+        p5_shape_batching(false);
+    }
+    p5_worker_threads(0);
+}
+
+// Draw calls and vertices sokol_gfx received for a frame of the scene,
+// shifted so part of it is off the canvas
+static void count_frame(float shift, uint32_t* draws, uint32_t* vertices) {
+    p5_init();
+    headless_frame_begin();
+    p5_translate(shift, shift);
+    draw_scene();
+    p5_flush_shapes();
+    headless_frame_end();
+    sg_frame_stats stats = sg_query_frame_stats();
+    *draws = stats.num_draw;
+    *vertices = stats.size_append_buffer / (uint32_t)sizeof(sgp_vertex);
+}
+
+void test_shape_batch_unlogged_costs(void) {
+    const float shifts[2] = { 0.0f, -150.0f };
+    for (int s = 0; s < 2; s++) {
+        uint32_t draws, vertices;
+        count_frame(shifts[s], &draws, &vertices);
+        TEST_ASSERT_TRUE(draws > 1);
+
+        // sgp culls and merges batched draws as it does direct ones
+        p5_worker_threads(4);
+        p5_shape_batching(true);
+        uint32_t batched_draws, batched_vertices;
+        count_frame(shifts[s], &batched_draws, &batched_vertices);
+        p5_shape_batching(false);
+        p5_worker_threads(0);
+        printf("Shift %g: %u draw calls and %u vertices direct, %u and %u batched\n",
+               shifts[s], draws, vertices, batched_draws, batched_vertices);
+        TEST_ASSERT_TRUE(batched_draws == draws);
+        TEST_ASSERT_TRUE(batched_vertices == vertices);
+    }
+}
+
+void test_shape_batch_order(void) {
+    // A background between shapes
+    p5_init();
+    p5_shape_batching(true);
+    begin_logged_frame();
+    p5_no_stroke();
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(0, 0, 10, 10);
+    p5_background_rgb(0, 0, 255);
+    p5_fill_rgb(0, 255, 0);
+    p5_rect(20, 0, 10, 10);
+    end_batched_frame();
+    TEST_ASSERT_TRUE(draw_log.count == 3);
+    TEST_ASSERT_TRUE(draw_log.records[0].color[0] == 255);
+    TEST_ASSERT_TRUE(draw_log.records[2].color[1] == 255 && draw_log.records[2].xy[0] == 20.0f);
+
+    // Disabling flushes; shapes in a recorder are never batched
+    begin_logged_frame();
+    p5_rect(0, 0, 10, 10);
+    p5_shape_batching(false);
+    TEST_ASSERT_TRUE(draw_log.count == 1);
+    p5_shape_batching(true);
+    p5_recorder_t* recorder = p5_recorder_create();
+    p5_recorder_begin(recorder);
+    p5_rect(0, 0, 10, 10);
+    p5_recorder_end();
+    TEST_ASSERT_TRUE(p5_batched_shape_count() == 0);
+    TEST_ASSERT_TRUE(p5_recorder_vertex_count(recorder) == 6);
+    end_batched_frame();
+    
+    // Submitting a recorder flushes first
+    begin_logged_frame();
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(0, 0, 10, 10);
+    p5_recorder_submit(recorder);
+    TEST_ASSERT_TRUE(draw_log.count == 2);
+    TEST_ASSERT_TRUE(draw_log.records[0].color[0] == 255 && draw_log.records[0].color[1] == 0);
+    TEST_ASSERT_TRUE(draw_log.records[1].color[1] == 255);
+    end_batched_frame();
+    p5_recorder_free(recorder);
+    p5_shape_batching(false);
+}
+
+// A red rect followed by a graphics buffer
+static uint64_t draw_rect_and_image(p5_graphics_t* pg) {
+    begin_logged_frame();
+    p5_no_stroke();
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(0, 0, 10, 10);
+    p5_image(pg, 20, 0);
+    end_batched_frame();
+    return p5_draw_log_hash(&draw_log);
+}
+
+void test_shape_batch_image_order(void) {
+    p5_init();
+    p5_graphics_t* pg = p5_create_graphics(16, 16);
+    TEST_ASSERT_TRUE(pg != NULL);
+    uint64_t expected = draw_rect_and_image(pg);
+    
+    // The rect is drawn with its own color and blend mode before the
+    // image, and the image is drawn untinted
+    p5_shape_batching(true);
+    uint64_t batched = draw_rect_and_image(pg);
+    p5_shape_batching(false);
+    TEST_ASSERT_TRUE(batched == expected);
+    TEST_ASSERT_TRUE(draw_log.count == 2);
+    const p5_draw_record_t* rect = &draw_log.records[0];
+    const p5_draw_record_t* image = &draw_log.records[1];
+    TEST_ASSERT_TRUE(rect->op == P5_DRAW_RECT);
+    TEST_ASSERT_TRUE(rect->color[0] == 255 && rect->color[1] == 0 && rect->color[2] == 0);
+    TEST_ASSERT_TRUE(image->op == P5_DRAW_TEXTURED_RECT);
+    TEST_ASSERT_TRUE(image->color[0] == 255 && image->color[1] == 255 && image->color[2] == 255);
+    p5_remove_graphics(pg);
+}
+
+// An incremental frame with shapes before and after a moving rect
+static uint64_t draw_incremental_frame(float x) {
+    begin_logged_frame();
+    p5_incremental_frame_begin();
+    p5_background_rgb(30, 30, 30);
+    p5_no_stroke();
+    p5_fill_rgb(0, 255, 0);
+    p5_rect(0, 0, 20, 20);
+    p5_fill_rgb(255, 0, 0);
+    p5_rect(x, 50, 10, 10);
+    p5_incremental_frame_end();
+    end_batched_frame();
+    return p5_draw_log_hash(&draw_log);
+}
+
+void test_shape_batch_incremental(void) {
+    uint64_t expected[2];
+    for (int batched = 0; batched < 2; batched++) {
+        p5_init();
+        p5_shape_batching(batched != 0);
+        p5_incremental(true);
+        for (int frame = 0; frame < 2; frame++) {
+            uint64_t hash = draw_incremental_frame(100.0f + frame * 50.0f);
+            if (!batched) expected[frame] = hash;
+            // The replayed shapes go into the canvas target, within their
+            // dirty region, before the target is composited
+            TEST_ASSERT_TRUE(hash == expected[frame]);
+            TEST_ASSERT_TRUE(draw_log.count > 1);
+            TEST_ASSERT_TRUE(draw_log.records[draw_log.count - 1].op == P5_DRAW_TEXTURED_RECT);
+            TEST_ASSERT_TRUE(p5_batched_shape_count() == 0);
+        }
+        p5_incremental(false);
+        p5_shape_batching(false);
+    }
+}
+
+void test_shape_batch_merges_draws(void) {
+    p5_init();
+    p5_shape_batching(true);
+    p5_no_stroke();
+    headless_frame_begin();
+    for (int i = 0; i < 10000; i++) {
+        p5_fill_rgb(i % 256, 128, 255 - i % 256);
+        p5_circle((float)(i % 100) * 4.0f, (float)(i / 100) * 3.0f, 6);
+    }
+    p5_flush_shapes();
+    headless_frame_end();
+    sg_frame_stats stats = sg_query_frame_stats();
+    printf("10000 batched circles: %u draw calls with %d workers\n", stats.num_draw, p5_worker_thread_count());
+    // sgp merges the batched circles into few draws
+    TEST_ASSERT_TRUE(stats.num_draw >= 1 && stats.num_draw <= 64);
+    p5_shape_batching(false);
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+
+    RUN_TEST(test_shape_batch_matches_direct);
+    RUN_TEST(test_shape_batch_unlogged_costs);
+    RUN_TEST(test_shape_batch_order);
+    RUN_TEST(test_shape_batch_image_order);
+    RUN_TEST(test_shape_batch_incremental);
+    RUN_TEST(test_shape_batch_merges_draws);
+
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
@@ -0,0 +1,94 @@
+/*
+test_timing.c - Test the frame clock, limiter and frame time statistics
+Frame times are injected by moving the previous frame's start back, so the
+percentile checks are exact. The limiter keeps a fixed schedule, so a frame
+after a late wake-up is short by design: only the time over all frames is
+checked, with room for a busy machine.
+*/
+
+#include "test_utils.h"
+#include "test_headless.h"
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 240
+
+// Begin a frame that took ms milliseconds since the previous one
+static void frame_with_time(float ms) {
+    p5_state.timing.frame_start = p5__now_ns() - (uint64_t)(ms * 1e6);
+    p5_frame_begin();
+    p5_frame_end();
+}
+
+static bool near(float value, float expected, float tolerance) {
+    return fabsf(value - expected) <= tolerance;
+}
+
+void test_clock_and_sleep(void) {
+    p5_init();
+    uint64_t start = p5__now_ns();
+    double millis = p5_millis();
+    p5__sleep_ns(5000000u);
+    uint64_t elapsed = p5__now_ns() - start;
+    TEST_ASSERT_TRUE(elapsed >= 5000000u);
+    TEST_ASSERT_TRUE(elapsed < 200000000u);
+    TEST_ASSERT_TRUE(p5_millis() - millis >= 5.0);
+    
+    start = p5__now_ns();
+    p5__wait_until(start + 3000000u);
+    TEST_ASSERT_TRUE(p5__now_ns() - start >= 3000000u);
+}
+
+void test_frame_limiter(void) {
+    p5_init();
+    p5_frame_rate(100.0f);
+    TEST_ASSERT_TRUE(p5_get_target_frame_rate() == 100.0f);
+    
+    p5_frame_begin();
+    uint64_t start = p5__now_ns();
+    for (int i = 0; i < 5; i++) {
+        p5_frame_begin();
+        p5_frame_end();
+    }
+    double elapsed_ms = (p5__now_ns() - start) / 1e6;
+    TEST_ASSERT_TRUE(elapsed_ms >= 45.0 && elapsed_ms < 500.0);
+    TEST_ASSERT_TRUE(p5_frame_count() == 6);
+    p5_frame_rate(0.0f);
+}
+
+void test_frame_stats_percentiles(void) {
+    p5_init();
+    p5_frame_begin();  // The first frame has no frame time
+    TEST_ASSERT_TRUE(p5_frame_stats().count == 0);
+    
+    // 90 frames of 10.1 ms, 9 of 20.1 ms and one of 50.1 ms
+    for (int i = 0; i < 100; i++) frame_with_time(i < 90 ? 10.1f : i < 99 ? 20.1f : 50.1f);
+    p5_frame_stats_t stats = p5_frame_stats();
+    TEST_ASSERT_TRUE(stats.count == 100);
+    TEST_ASSERT_TRUE(stats.p50 == 10.25f);  // Upper edges of 0.25 ms buckets
+    TEST_ASSERT_TRUE(stats.p95 == 20.25f);
+    TEST_ASSERT_TRUE(stats.p99 == 20.25f);
+    TEST_ASSERT_TRUE(near(stats.max, 50.1f, 0.1f));
+    TEST_ASSERT_TRUE(near(stats.fps, 100 * 1000.0f / (90 * 10.1f + 9 * 20.1f + 50.1f), 0.5f));
+    TEST_ASSERT_TRUE(near(p5_delta_time(), 50.1f, 0.1f));
+    
+    // A full window of new frames evicts all of the old ones
+    for (int i = 0; i < P5_FRAME_TIME_WINDOW; i++) frame_with_time(16.6f);
+    stats = p5_frame_stats();
+    TEST_ASSERT_TRUE(stats.count == P5_FRAME_TIME_WINDOW);
+    TEST_ASSERT_TRUE(near(stats.max, 16.6f, 0.1f));
+    TEST_ASSERT_TRUE(stats.p50 == stats.max && stats.p99 == stats.max);  // Clamped to the longest frame
+    TEST_ASSERT_TRUE(near(stats.fps, 1000.0f / 16.6f, 0.5f));
+}
+
+int main(void) {
+    TEST_RUNNER_START();
+    
+    if (!headless_setup(TEST_WIDTH, TEST_HEIGHT)) return 1;
+    
+    RUN_TEST(test_clock_and_sleep);
+    RUN_TEST(test_frame_limiter);
+    RUN_TEST(test_frame_stats_percentiles);
+    
+    headless_shutdown();
+    TEST_RUNNER_END();
+}
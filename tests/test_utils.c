@@ -7,6 +7,24 @@ test_utils.c - Implementation of testing utilities for p5.h library
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEST_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TEST_SIMD_NEON
+#endif
 
 // Note: STB implementations are now in deps/test_deps.c
 
@@ -22,7 +40,341 @@ bool save_framebuffer_as_png(const char* filename, int width, int height) {
     return true;
 }
 
-bool compare_images(const char* test_image, const char* golden_image) {
+image_compare_options_t image_compare_defaults(void) {
+    image_compare_options_t options = {
+        .channel_tolerance = { 2, 2, 2, 2 },
+        .perceptual_threshold = 0.0f,
+        .max_failing_percent = 0.1f,
+        .max_error = 255,
+        .diff_image = NULL,
+    };
+    return options;
+}
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+// YIQ color distance of two pixels blended over white, normalized to 0..1
+// (Kotsarenko and Ramos, "Measuring perceived color difference using YIQ
+// NTSC transmission color space in mobile applications")
+static float yiq_distance(const unsigned char* a, const unsigned char* b) {
+    float ar = 255.0f + (a[0] - 255.0f) * a[3] / 255.0f;
+    float ag = 255.0f + (a[1] - 255.0f) * a[3] / 255.0f;
+    float ab = 255.0f + (a[2] - 255.0f) * a[3] / 255.0f;
+    float br = 255.0f + (b[0] - 255.0f) * b[3] / 255.0f;
+    float bg = 255.0f + (b[1] - 255.0f) * b[3] / 255.0f;
+    float bb = 255.0f + (b[2] - 255.0f) * b[3] / 255.0f;
+    float dr = ar - br, dg = ag - bg, db = ab - bb;
+    float y = dr * 0.29889531f + dg * 0.58662247f + db * 0.11448223f;
+    float i = dr * 0.59597799f - dg * 0.27417610f - db * 0.32180189f;
+    float q = dr * 0.21147017f - dg * 0.52261711f + db * 0.31114694f;
+    return (0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q) / 35215.0f;
+}
+
+// 0: within channel tolerance, 1: beyond it but perceptually close, 2: failing
+static int classify_pixel(const unsigned char* t, const unsigned char* g,
+                          const image_compare_options_t* options, float* max_perceptual) {
+    bool beyond = false;
+    for (int c = 0; c < 4; c++) {
+        int d = t[c] > g[c] ? t[c] - g[c] : g[c] - t[c];
+        if (d > options->channel_tolerance[c]) beyond = true;
+    }
+    if (!beyond) return 0;
+    if (options->perceptual_threshold <= 0.0f) return 2;
+    float distance = yiq_distance(t, g);
+    if (max_perceptual && distance > *max_perceptual) *max_perceptual = distance;
+    return distance > options->perceptual_threshold ? 2 : 1;
+}
+
+// Scan one row: accumulates the channel difference sum and maximum with SIMD
+// 4 pixels at a time; only groups with a channel beyond tolerance are
+// classified pixel by pixel. Returns the number of failing pixels.
+static int compare_row(const unsigned char* t, const unsigned char* g, int width,
+                       const image_compare_options_t* options, const unsigned char tolerance[16],
+                       uint64_t* sum, int* max_error, float* max_perceptual) {
+    int failing = 0;
+    int x = 0;
+    unsigned char lanes[16];
+#if defined(TEST_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vtol = _mm_loadu_si128((const __m128i*)tolerance);
+    __m128i vmax = zero;
+    __m128i vsum = zero;
+    for (; x + 4 <= width; x += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(t + x * 4));
+        __m128i b = _mm_loadu_si128((const __m128i*)(g + x * 4));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        vmax = _mm_max_epu8(vmax, d);
+        vsum = _mm_add_epi64(vsum, _mm_sad_epu8(d, zero));
+        __m128i over = _mm_subs_epu8(d, vtol);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(over, zero)) != 0xFFFF) {
+            for (int i = x; i < x + 4; i++) {
+                failing += classify_pixel(t + i * 4, g + i * 4, options, max_perceptual) == 2;
+            }
+        }
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128((__m128i*)sums, vsum);
+    *sum += sums[0] + sums[1];
+    _mm_storeu_si128((__m128i*)lanes, vmax);
+#elif defined(TEST_SIMD_NEON)
+    const uint8x16_t vtol = vld1q_u8(tolerance);
+    uint8x16_t vmax = vdupq_n_u8(0);
+    uint32x4_t vsum = vdupq_n_u32(0);
+    for (; x + 4 <= width; x += 4) {
+        uint8x16_t d = vabdq_u8(vld1q_u8(t + x * 4), vld1q_u8(g + x * 4));
+        vmax = vmaxq_u8(vmax, d);
+        vsum = vpadalq_u16(vsum, vpaddlq_u8(d));
+        uint64x2_t over = vreinterpretq_u64_u8(vqsubq_u8(d, vtol));
+        if ((vgetq_lane_u64(over, 0) | vgetq_lane_u64(over, 1)) != 0) {
+            for (int i = x; i < x + 4; i++) {
+                failing += classify_pixel(t + i * 4, g + i * 4, options, max_perceptual) == 2;
+            }
+        }
+    }
+    uint32_t sums[4];
+    vst1q_u32(sums, vsum);
+    *sum += (uint64_t)sums[0] + sums[1] + sums[2] + sums[3];
+    vst1q_u8(lanes, vmax);
+#else
+    memset(lanes, 0, sizeof(lanes));
+    (void)tolerance;
+#endif
+    for (int i = 0; i < 16; i++) {
+        if (lanes[i] > *max_error) *max_error = lanes[i];
+    }
+
+    // Remaining pixels (and every pixel without SIMD)
+    for (; x < width; x++) {
+        for (int c = 0; c < 4; c++) {
+            int d = t[x * 4 + c] > g[x * 4 + c] ? t[x * 4 + c] - g[x * 4 + c] : g[x * 4 + c] - t[x * 4 + c];
+            *sum += d;
+            if (d > *max_error) *max_error = d;
+        }
+        failing += classify_pixel(t + x * 4, g + x * 4, options, max_perceptual) == 2;
+    }
+    return failing;
+}
+
+// Golden faded to light gray, failing pixels red, perceptually tolerated
+// pixels yellow
+static bool write_diff_image(const char* filename, const unsigned char* test, const unsigned char* golden,
+                             int width, int height, const image_compare_options_t* options) {
+    unsigned char* pixels = (unsigned char*)malloc((size_t)width * height * 4);
+    if (!pixels) return false;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        const unsigned char* g = golden + i * 4;
+        unsigned char* out = pixels + i * 4;
+        switch (classify_pixel(test + i * 4, g, options, NULL)) {
+            case 2:
+                out[0] = 255; out[1] = 0; out[2] = 0;
+                break;
+            case 1:
+                out[0] = 255; out[1] = 255; out[2] = 0;
+                break;
+            default: {
+                float luma = g[0] * 0.29889531f + g[1] * 0.58662247f + g[2] * 0.11448223f;
+                luma = 255.0f + (luma - 255.0f) * g[3] / 255.0f;
+                out[0] = out[1] = out[2] = (unsigned char)(255.0f + (luma - 255.0f) * 0.1f);
+                break;
+            }
+        }
+        out[3] = 255;
+    }
+    bool written = stbi_write_png(filename, width, height, 4, pixels, width * 4) != 0;
+    free(pixels);
+    return written;
+}
+
+bool compare_pixels(const unsigned char* test, const unsigned char* golden, int width, int height,
+                    const image_compare_options_t* options, image_compare_result_t* result) {
+    image_compare_options_t defaults = image_compare_defaults();
+    if (!options) options = &defaults;
+    image_compare_result_t local;
+    if (!result) result = &local;
+    memset(result, 0, sizeof(*result));
+    result->width = width;
+    result->height = height;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned char tolerance[16];
+    for (int i = 0; i < 16; i++) {
+        int t = options->channel_tolerance[i % 4];
+        tolerance[i] = (unsigned char)(t < 0 ? 0 : t > 255 ? 255 : t);
+    }
+
+    uint64_t sum = 0;
+    for (int y = 0; y < height; y++) {
+        size_t row = (size_t)y * width * 4;
+        result->failing_pixels += compare_row(test + row, golden + row, width, options, tolerance,
+                                              &sum, &result->max_error, &result->max_perceptual);
+    }
+
+    size_t pixels = (size_t)width * height;
+    result->failing_percent = pixels ? (float)((double)result->failing_pixels / pixels * 100.0) : 0.0f;
+    result->mean_error = pixels ? (double)sum / (pixels * 4) : 0.0;
+    result->ms = elapsed_ms(&start);
+
+    bool images_match = result->failing_percent <= options->max_failing_percent &&
+                        result->max_error <= options->max_error;
+    if (!images_match && options->diff_image) {
+        if (write_diff_image(options->diff_image, test, golden, width, height, options)) {
+            printf("Diff image written: %s\n", options->diff_image);
+        } else {
+            printf("ERROR: Failed to write diff image: %s\n", options->diff_image);
+        }
+    }
+    return images_match;
+}
+
+// Decoded golden cache: each golden PNG is decoded once into a raw RGBA file
+// named after a hash of the PNG bytes, then memory-mapped by every later
+// comparison, across runs and across the processes of a parallel test run.
+// TEST_GOLDEN_CACHE sets the directory; an empty value disables the cache.
+#define GOLDEN_CACHE_DIR "tests/.golden_cache"
+#define GOLDEN_CACHE_VERSION 1
+
+typedef struct {
+    char magic[4];                // "P5GC"
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+} golden_cache_header_t;          // RGBA8 pixels follow
+
+typedef struct {
+    unsigned char* pixels;
+    int width, height;
+    void* mapping;                // Cache file mapping, or NULL if pixels came from stbi
+    size_t mapping_size;
+} golden_image_t;
+
+static unsigned char* read_file(const char* filename, size_t* size) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* data = length > 0 ? (unsigned char*)malloc((size_t)length) : NULL;
+    if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = data ? (size_t)length : 0;
+    return data;
+}
+
+static uint64_t hash_bytes(const unsigned char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;  // FNV-1a
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool map_cached_golden(const char* path, golden_image_t* image) {
+#ifdef _WIN32
+    (void)path;
+    (void)image;
+    return false;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(golden_cache_header_t)) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    const golden_cache_header_t* header = (const golden_cache_header_t*)data;
+    if (memcmp(header->magic, "P5GC", 4) != 0 || header->version != GOLDEN_CACHE_VERSION ||
+        (size_t)st.st_size != sizeof(*header) + (size_t)header->width * header->height * 4) {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+    image->pixels = (unsigned char*)data + sizeof(*header);
+    image->width = (int)header->width;
+    image->height = (int)header->height;
+    image->mapping = data;
+    image->mapping_size = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+// Write to a temporary file and rename, so concurrent test processes only
+// ever see complete cache files
+static void write_cached_golden(const char* dir, const char* path, const golden_image_t* image) {
+#ifdef _WIN32
+    _mkdir(dir);
+    int pid = _getpid();
+#else
+    mkdir(dir, 0755);
+    int pid = (int)getpid();
+#endif
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.%d.tmp", path, pid);
+    FILE* file = fopen(temp, "wb");
+    if (!file) return;
+    golden_cache_header_t header = { { 'P', '5', 'G', 'C' }, GOLDEN_CACHE_VERSION,
+                                     (uint32_t)image->width, (uint32_t)image->height };
+    size_t size = (size_t)image->width * image->height * 4;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(image->pixels, 1, size, file) == size;
+    written = fclose(file) == 0 && written;
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (!written || rename(temp, path) != 0) remove(temp);
+}
+
+static bool load_golden(const char* filename, golden_image_t* image) {
+    memset(image, 0, sizeof(*image));
+    size_t size = 0;
+    unsigned char* png = read_file(filename, &size);
+    if (!png) return false;
+
+    const char* dir = getenv("TEST_GOLDEN_CACHE");
+    if (!dir) dir = GOLDEN_CACHE_DIR;
+    char path[1024] = "";
+    if (dir[0]) {
+        snprintf(path, sizeof(path), "%s/%016llx.rgba", dir, (unsigned long long)hash_bytes(png, size));
+        if (map_cached_golden(path, image)) {
+            free(png);
+            return true;
+        }
+    }
+
+    int channels;
+    image->pixels = stbi_load_from_memory(png, (int)size, &image->width, &image->height, &channels, 4);
+    free(png);
+    if (!image->pixels) return false;
+    if (path[0]) write_cached_golden(dir, path, image);
+    return true;
+}
+
+static void release_golden(golden_image_t* image) {
+#ifndef _WIN32
+    if (image->mapping) {
+        munmap(image->mapping, image->mapping_size);
+        memset(image, 0, sizeof(*image));
+        return;
+    }
+#endif
+    if (image->pixels) stbi_image_free(image->pixels);
+    memset(image, 0, sizeof(*image));
+}
+
+bool compare_images_ex(const char* test_image, const char* golden_image,
+                       const image_compare_options_t* options, image_compare_result_t* result) {
     if (!file_exists(test_image)) {
         printf("ERROR: Test image does not exist: %s\n", test_image);
         return false;
@@ -57,51 +409,86 @@ bool compare_images(const char* test_image, const char* golden_image) {
         return true;
     }
     
-    // Load both images
+    // Load both images (the golden through the decoded cache)
     int test_w, test_h, test_channels;
-    int golden_w, golden_h, golden_channels;
+    golden_image_t golden;
     
     unsigned char* test_data = stbi_load(test_image, &test_w, &test_h, &test_channels, 4);
-    unsigned char* golden_data = stbi_load(golden_image, &golden_w, &golden_h, &golden_channels, 4);
+    bool golden_loaded = load_golden(golden_image, &golden);
     
-    if (!test_data || !golden_data) {
+    if (!test_data || !golden_loaded) {
         printf("ERROR: Failed to load images for comparison\n");
         if (test_data) stbi_image_free(test_data);
-        if (golden_data) stbi_image_free(golden_data);
+        release_golden(&golden);
         return false;
     }
     
     // Check dimensions match
-    if (test_w != golden_w || test_h != golden_h) {
+    if (test_w != golden.width || test_h != golden.height) {
         printf("ERROR: Image dimensions don't match - Test: %dx%d, Golden: %dx%d\n", 
-               test_w, test_h, golden_w, golden_h);
+               test_w, test_h, golden.width, golden.height);
         stbi_image_free(test_data);
-        stbi_image_free(golden_data);
+        release_golden(&golden);
         return false;
     }
     
-    // Compare pixel data
-    int total_pixels = test_w * test_h * 4;
-    int diff_pixels = 0;
-    
-    for (int i = 0; i < total_pixels; i++) {
-        if (test_data[i] != golden_data[i]) {
-            diff_pixels++;
-        }
-    }
+    image_compare_result_t local;
+    if (!result) result = &local;
+    bool images_match = compare_pixels(test_data, golden.pixels, test_w, test_h, options, result);
     
     stbi_image_free(test_data);
-    stbi_image_free(golden_data);
+    release_golden(&golden);
+    
+    printf("Images %s (%.2f%% failing pixels, max error %d, mean error %.3f, %.2f ms)\n",
+           images_match ? "match" : "differ significantly", result->failing_percent,
+           result->max_error, result->mean_error, result->ms);
     
-    // Allow for small differences (threshold of 1% different pixels)
-    float diff_percentage = (float)diff_pixels / total_pixels * 100.0f;
-    bool images_match = diff_percentage < 1.0f;
+    return images_match;
+}
+
+bool compare_images(const char* test_image, const char* golden_image) {
+    // tests/test_output_x.png -> tests/test_output_x_diff.png
+    char diff_image[1024];
+    size_t length = strlen(test_image);
+    if (length > 4 && strcmp(test_image + length - 4, ".png") == 0) length -= 4;
+    snprintf(diff_image, sizeof(diff_image), "%.*s_diff.png", (int)length, test_image);
+    
+    image_compare_options_t options = image_compare_defaults();
+    options.diff_image = diff_image;
+    return compare_images_ex(test_image, golden_image, &options, NULL);
+}
+
+bool compare_hash(uint64_t hash, const char* golden_file) {
+    if (!file_exists(golden_file)) {
+        printf("WARNING: Golden hash does not exist: %s\n", golden_file);
+        printf("Creating golden hash %016llx...\n", (unsigned long long)hash);
+        
+        FILE* dst = fopen(golden_file, "w");
+        if (!dst) {
+            printf("ERROR: Failed to create golden hash\n");
+            return false;
+        }
+        fprintf(dst, "%016llx\n", (unsigned long long)hash);
+        fclose(dst);
+        
+        printf("Golden hash created. Test passes by default.\n");
+        return true;
+    }
     
-    if (images_match) {
-        printf("Images match (%.2f%% difference)\n", diff_percentage);
-    } else {
-        printf("Images differ significantly (%.2f%% difference)\n", diff_percentage);
+    FILE* src = fopen(golden_file, "r");
+    unsigned long long golden = 0;
+    bool loaded = src && fscanf(src, "%llx", &golden) == 1;
+    if (src) fclose(src);
+    if (!loaded) {
+        printf("ERROR: Failed to read golden hash: %s\n", golden_file);
+        return false;
     }
     
-    return images_match;
+    if (golden != (unsigned long long)hash) {
+        printf("Draw stream differs - Test: %016llx, Golden: %016llx\n",
+               (unsigned long long)hash, golden);
+        return false;
+    }
+    printf("Draw stream matches (%016llx)\n", (unsigned long long)hash);
+    return true;
 }
@@ -10,6 +10,8 @@ Provides TEST_ASSERT_TRUE macro and golden image testing functionality
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
 // Test statistics
 static int test_count = 0;
@@ -55,18 +57,75 @@ static void print_test_results(void) {
 // STB image function declarations (implementations in deps/test_deps.c)
 extern int stbi_write_png(char const *filename, int w, int h, int comp, const void *data, int stride_in_bytes);
 extern unsigned char *stbi_load(char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
+extern unsigned char *stbi_load_from_memory(unsigned char const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels);
 extern void stbi_image_free(void *retval_from_stbi_load);
 
+// Image comparison options. A pixel fails when any channel differs from the
+// golden by more than its channel tolerance (and, with a perceptual
+// threshold, when its YIQ color distance also exceeds that threshold).
+typedef struct {
+    int channel_tolerance[4];     // Allowed |test - golden| per pixel for R, G, B, A
+    float perceptual_threshold;   // 0 = off, else YIQ distance (0..1) a failing pixel must exceed
+    float max_failing_percent;    // Share of failing pixels allowed
+    int max_error;                // Any channel differing by more fails the comparison (255 = off)
+    const char* diff_image;       // Diff PNG written on failure (NULL = none)
+} image_compare_options_t;
+
+typedef struct {
+    int width, height;
+    int failing_pixels;
+    float failing_percent;
+    int max_error;                // Largest channel difference
+    double mean_error;            // Mean channel difference
+    float max_perceptual;         // Largest YIQ distance of pixels beyond channel tolerance
+    double ms;                    // Time spent comparing (not decoding)
+} image_compare_result_t;
+
+// Defaults: tolerance 2 on every channel, 0.1% failing pixels, no max-error
+// or perceptual limit, no diff image
+image_compare_options_t image_compare_defaults(void);
+
 // Image comparison function declarations
 bool save_framebuffer_as_png(const char* filename, int width, int height);
+// Default options; on failure writes <test_image>_diff.png next to the test image
 bool compare_images(const char* test_image, const char* golden_image);
+bool compare_images_ex(const char* test_image, const char* golden_image,
+                       const image_compare_options_t* options, image_compare_result_t* result);
+// Compare two RGBA8 buffers of the same size (tightly packed rows)
+bool compare_pixels(const unsigned char* test, const unsigned char* golden, int width, int height,
+                    const image_compare_options_t* options, image_compare_result_t* result);
 bool file_exists(const char* filename);
 
+// Draw stream golden: compares a p5_draw_log_hash() value with the one stored
+// in golden_file (created on first run, like golden images)
+bool compare_hash(uint64_t hash, const char* golden_file);
+
+static inline double test_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// TEST_LIST=1 lists the test cases instead of running them, TEST_FILTER=<name>
+// runs only that case (both used by tests/test_runner.c)
+static inline bool test_case_selected(const char* name) {
+    if (getenv("TEST_LIST")) {
+        printf("TEST_CASE %s\n", name);
+        return false;
+    }
+    const char* filter = getenv("TEST_FILTER");
+    return !filter || strcmp(filter, name) == 0;
+}
+
 // Test runner macros
 #define RUN_TEST(test_func) \
     do { \
-        printf("\n--- Running %s ---\n", #test_func); \
-        test_func(); \
+        if (test_case_selected(#test_func)) { \
+            double test_start_ms = test_now_ms(); \
+            printf("\n--- Running %s ---\n", #test_func); \
+            test_func(); \
+            printf("--- %s took %.2f ms ---\n", #test_func, test_now_ms() - test_start_ms); \
+        } \
     } while(0)
 
 #define TEST_RUNNER_START() \
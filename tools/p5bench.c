@@ -0,0 +1,352 @@
+/*
+p5bench.c - Headless p5.h benchmark scenes with JSON output
+Draws standard workloads through p5.h using the sokol dummy backend and
+measures CPU time per frame in p5's drawing (tessellation) and submission
+(sgp_flush through sg_commit) paths, plus the geometry and draw calls each
+frame generates. Compare the JSON of two p5.h revisions to spot regressions.
+With --batched, every scene is run again with p5_shape_batching() once per
+listed worker pool size, the flush counted as drawing, to show how parallel
+tessellation scales.
+
+Usage: tools/p5bench [--frames N] [--scene NAME] [--revision REV] [--output PATH]
+                     [--batched WORKERS,...]
+       make bench
+       tools/p5bench --scene circles_100k --batched 1,2,4,8,16
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// sokol dependencies (headless)
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "sokol_gfx.h"
+#define SOKOL_GP_IMPL
+#include "sokol_gp.h"
+
+// our p5 library
+#define P5_IMPLEMENTATION
+#define P5_HEADLESS
+#define P5_NO_SHORT_NAMES
+#include "p5.h"
+
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_WARMUP_FRAMES 2
+#define BENCH_MAX_FRAMES 1000
+#define BENCH_MAX_RUNS 16              // Worker pool sizes per --batched
+#define BENCH_MAX_VERTICES (1 << 23)   // Largest scenes emit ~5M vertices per frame
+#define BENCH_MAX_COMMANDS (1 << 16)
+
+// Deterministic pseudo-random numbers so every revision draws the same scene
+static uint32_t bench_seed;
+
+static float bench_random(float lo, float hi) {
+    bench_seed = bench_seed * 1664525u + 1013904223u;
+    return lo + (hi - lo) * (float)(bench_seed >> 8) / (float)(1u << 24);
+}
+
+//
+// Scenes
+//
+
+static void scene_circles(int count, float diameter) {
+    p5_no_stroke();
+    p5_fill_rgb(40, 120, 220);
+    for (int i = 0; i < count; i++) {
+        p5_circle(bench_random(0, BENCH_WIDTH), bench_random(0, BENCH_HEIGHT), diameter);
+    }
+}
+
+static void scene_circles_10k(void) {
+    scene_circles(10000, 12.0f);
+}
+
+static void scene_circles_100k(void) {
+    scene_circles(100000, 8.0f);
+}
+
+static void scene_thick_polygons(void) {
+    p5_fill_rgb(250, 200, 60);
+    p5_stroke_rgb(30, 30, 30);
+    p5_stroke_weight(6.0f);
+    for (int i = 0; i < 2000; i++) {
+        float x = bench_random(0, BENCH_WIDTH), y = bench_random(0, BENCH_HEIGHT);
+        p5_rect(x, y, 30.0f, 20.0f);
+        p5_triangle(x, y, x + 30.0f, y + 5.0f, x + 10.0f, y + 28.0f);
+        p5_quad(x, y, x + 25.0f, y - 5.0f, x + 30.0f, y + 20.0f, x - 5.0f, y + 25.0f);
+    }
+}
+
+static void scene_polyline_1m(void) {
+    p5_stroke_rgb(20, 200, 120);
+    p5_stroke_weight(1.0f);
+    float x = BENCH_WIDTH * 0.5f, y = BENCH_HEIGHT * 0.5f;
+    for (int i = 1; i < 1000000; i++) {
+        float nx = fminf(fmaxf(x + bench_random(-4.0f, 4.0f), 0.0f), (float)BENCH_WIDTH);
+        float ny = fminf(fmaxf(y + bench_random(-4.0f, 4.0f), 0.0f), (float)BENCH_HEIGHT);
+        p5_line(x, y, nx, ny);
+        x = nx;
+        y = ny;
+    }
+}
+
+static void scene_arcs(void) {
+    const p5_arc_mode_t modes[3] = { P5_OPEN, P5_CHORD, P5_PIE };
+    p5_fill_rgb(200, 80, 160);
+    p5_stroke_rgb(255, 255, 255);
+    for (int i = 0; i < 9000; i++) {
+        p5_stroke_weight(i % 2 ? 1.0f : 3.0f);  // Thin and thick outlines
+        float start = bench_random(0.0f, TWO_PI);
+        p5_arc_with_mode(bench_random(0, BENCH_WIDTH), bench_random(0, BENCH_HEIGHT), 40.0f, 30.0f,
+                         start, start + bench_random(0.5f, 5.5f), modes[i % 3]);
+    }
+}
+
+static void tree_branch(int depth, float length) {
+    p5_stroke_weight(depth > 8 ? 1.0f : 2.0f);
+    p5_line(0.0f, 0.0f, 0.0f, -length);
+    if (depth == 0) return;
+
+    p5_translate(0.0f, -length);
+    for (int side = -1; side <= 1; side += 2) {
+        p5_push();
+        p5_rotate(side * 0.35f);
+        p5_stroke_rgb(60 + depth * 12, 160, 60);
+        tree_branch(depth - 1, length * 0.75f);
+        p5_pop();
+    }
+}
+
+static void scene_push_pop_tree(void) {
+    // Binary tree: 16k nested scopes that change transform and style
+    p5_push();
+    p5_translate(BENCH_WIDTH * 0.5f, (float)BENCH_HEIGHT);
+    tree_branch(13, 120.0f);
+    p5_pop();
+
+    // Deep chain: 1000 levels open at once
+    p5_no_stroke();
+    for (int i = 0; i < 1000; i++) {
+        p5_push();
+        p5_translate(1.0f, 0.5f);
+        p5_fill_rgb(i % 256, 80, 200);
+        p5_rect(0.0f, 0.0f, 4.0f, 4.0f);
+    }
+    for (int i = 0; i < 1000; i++) p5_pop();
+}
+
+static void scene_scatter_mixed_colors(void) {
+    p5_stroke_weight(1.0f);
+    for (int i = 0; i < 50000; i++) {
+        p5_fill_rgb((unsigned)bench_random(0, 256), (unsigned)bench_random(0, 256), (unsigned)bench_random(0, 256));
+        p5_stroke_rgb((unsigned)bench_random(0, 256), 0, 0);
+        p5_circle(bench_random(0, BENCH_WIDTH), bench_random(0, BENCH_HEIGHT), 6.0f);
+    }
+}
+
+typedef struct {
+    const char* name;
+    void (*draw)(void);
+} bench_scene_t;
+
+static const bench_scene_t scenes[] = {
+    { "circles_10k", scene_circles_10k },
+    { "circles_100k", scene_circles_100k },
+    { "thick_polygons", scene_thick_polygons },
+    { "polyline_1m", scene_polyline_1m },
+    { "arcs_all_modes", scene_arcs },
+    { "push_pop_tree", scene_push_pop_tree },
+    { "scatter_mixed_colors", scene_scatter_mixed_colors },
+};
+
+//
+// Measurement
+//
+
+typedef struct {
+    double mean, min, p50, max;
+} bench_times_t;
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static bench_times_t summarize(double* samples, int count) {
+    bench_times_t t = {0};
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    qsort(samples, count, sizeof(double), compare_doubles);
+    t.mean = sum / count;
+    t.min = samples[0];
+    t.p50 = samples[count / 2];
+    t.max = samples[count - 1];
+    return t;
+}
+
+static void print_times(FILE* out, const char* key, bench_times_t t) {
+    fprintf(out, "\"%s\": {\"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"max\": %.4f}",
+            key, t.mean, t.min, t.p50, t.max);
+}
+
+// Run one scene and append its JSON object; workers > 0 batches the shapes
+// and tessellates them on a pool of that many worker threads
+static void run_scene(FILE* out, const bench_scene_t* scene, int frames, int workers) {
+    static double draw_ms[BENCH_MAX_FRAMES], submit_ms[BENCH_MAX_FRAMES];
+    sg_frame_stats stats = {0};
+    p5_sgp_usage_t usage = {0};
+    p5_alloc_stats_t allocs = {0};
+    bool dropped = false;
+    if (workers > 0) p5_worker_threads(workers);
+    p5_shape_batching(workers > 0);
+
+    for (int frame = -BENCH_WARMUP_FRAMES; frame < frames; frame++) {
+        bench_seed = 12345u;
+        p5_frame_begin();
+        double start = p5_millis();
+        sgp_begin(BENCH_WIDTH, BENCH_HEIGHT);
+        sgp_viewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+        sgp_project(0.0f, (float)BENCH_WIDTH, 0.0f, (float)BENCH_HEIGHT);
+        p5_background_rgb(0, 0, 0);
+        scene->draw();
+        p5_flush_shapes();
+
+        double submit = p5_millis();
+        sg_begin_pass(&(sg_pass){
+            .swapchain = {
+                .width = BENCH_WIDTH,
+                .height = BENCH_HEIGHT,
+                .sample_count = 1,
+                .color_format = SG_PIXELFORMAT_RGBA8,
+                .depth_format = SG_PIXELFORMAT_NONE,
+            },
+        });
+        sgp_flush();
+        sgp_end();
+        sg_end_pass();
+        sg_commit();
+        double end = p5_millis();
+
+        dropped = dropped || sgp_get_last_error() != SGP_NO_ERROR;
+        stats = sg_query_frame_stats();
+        p5_frame_end();
+        usage = p5_sgp_usage();
+        if (frame < 0) continue;
+        draw_ms[frame] = submit - start;
+        submit_ms[frame] = end - submit;
+    }
+    allocs = p5_alloc_stats();  // Last frame closed by p5_frame_begin(), a measured one
+    p5_shape_batching(false);
+
+    static double total_ms[BENCH_MAX_FRAMES];
+    for (int i = 0; i < frames; i++) total_ms[i] = draw_ms[i] + submit_ms[i];
+
+    bench_times_t total = summarize(total_ms, frames);
+    bench_times_t draw = summarize(draw_ms, frames);
+    bench_times_t submit = summarize(submit_ms, frames);
+
+    fprintf(out, "    {\"name\": \"%s\", \"batched\": %s, \"workers\": %d, ",
+            scene->name, workers > 0 ? "true" : "false", workers);
+    print_times(out, "frame_ms", total);
+    fprintf(out, ", ");
+    print_times(out, "draw_ms", draw);
+    fprintf(out, ", ");
+    print_times(out, "submit_ms", submit);
+    fprintf(out, ", \"vertices\": %u, \"draw_calls\": %u, \"sgp_commands\": %u, "
+                 "\"heap_allocations\": %u, \"dropped\": %s}",
+            usage.frame.vertices, stats.num_draw, usage.frame.commands,
+            allocs.frame_allocations, dropped ? "true" : "false");
+    char label[64];
+    if (workers > 0) {
+        snprintf(label, sizeof(label), "%s/%d", scene->name, workers);
+    } else {
+        snprintf(label, sizeof(label), "%s", scene->name);
+    }
+    fprintf(stderr, "%-22s %9.3f ms/frame (draw %.3f, submit %.3f), %u draw calls\n",
+            label, total.mean, draw.mean, submit.mean, stats.num_draw);
+}
+
+int main(int argc, char* argv[]) {
+    int frames = 10;
+    const char* only = NULL;
+    const char* revision = "";
+    const char* output = NULL;
+    int workers[BENCH_MAX_RUNS];
+    int batched_runs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--revision") == 0 && i + 1 < argc) {
+            revision = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (strcmp(argv[i], "--batched") == 0 && i + 1 < argc) {
+            for (char* list = argv[++i]; *list && batched_runs < BENCH_MAX_RUNS; ) {
+                char* next;
+                long count = strtol(list, &next, 10);
+                if (next == list) break;
+                if (count > 0) workers[batched_runs++] = (int)count;
+                list = (*next == ',') ? next + 1 : next;
+            }
+        } else {
+            printf("Usage: %s [--frames N] [--scene NAME] [--revision REV] [--output PATH] "
+                   "[--batched WORKERS,...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 1) frames = 1;
+    if (frames > BENCH_MAX_FRAMES) frames = BENCH_MAX_FRAMES;
+
+    FILE* out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        printf("ERROR: Cannot open %s\n", output);
+        return 1;
+    }
+
+    sg_setup(&(sg_desc){
+        .environment.defaults = {
+            .color_format = SG_PIXELFORMAT_RGBA8,
+            .depth_format = SG_PIXELFORMAT_NONE,
+            .sample_count = 1,
+        },
+    });
+    sgp_setup(&(sgp_desc){
+        .max_vertices = BENCH_MAX_VERTICES,
+        .max_commands = BENCH_MAX_COMMANDS,
+    });
+    if (!sgp_is_valid()) {
+        printf("ERROR: sgp_setup failed: %s\n", sgp_get_error_message(sgp_get_last_error()));
+        return 1;
+    }
+    p5_headless_size(BENCH_WIDTH, BENCH_HEIGHT);
+    p5_init();
+
+    fprintf(out, "{\n  \"benchmark\": \"p5bench\",\n  \"revision\": \"%s\",\n", revision);
+    fprintf(out, "  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n  \"scenes\": [\n",
+            BENCH_WIDTH, BENCH_HEIGHT, frames);
+    int written = 0;
+    for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+        if (only && strcmp(only, scenes[i].name) != 0) continue;
+        if (written++ > 0) fprintf(out, ",\n");
+        run_scene(out, &scenes[i], frames, 0);
+        for (int r = 0; r < batched_runs; r++) {
+            fprintf(out, ",\n");
+            run_scene(out, &scenes[i], frames, workers[r]);
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (output) fclose(out);
+
+    p5_shutdown();
+    sgp_shutdown();
+    sg_shutdown();
+    if (only && written == 0) {
+        printf("ERROR: Unknown scene %s\n", only);
+        return 1;
+    }
+    return 0;
+}
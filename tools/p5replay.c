@@ -0,0 +1,167 @@
+/*
+p5replay.c - Headless replay of p5.h frame capture files
+Memory-maps a capture written by p5_capture_begin() and drives p5.h with it
+using the sokol dummy backend, so no window or GPU is needed.
+
+Usage: tools/p5replay <capture.p5c> [loops]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// sokol dependencies (headless)
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "sokol_gfx.h"
+#define SOKOL_GP_IMPL
+#include "sokol_gp.h"
+
+// our p5 library
+#define P5_IMPLEMENTATION
+#define P5_HEADLESS
+#define P5_NO_SHORT_NAMES
+#include "p5.h"
+
+static double now_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#endif
+}
+
+// Map the whole capture file read-only
+static const uint8_t* map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    const uint8_t* data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = (size_t)file_size.QuadPart;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return (const uint8_t*)data;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <capture.p5c> [loops]\n", argv[0]);
+        return 1;
+    }
+    int loops = argc > 2 ? atoi(argv[2]) : 1;
+    if (loops < 1) loops = 1;
+
+    size_t size = 0;
+    const uint8_t* data = map_file(argv[1], &size);
+    if (!data) {
+        printf("ERROR: Cannot map %s\n", argv[1]);
+        return 1;
+    }
+
+    const p5_capture_header_t* header = (const p5_capture_header_t*)data;
+    if (size < sizeof(*header) || memcmp(header->magic, "P5CF", 4) != 0 ||
+        header->version != P5_CAPTURE_VERSION) {
+        printf("ERROR: %s is not a p5 capture (version %d)\n", argv[1], P5_CAPTURE_VERSION);
+        return 1;
+    }
+
+    sg_setup(&(sg_desc){
+        .environment.defaults = {
+            .color_format = SG_PIXELFORMAT_RGBA8,
+            .depth_format = SG_PIXELFORMAT_NONE,
+            .sample_count = 1,
+        },
+    });
+    sgp_setup(&(sgp_desc){0});
+    if (!sgp_is_valid()) {
+        printf("ERROR: sgp_setup failed: %s\n", sgp_get_error_message(sgp_get_last_error()));
+        return 1;
+    }
+    p5_init();
+
+    double total_ms = 0.0, min_ms = 1e30, max_ms = 0.0;
+    uint32_t frames = 0;
+
+    for (int loop = 0; loop < loops; loop++) {
+        size_t offset = sizeof(*header);
+        for (uint32_t i = 0; i < header->frame_count; i++) {
+            const p5_capture_frame_t* frame = (const p5_capture_frame_t*)(data + offset);
+            if (offset + sizeof(*frame) > size || offset + sizeof(*frame) + frame->size > size) {
+                printf("ERROR: Truncated capture at frame %u\n", i);
+                return 1;
+            }
+            offset += sizeof(*frame) + P5_CAPTURE_PADDED_SIZE(frame->size);
+
+            double start = now_ms();
+            sgp_begin(frame->width, frame->height);
+            sgp_viewport(0, 0, frame->width, frame->height);
+            sgp_project(0.0f, (float)frame->width, 0.0f, (float)frame->height);
+            p5_capture_replay(frame);
+            sg_begin_pass(&(sg_pass){
+                .swapchain = {
+                    .width = frame->width,
+                    .height = frame->height,
+                    .sample_count = 1,
+                    .color_format = SG_PIXELFORMAT_RGBA8,
+                    .depth_format = SG_PIXELFORMAT_NONE,
+                },
+            });
+            sgp_flush();
+            sgp_end();
+            sg_end_pass();
+            sg_commit();
+            double elapsed = now_ms() - start;
+
+            total_ms += elapsed;
+            if (elapsed < min_ms) min_ms = elapsed;
+            if (elapsed > max_ms) max_ms = elapsed;
+            frames++;
+        }
+    }
+
+    if (sgp_get_last_error() != SGP_NO_ERROR) {
+        printf("WARNING: %s\n", sgp_get_error_message(sgp_get_last_error()));
+    }
+    if (frames > 0) {
+        printf("%u frames (%u per loop, %d loops): avg %.3f ms, min %.3f ms, max %.3f ms\n",
+               frames, header->frame_count, loops, total_ms / frames, min_ms, max_ms);
+    }
+
+    p5_shutdown();
+    sgp_shutdown();
+    sg_shutdown();
+    return 0;
+}